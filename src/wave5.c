@@ -16,12 +16,28 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <ctype.h>
 #include <math.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/inotify.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <stdarg.h>
 
 #define VERSION "1.0-alpha"
 #define MAX_CODE (4 * 1024 * 1024)
@@ -32,6 +48,63 @@
 #define MAX_IDENT 256
 #define MAX_POOLS 16
 #define MAX_ADAPTERS 32
+#define MAX_GREFS 65536
+#define ELF_BASE 0x400000
+#define GLOBAL_BASE 0x600000
+#define INLINE_MAX_BODY 256   // Body bytes for a function to be an inline candidate
+#define INLINE_MAX_DEPTH 4
+
+// Runtime helpers and the instruction set levels they are built for
+enum { RT_COPY, RT_FILL, RT_ALLOC, RT_AFTER, RT_EVERY, RT_CANCEL, RT_TICK, RT_TIMERS, RT_COUNT };
+enum { MARCH_DISPATCH, MARCH_V2, MARCH_V3, MARCH_V4 };
+#define RT_MAX_SYMS (RT_COUNT * 3 + 2)  // Variants, CPU init, cold text
+#define RT_TIMER_MASK (0x1fu << RT_AFTER)  // after/every/cancel/tick/timers share one runtime
+#define TIMER_TICK_NS 1000000         // Timer wheel resolution: 1ms
+#define TIMER_LEVELS 4                // 64-slot wheels: 2^24 ticks (4.6h) before re-cascading
+#define TIMER_STATE 32                // now, free list, timerfd, pending count; the wheels follow
+#define HUGE_PAGE_SIZE 0x200000       // Pools this large are backed by 2MB pages
+#define HUGE_TEXT_MIN 0x100000        // Code this large gets a 2MB-aligned text segment
+#define PREFETCH_MIN_STRIDE 64        // Smaller strides are left to the hardware prefetcher
+#define PREFETCH_MAX_SITES 8          // Strided streams prefetched per loop
+#define ELF_TEXT_OFFSET 120           // ELF + program header bytes before the code
+#define ELF_TINY_OFFSET 112           // --tiny: the program header overlaps the ELF header's tail
+#define ALIGN_LOOP_MAX_BODY 1024      // Loops with longer bodies are not padded
+#define ALIGN_MAX 32
+#define REG_ALLOC_FIRST 12            // Variables are allocated to r12-r15
+#define REG_ALLOC_COUNT 4
+#define MAX_REG_VARS 64               // Allocation candidates per function
+#define MAX_COLD_BLOCKS 256           // when bodies moved to the cold region
+#define MAX_PROF_SITES 4096           // Counters in an instrumented build
+#define PROF_MAGIC 0x52504657         // "WFPR"
+#define PROF_COLD_RATIO 16            // Taken at most once per N evaluations: cold
+#define SPEC_MIN_CALLS 1000           // Profiled calls before a function is specialized
+#define LIMIT_CHUNK_SHARE 8           // alloc() maps at most 1/N of a memory limit at a time
+#define CSE_FIRST_REG 8               // Common subexpressions are cached in r8-r10
+#define CSE_SLOTS 3
+#define CSE_WINDOW 512                // Source bytes searched for a repeat before caching
+#define MEMO_SLOTS 1024               // Direct-mapped entries per memoized function
+#define MEMO_MAX_ARGS 4
+#define MEMO_AUTO_R 0.75              // r at which pure recursive functions are memoized
+#define MEMO_HASH 0x2545f491          // Odd multiplier mixing the arguments
+#define CT_STEP_BUDGET 100000         // Statements and operators a folded call may evaluate at r = 0.5
+#define CT_EXPR_BUDGET 100000         // Steps for an initial value or output byte, calls included
+#define FATE_STORE_PATH "fate.store"  // Learned settings, kept across compiles
+#define AUTOTUNE_RUNS 3               // Timed runs per variant; the fastest counts
+#define AUTOTUNE_CONFIRM_RUNS 7       // Interleaved runs of the winner against the source build
+#define AUTOTUNE_MAX_ROUNDS 8
+#define AUTOTUNE_STEP 0.25            // Field distance between neighbouring variants
+#define AUTOTUNE_TIMEOUT 10           // Seconds before a variant run is abandoned
+#define WATCH_MAX_FILES 256           // .wave files one --watch tracks
+#define SERVER_MAX_THREADS 64         // Workers (and warm compilers) of --server
+#define SERVER_STORES 64              // fate.store files --server keeps in memory
+#define SERVER_LOCAL 255              // Reply status: the client runs the request itself
+#define CACHE_MAX_SIZE (1ull << 30)   // Output cache cap unless WAVEC_CACHE_SIZE sets one
+#define CACHE_TRIM_SHARE 0.9          // An over-cap cache is trimmed to this share of the cap
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)    // Reflink ioctl (linux/fs.h)
+#endif
+#define CT_MAX_DEPTH 64               // Nested calls during compile-time evaluation
+#define CT_MAX_LOCALS 32
 
 // ═══════════════════════════════════════════════════════════════
 // Unified Field - Three-parameter rule mapping layer
@@ -215,6 +288,12 @@ uint64_t tile_alloc(TileManager* tile, size_t size) {
     return addr;
 }
 
+// Bytes the runtime allocator maps at a time: the selected pool's size
+size_t tile_chunk_size(TileManager* tile) {
+    int idx = tile_select_pool(tile);
+    return idx < 0 ? 0x10000 : tile->pools[idx].size;
+}
+
 size_t tile_total_used(TileManager* tile) {
     size_t sum = 0;
     for (int i = 0; i < tile->pool_count; i++) {
@@ -360,6 +439,52 @@ void fate_tick(FateScheduler* fate, TileManager* tile) {
     }
 }
 
+// Persistent store: learned values per source, one "hash key value" line
+// each. Returns whether the source had any.
+bool fate_store_read(FateScheduler* fate, FILE* f, uint32_t hash) {
+    unsigned h;
+    char key[64];
+    double value;
+    bool found = false;
+    while (fscanf(f, "%x %63s %lf", &h, key, &value) == 3) {
+        if (h != hash) continue;
+        fate_learn(fate, key, value);
+        found = true;
+    }
+    return found;
+}
+
+bool fate_store_load(FateScheduler* fate, const char* path, uint32_t hash) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    bool found = fate_store_read(fate, f, hash);
+    fclose(f);
+    return found;
+}
+
+// Replace the source's entries with everything fate has learned
+bool fate_store_save(FateScheduler* fate, const char* path, uint32_t hash) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* out = fopen(tmp, "w");
+    if (!out) return false;
+    FILE* in = fopen(path, "r");
+    if (in) {
+        char line[256];
+        unsigned h;
+        while (fgets(line, sizeof(line), in)) {
+            if (sscanf(line, "%x", &h) == 1 && h != hash) fputs(line, out);
+        }
+        fclose(in);
+    }
+    for (int i = 0; i < fate->learned_count; i++) {
+        fprintf(out, "%08x %s %.6f\n", hash, fate->learned_keys[i], fate->learned_values[i]);
+    }
+    bool ok = fclose(out) == 0 && rename(tmp, path) == 0;
+    if (!ok) unlink(tmp);
+    return ok;
+}
+
 // ═══════════════════════════════════════════════════════════════
 // Platform - Minimal platform layer (Fate adaptive)
 // ═══════════════════════════════════════════════════════════════
@@ -476,6 +601,8 @@ typedef struct {
     bool is_param;
     bool is_global;      // Global variable (uses absolute address)
     uint64_t global_addr; // Absolute address for global vars
+    int reg;             // r12-r15 when register allocated (0 = in its stack slot)
+    bool is_const;       // Parameter of a specialized clone: always int_val
 } Variable;
 
 // ═══════════════════════════════════════════════════════════════
@@ -485,12 +612,35 @@ typedef struct {
 typedef struct {
     char name[MAX_IDENT];
     size_t code_offset;
+    size_t code_end;
     int param_count;
     char params[16][MAX_IDENT];
+    size_t param_pos[16]; // Source offsets of the parameters (value profile sites)
+    size_t def_pos;       // Start of "fn ..." (IR text for link-time inlining)
     size_t body_pos;
     size_t body_end;
+    bool is_import;       // Defined in another module, body only used for inlining
+    int inline_state;     // 0 = unknown, 1 = single-expression body, -1 = not inlinable
+    size_t inline_pos;    // Start of the body expression when inline_state == 1
+    bool memo;            // Declared "memo fn"
+    uint64_t memo_table;  // Global address of its memo table (0 = none yet)
+    int pure_state;       // 0 = unknown, 1 = pure, -1 = not (or being checked)
 } Function;
 
+// Code cut out of the text stream for the cold region, with the labels,
+// fixups and global references that were emitted inside it
+typedef struct {
+    uint8_t* code;
+    size_t len;
+    size_t origin;        // Position the code was compiled at
+    void* labels;
+    int label_count;
+    void* fixups;
+    int fixup_count;
+    void* grefs;
+    int gref_count;
+} ColdBlock;
+
 // ═══════════════════════════════════════════════════════════════
 // Code Generator
 // ═══════════════════════════════════════════════════════════════
@@ -519,20 +669,66 @@ typedef struct {
     struct { char name[64]; size_t pos; } labels[MAX_LABELS];
     int label_count;
     
+    // Absolute global references (imm64 slots), relocated by the linker
+    struct { size_t pos; uint32_t off; } grefs[MAX_GREFS];
+    int gref_count;
+    uint64_t global_base;
+    uint8_t* global_init;   // Initial contents of the global area (static initialization)
+    size_t global_init_len; // Bytes through the last initialized global; the rest start zero
+    size_t global_init_cap;
+    
+    size_t main_end;       // End of the main program / module initializer
+    int frame_size;        // Stack bytes reserved by the current frame
+    int inline_depth;
+    bool object_mode;      // Compiling a .wo module (initializer returns instead of exiting)
+    
+    // Runtime helpers (bulk builtins) and their CPU dispatch
+    uint32_t rt_request;   // Helpers referenced by generated code (1 << RT_*)
+    uint32_t rt_emitted;
+    uint64_t rt_slot[RT_COUNT];  // Dispatch table entry per helper (global area)
+    int march;             // MARCH_DISPATCH, or the one variant level to emit
+    size_t cpu_init_pos;   // Call placeholder in the main prologue (0 = none)
+    uint64_t pool_chunk;   // Bytes alloc() maps at a time (selected tile pool size)
+    
+    size_t text_bias;      // Load offset of code byte 0 modulo the alignment
+    bool aligned;          // Loop heads / function entries were padded
+    struct { char name[64]; size_t start, end; } rt_syms[RT_MAX_SYMS];
+    int rt_sym_count;
+    
+    // Code layout: cold blocks awaiting the cold region, profile counters
+    ColdBlock cold[MAX_COLD_BLOCKS];
+    int cold_count;
+    struct { uint32_t kind, pos; size_t ref; int block; } prof_sites[MAX_PROF_SITES];
+    int prof_site_count;
+    const char* prof_path;  // --fate-instrument output (NULL = not instrumenting)
+    uint32_t prof_hash;     // Source hash the profile is valid for
+    
+    // Register allocation of the current function body
+    // A global entry is promoted: loaded on region entry, and written back
+    // on exit when dirty
+    struct { char name[64]; int reg; Variable* global; bool dirty; } reg_vars[MAX_REG_VARS];
+    int reg_var_count;
+    uint32_t saved_regs;   // Allocated registers (bit n = r12 + n), saved below the frame
+    
+    // Common subexpressions: source text whose value is live in r8 + slot.
+    // A primary entry (peek) may be followed by more operators
+    struct { const char* key; size_t len; bool primary; } cse[CSE_SLOTS];
+    int cse_next;          // Round-robin victim
+    
     int when_id;
     int loop_id;
     int platform;  // 1=Linux, 2=macOS, 3=Windows
     bool raw_mode;
+    bool tiny;         // --tiny: overlapped headers, globals beside the code
+    uint64_t low_literal;  // Lowest literal at or above ELF_BASE, a possible absolute address
     bool in_function;  // Currently compiling a function body
 } CodeGen;
 
-void codegen_init(CodeGen* cg) {
-    cg->code = malloc(MAX_CODE);
+// Everything but the buffers: a warm compiler (--watch) keeps those
+void codegen_reset(CodeGen* cg) {
     cg->code_pos = 0;
-    cg->code_cap = MAX_CODE;
-    cg->data = malloc(MAX_DATA);
     cg->data_pos = 0;
-    cg->data_cap = MAX_DATA;
+    cg->global_init_len = 0;
     cg->var_count = 0;
     cg->stack_size = 0;
     cg->global_var_count = 0;
@@ -540,16 +736,82 @@ void codegen_init(CodeGen* cg) {
     cg->func_count = 0;
     cg->fixup_count = 0;
     cg->label_count = 0;
+    cg->gref_count = 0;
+    cg->global_base = GLOBAL_BASE;
+    cg->main_end = 0;
+    cg->frame_size = 0;
+    cg->inline_depth = 0;
+    cg->object_mode = false;
+    cg->rt_request = 0;
+    cg->rt_emitted = 0;
+    memset(cg->rt_slot, 0, sizeof(cg->rt_slot));
+    cg->march = MARCH_DISPATCH;
+    cg->cpu_init_pos = 0;
+    cg->pool_chunk = 0x10000;
+    cg->text_bias = ELF_TEXT_OFFSET;
+    cg->aligned = false;
+    cg->rt_sym_count = 0;
+    cg->reg_var_count = 0;
+    cg->saved_regs = 0;
+    memset(cg->cse, 0, sizeof(cg->cse));
+    cg->cse_next = 0;
+    cg->cold_count = 0;
+    cg->prof_site_count = 0;
+    cg->prof_path = NULL;
+    cg->prof_hash = 0;
     cg->when_id = 0;
     cg->loop_id = 0;
     cg->platform = 1;  // Linux default
     cg->raw_mode = false;
+    cg->tiny = false;
+    cg->low_literal = UINT64_MAX;
     cg->in_function = false;
 }
 
+void codegen_init(CodeGen* cg) {
+    cg->code = malloc(MAX_CODE);
+    cg->code_cap = MAX_CODE;
+    cg->data = malloc(MAX_DATA);
+    cg->data_cap = MAX_DATA;
+    cg->global_init = NULL;
+    cg->global_init_cap = 0;
+    codegen_reset(cg);
+}
+
 void codegen_free(CodeGen* cg) {
     free(cg->code);
     free(cg->data);
+    free(cg->global_init);
+}
+
+// Cached subexpressions die at control-flow joins, calls and syscalls
+// (which clobber r8-r10), and when a variable they read is stored
+void cse_clear(CodeGen* cg) {
+    for (int i = 0; i < CSE_SLOTS; i++) cg->cse[i].key = NULL;
+}
+
+bool is_ident_char(char ch);
+
+void cse_kill_name(CodeGen* cg, const char* name) {
+    size_t n = strlen(name);
+    for (int i = 0; i < CSE_SLOTS; i++) {
+        const char* k = cg->cse[i].key;
+        size_t len = cg->cse[i].len;
+        for (size_t j = 0; k && j + n <= len; j++) {
+            if ((j == 0 || !is_ident_char(k[j - 1])) && memcmp(k + j, name, n) == 0 &&
+                (j + n == len || !is_ident_char(k[j + n]))) {
+                cg->cse[i].key = NULL;
+                break;
+            }
+        }
+    }
+}
+
+// A store to memory: cached peeks may be stale
+void cse_kill_peek(CodeGen* cg) {
+    for (int i = 0; i < CSE_SLOTS; i++) {
+        if (cg->cse[i].key && memmem(cg->cse[i].key, cg->cse[i].len, "peek", 4)) cg->cse[i].key = NULL;
+    }
 }
 
 // ═══════════════════════════════════════════════════════════════
@@ -583,6 +845,7 @@ void emit_u64(CodeGen* cg, uint64_t v) {
 // ═══════════════════════════════════════════════════════════════
 
 void add_label(CodeGen* cg, const char* name) {
+    cse_clear(cg);
     if (cg->label_count < MAX_LABELS) {
         strncpy(cg->labels[cg->label_count].name, name, 63);
         cg->labels[cg->label_count].pos = cg->code_pos;
@@ -627,6 +890,35 @@ Variable* find_var(CodeGen* cg, const char* name) {
     return NULL;
 }
 
+// Register the allocator gave a local of the current function, or 0
+int reg_lookup(CodeGen* cg, const char* name) {
+    for (int i = 0; i < cg->reg_var_count; i++) {
+        if (strcmp(cg->reg_vars[i].name, name) == 0) return cg->reg_vars[i].reg;
+    }
+    return 0;
+}
+
+// Initial value of the global at addr, through the image the ELF writers
+// put in the global area
+void global_init_set(CodeGen* cg, uint64_t addr, int64_t value) {
+    size_t off = addr - cg->global_base;
+    if (off + 8 > cg->global_init_cap) {
+        cg->global_init_cap = (off + 8) * 2;
+        cg->global_init = realloc(cg->global_init, cg->global_init_cap);
+    }
+    if (off + 8 > cg->global_init_len) {
+        memset(cg->global_init + cg->global_init_len, 0, off + 8 - cg->global_init_len);
+        cg->global_init_len = off + 8;
+    }
+    memcpy(cg->global_init + off, &value, 8);
+}
+
+// The initial value's slot, NULL when the global starts zero
+int64_t* global_init_at(CodeGen* cg, uint64_t addr) {
+    size_t off = addr - cg->global_base;
+    return off + 8 <= cg->global_init_len ? (int64_t*)(cg->global_init + off) : NULL;
+}
+
 Variable* add_var(CodeGen* cg, const char* name, VarType type) {
     if (cg->var_count >= MAX_VARS) return NULL;
     Variable* v = &cg->vars[cg->var_count++];
@@ -634,6 +926,8 @@ Variable* add_var(CodeGen* cg, const char* name, VarType type) {
     v->type = type;
     v->int_val = 0;
     v->is_param = false;
+    v->is_const = false;
+    v->reg = cg->in_function ? reg_lookup(cg, name) : 0;
     
     if (cg->in_function) {
         // Local variable: use stack relative to rbp
@@ -646,7 +940,7 @@ Variable* add_var(CodeGen* cg, const char* name, VarType type) {
         v->is_global = true;
         // Global vars stored at end of data section (after strings)
         // We'll use a fixed base address + offset
-        v->global_addr = 0x600000 + cg->global_data_pos; // Fixed base for globals
+        v->global_addr = cg->global_base + cg->global_data_pos; // Fixed base for globals
         cg->global_data_pos += 8;
         cg->global_var_count++;
         v->stack_offset = 0; // Not used for globals
@@ -675,10 +969,44 @@ void gen_pop_rbx(CodeGen* cg) { emit_byte(cg, 0x5b); }
 void gen_mov_rbp_rsp(CodeGen* cg) { emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xe5}, 3); }
 void gen_mov_rsp_rbp(CodeGen* cg) { emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xec}, 3); }
 void gen_ret(CodeGen* cg) { emit_byte(cg, 0xc3); }
-void gen_syscall(CodeGen* cg) { emit_bytes(cg, (uint8_t[]){0x0f, 0x05}, 2); }
+void gen_syscall(CodeGen* cg) {
+    emit_bytes(cg, (uint8_t[]){0x0f, 0x05}, 2);
+    cse_clear(cg);
+}
 void gen_pause(CodeGen* cg) { emit_bytes(cg, (uint8_t[]){0xf3, 0x90}, 2); }
 void gen_nop(CodeGen* cg) { emit_byte(cg, 0x90); }
 
+// n bytes of padding as the fewest recommended multi-byte NOPs (0f 1f /0)
+void gen_nops(CodeGen* cg, int n) {
+    static const uint8_t nops[9][9] = {
+        {0x90},
+        {0x66, 0x90},
+        {0x0f, 0x1f, 0x00},
+        {0x0f, 0x1f, 0x40, 0x00},
+        {0x0f, 0x1f, 0x44, 0x00, 0x00},
+        {0x66, 0x0f, 0x1f, 0x44, 0x00, 0x00},
+        {0x0f, 0x1f, 0x80, 0x00, 0x00, 0x00, 0x00},
+        {0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},
+        {0x66, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},
+    };
+    while (n > 0) {
+        int k = n > 9 ? 9 : n;
+        emit_bytes(cg, (uint8_t*)nops[k - 1], k);
+        n -= k;
+    }
+}
+
+// Pad so the next label lands on an align boundary of the loaded image;
+// skipped when it would take more than max_skip bytes. True when it lands
+bool gen_align(CodeGen* cg, int align, int max_skip) {
+    if (align <= 1) return false;
+    cg->aligned = true;
+    int pad = (int)((align - (cg->text_bias + cg->code_pos) % align) % align);
+    if (pad > max_skip) return false;
+    gen_nops(cg, pad);
+    return true;
+}
+
 void gen_sub_rsp(CodeGen* cg, int32_t n) {
     emit_bytes(cg, (uint8_t[]){0x48, 0x81, 0xec}, 3);
     emit_i32(cg, n);
@@ -734,10 +1062,20 @@ void gen_mov_rbp_off_rax(CodeGen* cg, int32_t off) {
     emit_i32(cg, off);
 }
 
+// Record an imm64 holding a global address so the linker can rebase it
+void add_gref(CodeGen* cg, uint64_t addr) {
+    if (cg->gref_count < MAX_GREFS) {
+        cg->grefs[cg->gref_count].pos = cg->code_pos;
+        cg->grefs[cg->gref_count].off = (uint32_t)(addr - cg->global_base);
+        cg->gref_count++;
+    }
+}
+
 // Load from absolute address: mov rax, [addr]
 void gen_mov_rax_abs(CodeGen* cg, uint64_t addr) {
     // movabs rax, addr; mov rax, [rax]
     emit_bytes(cg, (uint8_t[]){0x48, 0xb8}, 2);  // movabs rax, imm64
+    add_gref(cg, addr);
     emit_u64(cg, addr);
     emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x00}, 3);  // mov rax, [rax]
 }
@@ -747,14 +1085,85 @@ void gen_mov_abs_rax(CodeGen* cg, uint64_t addr) {
     // push rax; movabs rbx, addr; pop rax; mov [rbx], rax
     emit_byte(cg, 0x50);  // push rax
     emit_bytes(cg, (uint8_t[]){0x48, 0xbb}, 2);  // movabs rbx, imm64
+    add_gref(cg, addr);
     emit_u64(cg, addr);
     emit_byte(cg, 0x58);  // pop rax
     emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x03}, 3);  // mov [rbx], rax
 }
 
 // Load variable (global or local)
+// mov rax, rN / mov rN, rax for an allocated register (r8-r15)
+void gen_mov_rax_reg(CodeGen* cg, int reg) {
+    emit_bytes(cg, (uint8_t[]){0x4c, 0x89, 0xc0 | (reg - 8) << 3}, 3);
+}
+
+void gen_mov_reg_rax(CodeGen* cg, int reg) {
+    emit_bytes(cg, (uint8_t[]){0x49, 0x89, 0xc0 | (reg - 8)}, 3);
+}
+
+// Allocated registers are pushed right below the frame on entry and popped
+// at the end of the body
+void gen_save_regs(CodeGen* cg, uint32_t mask) {
+    for (int r = 0; r < REG_ALLOC_COUNT; r++) {
+        if (mask & (1u << r)) emit_bytes(cg, (uint8_t[]){0x41, 0x50 + REG_ALLOC_FIRST - 8 + r}, 2);
+    }
+}
+
+void gen_pop_regs(CodeGen* cg, uint32_t mask) {
+    for (int r = REG_ALLOC_COUNT - 1; r >= 0; r--) {
+        if (mask & (1u << r)) emit_bytes(cg, (uint8_t[]){0x41, 0x58 + REG_ALLOC_FIRST - 8 + r}, 2);
+    }
+}
+
+// Store dirty promoted globals back to memory (preserves rax)
+void gen_writeback_globals(CodeGen* cg) {
+    for (int i = 0; i < cg->reg_var_count; i++) {
+        if (!cg->reg_vars[i].global || !cg->reg_vars[i].dirty) continue;
+        emit_bytes(cg, (uint8_t[]){0x48, 0xbb}, 2);  // movabs rbx, addr
+        add_gref(cg, cg->reg_vars[i].global->global_addr);
+        emit_u64(cg, cg->reg_vars[i].global->global_addr);
+        // mov [rbx], rN
+        emit_bytes(cg, (uint8_t[]){0x4c, 0x89, 0x03 | (cg->reg_vars[i].reg - 8) << 3}, 3);
+    }
+}
+
+// Load promoted globals into their registers on region entry
+void gen_promote_globals(CodeGen* cg) {
+    for (int i = 0; i < cg->reg_var_count; i++) {
+        Variable* v = cg->reg_vars[i].global;
+        if (!v) continue;
+        gen_mov_rax_abs(cg, v->global_addr);
+        gen_mov_reg_rax(cg, cg->reg_vars[i].reg);
+        v->reg = cg->reg_vars[i].reg;
+    }
+}
+
+// End of the promoted region: globals are back in memory
+void reg_release(CodeGen* cg) {
+    for (int i = 0; i < cg->reg_var_count; i++) {
+        if (cg->reg_vars[i].global) cg->reg_vars[i].global->reg = 0;
+    }
+    cg->reg_var_count = 0;
+}
+
+// Reload the saved registers from the frame, before an early return
+void gen_restore_regs(CodeGen* cg) {
+    int slot = 0;
+    for (int r = 0; r < REG_ALLOC_COUNT; r++) {
+        if (!(cg->saved_regs & (1u << r))) continue;
+        slot++;
+        // mov rN, [rbp - frame_size - 8 * slot]
+        emit_bytes(cg, (uint8_t[]){0x4c, 0x8b, 0x85 | (REG_ALLOC_FIRST - 8 + r) << 3}, 3);
+        emit_i32(cg, -cg->frame_size - 8 * slot);
+    }
+}
+
 void gen_load_var(CodeGen* cg, Variable* v) {
-    if (v->is_global) {
+    if (v->is_const) {
+        gen_mov_rax_imm(cg, v->int_val);
+    } else if (v->reg) {
+        gen_mov_rax_reg(cg, v->reg);
+    } else if (v->is_global) {
         gen_mov_rax_abs(cg, v->global_addr);
     } else {
         gen_mov_rax_rbp_off(cg, v->stack_offset);
@@ -763,7 +1172,10 @@ void gen_load_var(CodeGen* cg, Variable* v) {
 
 // Store variable (global or local)
 void gen_store_var(CodeGen* cg, Variable* v) {
-    if (v->is_global) {
+    cse_kill_name(cg, v->name);
+    if (v->reg) {
+        gen_mov_reg_rax(cg, v->reg);
+    } else if (v->is_global) {
         gen_mov_abs_rax(cg, v->global_addr);
     } else {
         gen_mov_rbp_off_rax(cg, v->stack_offset);
@@ -774,6 +1186,69 @@ void gen_mul_rax_rbx(CodeGen* cg) {
     emit_bytes(cg, (uint8_t[]){0x48, 0x0f, 0xaf, 0xc3}, 4);
 }
 
+// lea rax, [rax + rax * (k - 1)] for k = 3, 5, 9
+void gen_lea_mul(CodeGen* cg, int64_t k) {
+    uint8_t sib = k == 3 ? 0x40 : k == 5 ? 0x80 : 0xc0;
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8d, 0x04, sib}, 4);
+}
+
+void gen_shl_rax(CodeGen* cg, int n) {
+    if (n) emit_bytes(cg, (uint8_t[]){0x48, 0xc1, 0xe0, n}, 4);
+}
+
+// rax *= k. imul costs 3 cycles, so anything expressible in at most two
+// single-cycle shift/lea/add steps is strength-reduced; the rest use imul
+// with an immediate instead of loading the constant into rbx
+void gen_mul_rax_imm(CodeGen* cg, int64_t k) {
+    uint64_t u = (uint64_t)k;
+    if (k == 0) {
+        emit_bytes(cg, (uint8_t[]){0x31, 0xc0}, 2);              // xor eax, eax
+        return;
+    }
+    if (k == 1) return;
+    if (k == -1) {
+        emit_bytes(cg, (uint8_t[]){0x48, 0xf7, 0xd8}, 3);        // neg rax
+        return;
+    }
+    if (k > 0) {
+        int tz = __builtin_ctzll(u);
+        int64_t odd = k >> tz;
+        if (odd == 1) { gen_shl_rax(cg, tz); return; }
+        if (odd == 3 || odd == 5 || odd == 9) {
+            gen_lea_mul(cg, odd);
+            gen_shl_rax(cg, tz);
+            return;
+        }
+        static const int64_t leas[3] = {3, 5, 9};
+        for (int a = 0; a < 3 && tz == 0; a++) {
+            for (int b = 0; b < 3; b++) {
+                if (leas[a] * leas[b] != k) continue;
+                gen_lea_mul(cg, leas[a]);
+                gen_lea_mul(cg, leas[b]);
+                return;
+            }
+        }
+        // 2^n + 1 and 2^n - 1: mov rbx, rax; shl rax, n; add/sub rax, rbx
+        bool plus = (u - 1) && !((u - 1) & (u - 2));
+        bool minus = !((u + 1) & u);
+        if (tz == 0 && (plus || minus)) {
+            int n = __builtin_ctzll(plus ? u - 1 : u + 1);
+            emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xc3}, 3);
+            gen_shl_rax(cg, n);
+            emit_bytes(cg, (uint8_t[]){0x48, plus ? 0x01 : 0x29, 0xd8}, 3);
+            return;
+        }
+    }
+    if (k >= INT32_MIN && k <= INT32_MAX) {
+        emit_bytes(cg, (uint8_t[]){0x48, 0x69, 0xc0}, 3);        // imul rax, rax, imm32
+        emit_i32(cg, (int32_t)k);
+        return;
+    }
+    emit_bytes(cg, (uint8_t[]){0x48, 0xbb}, 2);                   // movabs rbx, k
+    emit_u64(cg, u);
+    gen_mul_rax_rbx(cg);
+}
+
 void gen_div_rax_rbx(CodeGen* cg) {
     emit_bytes(cg, (uint8_t[]){0x48, 0x99}, 2);
     emit_bytes(cg, (uint8_t[]){0x48, 0xf7, 0xfb}, 3);
@@ -801,9 +1276,11 @@ void gen_jmp(CodeGen* cg, const char* label) {
 void gen_call(CodeGen* cg, const char* label) {
     emit_byte(cg, 0xe8);
     add_fixup(cg, label);
+    cse_clear(cg);
 }
 
 void gen_exit(CodeGen* cg, int code) {
+    if (cg->prof_path) gen_call(cg, "_rt_prof_dump");
     gen_mov_rax_imm(cg, 60);  // Linux sys_exit
     gen_mov_rdi_imm(cg, code);
     gen_syscall(cg);
@@ -813,6 +1290,7 @@ void gen_exit(CodeGen* cg, int code) {
 void gen_exit_rax(CodeGen* cg) {
     // mov rdi, rax
     emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xc7}, 3);
+    if (cg->prof_path) gen_call(cg, "_rt_prof_dump");  // Preserves rdi
     gen_mov_rax_imm(cg, 60);  // Linux sys_exit
     gen_syscall(cg);
 }
@@ -834,126 +1312,1271 @@ void gen_event_loop(CodeGen* cg) {
 }
 
 // ═══════════════════════════════════════════════════════════════
-// ELF Generator
+// Runtime helpers - Bulk builtins with CPU dispatch
 // ═══════════════════════════════════════════════════════════════
+//
+// copy(dst, src, n) and fill(dst, byte, n) are emitted once per program in
+// SSE2, AVX2 and AVX-512 variants (rdi, rsi, rdx in; rax = dst out). The
+// main prologue calls _rt_cpu_init, which runs CPUID/XGETBV once and stores
+// the best variant of each helper in its dispatch slot; call sites do
+// "call [slot]". With --march the target is known: only that variant is
+// emitted and call sites call it directly.
+//
+// alloc(n) has a single variant; its slot holds the pool state instead.
+// So do the timer builtins, which share one slot: the timer wheel.
+
+const char* rt_names[RT_COUNT] = { "copy", "fill", "alloc", "after", "every", "cancel", "tick", "timers" };
+const int rt_argc[RT_COUNT] = { 3, 3, 1, 2, 2, 1, 0, 0 };
+const bool rt_variants[RT_COUNT] = { true, true, false, false, false, false, false, false };
+const char* march_names[] = { "dispatch", "sse2", "avx2", "avx512" };
+
+int rt_builtin(const char* name) {
+    for (int i = 0; i < RT_COUNT; i++) {
+        if (strcmp(rt_names[i], name) == 0) return i;
+    }
+    return -1;
+}
 
-void write_elf(CodeGen* cg, const char* filename) {
-    FILE* f = fopen(filename, "wb");
-    if (!f) return;
+void rt_label(char* out, int rt, int level) {
+    if (!rt_variants[rt]) sprintf(out, "_rt_%s", rt_names[rt]);
+    else sprintf(out, "_rt_%s_%s", rt_names[rt], march_names[level]);
+}
+
+// Hidden global area for a helper (dispatch entry or runtime state)
+uint64_t rt_slot(CodeGen* cg, int rt, int bytes) {
+    if (!cg->rt_slot[rt]) {
+        cg->rt_slot[rt] = cg->global_base + cg->global_data_pos;
+        cg->global_data_pos += bytes;
+    }
+    return cg->rt_slot[rt];
+}
+
+// Host instruction set level, for --march=native and the JIT tier
+int march_host(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return MARCH_V4;
+    if (__builtin_cpu_supports("avx2")) return MARCH_V3;
+    return MARCH_V2;
+}
+
+// Call helper rt with its arguments already in rdi, rsi, rdx
+void gen_rt_call(CodeGen* cg, int rt) {
+    cg->rt_request |= 1u << rt;
+    if (cg->march != MARCH_DISPATCH || !rt_variants[rt]) {
+        char label[64];
+        rt_label(label, rt, cg->march);
+        gen_call(cg, label);
+        return;
+    }
+    gen_mov_rax_abs(cg, rt_slot(cg, rt, 8));
+    emit_bytes(cg, (uint8_t[]){0xff, 0xd0}, 2);  // call rax
+    cse_clear(cg);
+}
+
+void rt_add_sym(CodeGen* cg, const char* name, size_t start) {
+    if (cg->rt_sym_count < RT_MAX_SYMS) {
+        strcpy(cg->rt_syms[cg->rt_sym_count].name, name);
+        cg->rt_syms[cg->rt_sym_count].start = start;
+        cg->rt_syms[cg->rt_sym_count].end = cg->code_pos;
+        cg->rt_sym_count++;
+    }
+}
+
+// Point a rel8 jump displacement at pos to the current position
+void rt_patch_rel8(CodeGen* cg, size_t pos) {
+    cg->code[pos] = (uint8_t)(cg->code_pos - pos - 1);
+}
+
+// Block loop moving width bytes per step (load is NULL for fill), then a
+// byte loop for the remainder
+void rt_emit_bulk(CodeGen* cg, uint8_t width, const uint8_t* load, const uint8_t* store,
+                  int vec_len, const uint8_t* tail, int tail_len) {
+    size_t head = cg->code_pos;
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0xfa, width}, 4);  // cmp rdx, width
+    emit_bytes(cg, (uint8_t[]){0x72, 0x00}, 2);               // jb tail
+    size_t to_tail = cg->code_pos - 1;
+    if (load) emit_bytes(cg, load, vec_len);
+    emit_bytes(cg, store, vec_len);
+    if (load) emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0xc6, width}, 4);  // add rsi, width
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0xc7, width}, 4);  // add rdi, width
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0xea, width}, 4);  // sub rdx, width
+    emit_bytes(cg, (uint8_t[]){0xeb, (uint8_t)(head - cg->code_pos - 2)}, 2);
+    rt_patch_rel8(cg, to_tail);
+    
+    size_t tail_head = cg->code_pos;
+    emit_bytes(cg, (uint8_t[]){0x48, 0x85, 0xd2, 0x74, 0x00}, 5);  // test rdx, rdx; jz done
+    size_t to_done = cg->code_pos - 1;
+    emit_bytes(cg, tail, tail_len);
+    emit_bytes(cg, (uint8_t[]){0x48, 0xff, 0xc7, 0x48, 0xff, 0xca}, 6);  // inc rdi; dec rdx
+    emit_bytes(cg, (uint8_t[]){0xeb, (uint8_t)(tail_head - cg->code_pos - 2)}, 2);
+    rt_patch_rel8(cg, to_done);
+}
+
+void rt_emit_variant(CodeGen* cg, int rt, int level) {
+    // Vector move between register 0 and [rsi] / [rdi], per level
+    static const uint8_t loads[4][6] = {
+        {0}, {0xf3, 0x0f, 0x6f, 0x06},                 // movdqu xmm0, [rsi]
+        {0xc5, 0xfe, 0x6f, 0x06},                      // vmovdqu ymm0, [rsi]
+        {0x62, 0xf1, 0xfe, 0x48, 0x6f, 0x06},          // vmovdqu64 zmm0, [rsi]
+    };
+    static const uint8_t stores[4][6] = {
+        {0}, {0xf3, 0x0f, 0x7f, 0x07},                 // movdqu [rdi], xmm0
+        {0xc5, 0xfe, 0x7f, 0x07},                      // vmovdqu [rdi], ymm0
+        {0x62, 0xf1, 0xfe, 0x48, 0x7f, 0x07},          // vmovdqu64 [rdi], zmm0
+    };
+    static const uint8_t copy_tail[] = {0x8a, 0x0e, 0x88, 0x0f, 0x48, 0xff, 0xc6};  // mov cl,[rsi]; mov [rdi],cl; inc rsi
+    static const uint8_t fill_tail[] = {0x88, 0x0f};  // mov [rdi], cl
+    
+    char label[64];
+    rt_label(label, rt, level);
+    size_t start = cg->code_pos;
+    add_label(cg, label);
+    
+    if (rt == RT_FILL) {
+        // rcx = byte * 0x0101010101010101, broadcast into register 0
+        emit_bytes(cg, (uint8_t[]){0x40, 0x0f, 0xb6, 0xf6}, 4);  // movzx esi, sil
+        emit_bytes(cg, (uint8_t[]){0x48, 0xb9}, 2);              // movabs rcx, imm64
+        emit_u64(cg, 0x0101010101010101ULL);
+        emit_bytes(cg, (uint8_t[]){0x48, 0x0f, 0xaf, 0xce}, 4);  // imul rcx, rsi
+        if (level == MARCH_V2) {
+            emit_bytes(cg, (uint8_t[]){0x66, 0x48, 0x0f, 0x6e, 0xc1}, 5);  // movq xmm0, rcx
+            emit_bytes(cg, (uint8_t[]){0x66, 0x0f, 0x6c, 0xc0}, 4);        // punpcklqdq xmm0, xmm0
+        } else if (level == MARCH_V3) {
+            emit_bytes(cg, (uint8_t[]){0xc4, 0xe1, 0xf9, 0x6e, 0xc1}, 5);  // vmovq xmm0, rcx
+            emit_bytes(cg, (uint8_t[]){0xc4, 0xe2, 0x7d, 0x59, 0xc0}, 5);  // vpbroadcastq ymm0, xmm0
+        } else {
+            emit_bytes(cg, (uint8_t[]){0x62, 0xf2, 0xfd, 0x48, 0x7c, 0xc1}, 6);  // vpbroadcastq zmm0, rcx
+        }
+    }
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xf8}, 3);  // mov rax, rdi
     
-    uint64_t base = 0x400000;
-    uint64_t entry = base + 120;
-    size_t total_size = cg->code_pos + cg->data_pos;
+    int vec_len = level == MARCH_V4 ? 6 : 4;
+    if (rt == RT_COPY) {
+        rt_emit_bulk(cg, 8 << level, loads[level], stores[level], vec_len,
+                     copy_tail, sizeof(copy_tail));
+    } else {
+        rt_emit_bulk(cg, 8 << level, NULL, stores[level], vec_len,
+                     fill_tail, sizeof(fill_tail));
+    }
+    if (level != MARCH_V2) emit_bytes(cg, (uint8_t[]){0xc5, 0xf8, 0x77}, 3);  // vzeroupper
+    gen_ret(cg);
+    rt_add_sym(cg, label, start);
+}
+
+// _rt_alloc: bump allocator over pool chunks (rdi = n, rax = 16-byte aligned
+// block, 0 when out of memory). State is {cur, end} in its slot. Chunks of
+// HUGE_PAGE_SIZE or more try MAP_HUGETLB first, then fall back to a 2MB
+// aligned anonymous mapping marked MADV_HUGEPAGE.
+void rt_emit_alloc(CodeGen* cg) {
+    uint64_t cur = rt_slot(cg, RT_ALLOC, 16);
+    uint64_t end = cur + 8;
+    bool huge = cg->pool_chunk >= HUGE_PAGE_SIZE;
+    size_t start = cg->code_pos;
+    add_label(cg, "_rt_alloc");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0xc7, 0x0f}, 4);   // add rdi, 15
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0xe7, 0xf0}, 4);   // and rdi, -16
+    gen_mov_rax_abs(cg, cur);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8d, 0x0c, 0x38}, 4);   // lea rcx, [rax+rdi]
+    emit_byte(cg, 0x50);                                      // push rax
+    gen_mov_rax_abs(cg, end);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x39, 0xc1}, 3);         // cmp rcx, rax
+    emit_byte(cg, 0x58);                                      // pop rax
+    emit_bytes(cg, (uint8_t[]){0x0f, 0x87}, 2);               // ja grow
+    add_fixup(cg, "_rt_alloc_grow");
+    emit_byte(cg, 0x50);                                      // push rax
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xc8}, 3);         // mov rax, rcx
+    gen_mov_abs_rax(cg, cur);
+    emit_byte(cg, 0x58);                                      // pop rax
+    gen_ret(cg);
     
-    uint8_t ehdr[64] = {0};
-    ehdr[0] = 0x7f; ehdr[1] = 'E'; ehdr[2] = 'L'; ehdr[3] = 'F';
-    ehdr[4] = 2; ehdr[5] = 1; ehdr[6] = 1;
-    ehdr[16] = 2; ehdr[18] = 0x3e; ehdr[20] = 1;
-    memcpy(ehdr + 24, &entry, 8);
-    uint64_t phoff = 64;
-    memcpy(ehdr + 32, &phoff, 8);
-    ehdr[52] = 64; ehdr[54] = 56; ehdr[56] = 1;
+    // New chunk: size = max(n, pool_chunk) rounded to the page size
+    add_label(cg, "_rt_alloc_grow");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xfb}, 3);         // mov rbx, rdi
+    emit_bytes(cg, (uint8_t[]){0x48, 0xbe}, 2);               // movabs rsi, chunk
+    emit_u64(cg, cg->pool_chunk);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x39, 0xf7}, 3);         // cmp rdi, rsi
+    emit_bytes(cg, (uint8_t[]){0x48, 0x0f, 0x47, 0xf7}, 4);   // cmova rsi, rdi
+    uint32_t page = huge ? HUGE_PAGE_SIZE : 0x1000;
+    emit_bytes(cg, (uint8_t[]){0x48, 0x81, 0xc6}, 3);         // add rsi, page - 1
+    emit_u32(cg, page - 1);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x81, 0xe6}, 3);         // and rsi, -page
+    emit_u32(cg, (uint32_t)-page);
+    emit_byte(cg, 0x56);                                      // push rsi
+    emit_bytes(cg, (uint8_t[]){0x31, 0xff}, 2);               // xor edi, edi
+    emit_bytes(cg, (uint8_t[]){0xba, 0x03, 0x00, 0x00, 0x00}, 5);  // mov edx, PROT_READ|PROT_WRITE
+    emit_bytes(cg, (uint8_t[]){0x49, 0xc7, 0xc0, 0xff, 0xff, 0xff, 0xff}, 7);  // mov r8, -1
+    emit_bytes(cg, (uint8_t[]){0x45, 0x31, 0xc9}, 3);         // xor r9d, r9d
+    if (huge) {
+        emit_bytes(cg, (uint8_t[]){0x41, 0xba, 0x22, 0x00, 0x04, 0x00}, 6);  // mov r10d, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB
+        gen_mov_rax_imm(cg, 9);                               // sys_mmap
+        gen_syscall(cg);
+        emit_bytes(cg, (uint8_t[]){0x48, 0x3d, 0x00, 0xf0, 0xff, 0xff}, 6);  // cmp rax, -4096
+        emit_bytes(cg, (uint8_t[]){0x0f, 0x82}, 2);           // jb mapped
+        add_fixup(cg, "_rt_alloc_mapped");
+        // No hugetlbfs pages: over-map by 2MB, align, ask for THP
+        emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x34, 0x24}, 4);  // mov rsi, [rsp]
+        emit_bytes(cg, (uint8_t[]){0x48, 0x81, 0xc6}, 3);     // add rsi, 2MB
+        emit_u32(cg, HUGE_PAGE_SIZE);
+    }
+    emit_bytes(cg, (uint8_t[]){0x41, 0xba, 0x22, 0x00, 0x00, 0x00}, 6);  // mov r10d, MAP_PRIVATE|MAP_ANONYMOUS
+    gen_mov_rax_imm(cg, 9);
+    gen_syscall(cg);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x3d, 0x00, 0xf0, 0xff, 0xff}, 6);  // cmp rax, -4096
+    emit_bytes(cg, (uint8_t[]){0x0f, 0x83}, 2);               // jae fail
+    add_fixup(cg, "_rt_alloc_fail");
+    if (huge) {
+        emit_bytes(cg, (uint8_t[]){0x48, 0x05, 0xff, 0xff, 0x1f, 0x00}, 6);  // add rax, 2MB - 1
+        emit_bytes(cg, (uint8_t[]){0x48, 0x25, 0x00, 0x00, 0xe0, 0xff}, 6);  // and rax, -2MB
+        emit_byte(cg, 0x50);                                  // push rax
+        emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xc7}, 3);     // mov rdi, rax
+        emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x74, 0x24, 0x08}, 5);  // mov rsi, [rsp+8]
+        emit_bytes(cg, (uint8_t[]){0xba, 0x0e, 0x00, 0x00, 0x00}, 5);  // mov edx, MADV_HUGEPAGE
+        gen_mov_rax_imm(cg, 28);                              // sys_madvise
+        gen_syscall(cg);
+        emit_byte(cg, 0x58);                                  // pop rax
+    }
     
-    uint8_t phdr[56] = {0};
-    uint32_t p_type = 1, p_flags = 7;
-    memcpy(phdr + 0, &p_type, 4);
-    memcpy(phdr + 4, &p_flags, 4);
-    uint64_t file_size = 120 + total_size;
-    // mem_size needs to cover global variable area at 0x600000+
-    // Global vars are at 0x600000, so we need at least 0x200000 + globals
-    uint64_t global_size = cg->global_data_pos > 0 ? cg->global_data_pos : 0x1000;
-    uint64_t mem_size = 0x600000 - base + global_size + 0x10000; // Cover 0x400000 to 0x600000+globals
-    memcpy(phdr + 16, &base, 8);
-    memcpy(phdr + 24, &base, 8);
-    memcpy(phdr + 32, &file_size, 8);
-    memcpy(phdr + 40, &mem_size, 8);
-    uint64_t align = 0x1000;
-    memcpy(phdr + 48, &align, 8);
+    // rax = chunk base, [rsp] = chunk size, rbx = n
+    add_label(cg, "_rt_alloc_mapped");
+    emit_byte(cg, 0x5e);                                      // pop rsi
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8d, 0x0c, 0x18}, 4);   // lea rcx, [rax+rbx]
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8d, 0x14, 0x30}, 4);   // lea rdx, [rax+rsi]
+    emit_byte(cg, 0x50);                                      // push rax
+    emit_byte(cg, 0x51);                                      // push rcx
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xd0}, 3);         // mov rax, rdx
+    gen_mov_abs_rax(cg, end);
+    emit_byte(cg, 0x58);                                      // pop rax
+    gen_mov_abs_rax(cg, cur);
+    emit_byte(cg, 0x58);                                      // pop rax
+    gen_ret(cg);
     
-    fwrite(ehdr, 1, 64, f);
-    fwrite(phdr, 1, 56, f);
-    fwrite(cg->code, 1, cg->code_pos, f);
-    fwrite(cg->data, 1, cg->data_pos, f);
-    fclose(f);
-    chmod(filename, 0755);
-}
-
-void write_raw(CodeGen* cg, const char* filename) {
-    FILE* f = fopen(filename, "wb");
-    if (!f) return;
-    fwrite(cg->code, 1, cg->code_pos, f);
-    fclose(f);
+    // Out of memory (a limit): degrade to a chunk of just n bytes once
+    add_label(cg, "_rt_alloc_fail");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8d, 0xb3, 0xff, 0x0f, 0x00, 0x00}, 7);  // lea rsi, [rbx + 4095]
+    emit_bytes(cg, (uint8_t[]){0x48, 0x81, 0xe6, 0x00, 0xf0, 0xff, 0xff}, 7);  // and rsi, -4096
+    emit_bytes(cg, (uint8_t[]){0x48, 0x3b, 0x34, 0x24}, 4);   // cmp rsi, [rsp]
+    emit_bytes(cg, (uint8_t[]){0x0f, 0x83}, 2);               // jae none
+    add_fixup(cg, "_rt_alloc_none");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x34, 0x24}, 4);   // mov [rsp], rsi
+    emit_bytes(cg, (uint8_t[]){0x31, 0xff}, 2);               // xor edi, edi
+    emit_bytes(cg, (uint8_t[]){0xba, 0x03, 0x00, 0x00, 0x00}, 5);  // mov edx, PROT_READ|PROT_WRITE
+    emit_bytes(cg, (uint8_t[]){0x49, 0xc7, 0xc0, 0xff, 0xff, 0xff, 0xff}, 7);  // mov r8, -1
+    emit_bytes(cg, (uint8_t[]){0x45, 0x31, 0xc9}, 3);         // xor r9d, r9d
+    emit_bytes(cg, (uint8_t[]){0x41, 0xba, 0x22, 0x00, 0x00, 0x00}, 6);  // mov r10d, MAP_PRIVATE|MAP_ANONYMOUS
+    gen_mov_rax_imm(cg, 9);
+    gen_syscall(cg);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x3d, 0x00, 0xf0, 0xff, 0xff}, 6);  // cmp rax, -4096
+    emit_bytes(cg, (uint8_t[]){0x0f, 0x82}, 2);               // jb mapped
+    add_fixup(cg, "_rt_alloc_mapped");
+    add_label(cg, "_rt_alloc_none");
+    emit_byte(cg, 0x5e);                                      // pop rsi
+    emit_bytes(cg, (uint8_t[]){0x31, 0xc0}, 2);               // xor eax, eax
+    gen_ret(cg);
+    rt_add_sym(cg, "_rt_alloc", start);
 }
 
 // ═══════════════════════════════════════════════════════════════
-// Compiler
+// Timers - Hierarchical timer wheel on a timerfd
 // ═══════════════════════════════════════════════════════════════
+//
+// after(ms, fn) and every(ms, fn) return a handle for cancel(handle);
+// tick() waits for the timerfd, advances the wheel by the ticks that
+// elapsed and calls the due callbacks; timers() is the timerfd, for an
+// epoll loop to wait on. The timerfd ticks every TIMER_TICK_NS while any
+// timer is pending and is disarmed otherwise.
+//
+// The wheel is TIMER_LEVELS levels of 64 slots (the classic hashed
+// hierarchical layout): a timer due within 64 ticks hangs off level 0 at
+// expires & 63, within 64^2 off level 1 at (expires >> 6) & 63, and so on.
+// When level 0 wraps, the next level's current slot is cascaded down.
+// Slots are singly linked lists whose nodes keep the address of the
+// pointer to them, so insert and cancel are O(1) and a tick costs the
+// same however many timers are pending.
+//
+// Node (48 bytes, from alloc and then a free list):
+//   next pprev expires fn period generation
+// A handle is the node address with the generation in its top 16 bits,
+// so cancelling a timer that has already fired is a no-op.
+
+// movabs rcx, timer state
+void rt_timer_state(CodeGen* cg, uint64_t state) {
+    emit_bytes(cg, (uint8_t[]){0x48, 0xb9}, 2);
+    add_gref(cg, state);
+    emit_u64(cg, state);
+}
 
-typedef struct Compiler Compiler;
+// jcc rel32 to label (cc: 0x82 jb, 0x83 jae, 0x86 jbe, 0x88 js, 0x8e jle)
+void rt_jcc(CodeGen* cg, uint8_t cc, const char* label) {
+    emit_bytes(cg, (uint8_t[]){0x0f, cc}, 2);
+    add_fixup(cg, label);
+}
 
-struct Compiler {
-    const char* source;
-    size_t pos;
-    size_t len;
-    bool fate_mode;
-    int loop_depth;
-    char loop_labels[16][2][64];
+void rt_emit_timers(CodeGen* cg) {
+    uint64_t state = rt_slot(cg, RT_AFTER, TIMER_STATE + TIMER_LEVELS * 64 * 8);
+    size_t start = cg->code_pos;
+    
+    // _rt_timer_link: rdi = node, into the slot for its expiry
+    add_label(cg, "_rt_timer_link");
+    rt_timer_state(cg, state);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x47, 0x10}, 4);  // mov rax, [rdi+16] (expires)
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xc2}, 3);        // mov rdx, rax
+    emit_bytes(cg, (uint8_t[]){0x48, 0x2b, 0x11}, 3);        // sub rdx, [rcx] (ticks ahead)
+    emit_bytes(cg, (uint8_t[]){0x31, 0xf6}, 2);              // xor esi, esi (level)
+    emit_bytes(cg, (uint8_t[]){0x48, 0x85, 0xd2}, 3);        // test rdx, rdx
+    rt_jcc(cg, 0x88, "_rt_timer_due");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x81, 0xfa, 0xff, 0xff, 0xff, 0x00}, 7);  // cmp rdx, 2^24 - 1
+    rt_jcc(cg, 0x86, "_rt_timer_level");
+    emit_bytes(cg, (uint8_t[]){0xba, 0xff, 0xff, 0xff, 0x00}, 5);  // mov edx, 2^24 - 1
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x01}, 3);        // mov rax, [rcx]
+    emit_bytes(cg, (uint8_t[]){0x48, 0x01, 0xd0}, 3);        // add rax, rdx (farthest slot)
+    add_label(cg, "_rt_timer_level");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0xfa, 0x40}, 4);  // cmp rdx, 64
+    rt_jcc(cg, 0x82, "_rt_timer_slot");
+    emit_bytes(cg, (uint8_t[]){0x48, 0xc1, 0xea, 0x06}, 4);  // shr rdx, 6
+    emit_bytes(cg, (uint8_t[]){0x48, 0xc1, 0xe8, 0x06}, 4);  // shr rax, 6
+    emit_bytes(cg, (uint8_t[]){0xff, 0xc6}, 2);              // inc esi
+    gen_jmp(cg, "_rt_timer_level");
+    add_label(cg, "_rt_timer_due");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x01}, 3);        // mov rax, [rcx] (the next tick's slot)
+    add_label(cg, "_rt_timer_slot");
+    emit_bytes(cg, (uint8_t[]){0x83, 0xe0, 0x3f}, 3);        // and eax, 63
+    emit_bytes(cg, (uint8_t[]){0xc1, 0xe6, 0x06}, 3);        // shl esi, 6
+    emit_bytes(cg, (uint8_t[]){0x01, 0xf0}, 2);              // add eax, esi
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8d, 0x44, 0xc1, TIMER_STATE}, 5);  // lea rax, [rcx + rax*8 + wheels]
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x10}, 3);        // mov rdx, [rax]
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x17}, 3);        // mov [rdi], rdx
+    emit_bytes(cg, (uint8_t[]){0x48, 0x85, 0xd2, 0x74, 0x04}, 5);  // test rdx, rdx; jz +4
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x7a, 0x08}, 4);  // mov [rdx+8], rdi
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x38}, 3);        // mov [rax], rdi
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x47, 0x08}, 4);  // mov [rdi+8], rax
+    gen_ret(cg);
     
-    UnifiedField unified;
-    TileManager tile;
-    FateScheduler fate;
-    CodeGen codegen;
+    // _rt_timer_unlink: rdi = node (kept), pprev cleared
+    add_label(cg, "_rt_timer_unlink");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x47, 0x08}, 4);  // mov rax, [rdi+8]
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x17}, 3);        // mov rdx, [rdi]
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x10}, 3);        // mov [rax], rdx
+    emit_bytes(cg, (uint8_t[]){0x48, 0x85, 0xd2, 0x74, 0x04}, 5);  // test rdx, rdx; jz +4
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x42, 0x08}, 4);  // mov [rdx+8], rax
+    emit_bytes(cg, (uint8_t[]){0x48, 0xc7, 0x47, 0x08, 0x00, 0x00, 0x00, 0x00}, 8);  // mov qword [rdi+8], 0
+    gen_ret(cg);
     
-    // Compatibility layer (minimal universal)
-    Platform platform;
-    Bridge bridge;
-    Compat compat;
+    // _rt_timer_arm: rdx = period in ns, 0 disarms
+    add_label(cg, "_rt_timer_arm");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0xec, 0x20}, 4);  // sub rsp, 32 (itimerspec)
+    emit_bytes(cg, (uint8_t[]){0x48, 0xc7, 0x04, 0x24, 0x00, 0x00, 0x00, 0x00}, 8);  // interval.tv_sec = 0
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x54, 0x24, 0x08}, 5);  // interval.tv_nsec = rdx
+    emit_bytes(cg, (uint8_t[]){0x48, 0xc7, 0x44, 0x24, 0x10, 0x00, 0x00, 0x00, 0x00}, 9);  // value.tv_sec = 0
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x54, 0x24, 0x18}, 5);  // value.tv_nsec = rdx
+    rt_timer_state(cg, state);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x79, 0x10}, 4);  // mov rdi, [rcx+16] (timerfd)
+    emit_bytes(cg, (uint8_t[]){0x31, 0xf6}, 2);              // xor esi, esi
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xe2}, 3);        // mov rdx, rsp
+    emit_bytes(cg, (uint8_t[]){0x45, 0x31, 0xd2}, 3);        // xor r10d, r10d
+    gen_mov_rax_imm(cg, 286);                                 // sys_timerfd_settime
+    gen_syscall(cg);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0xc4, 0x20}, 4);  // add rsp, 32
+    gen_ret(cg);
     
-    Function* current_func;
-    int base_var_count;
-};
-
-void compiler_init(Compiler* c, const char* source) {
-    c->source = source;
-    c->pos = 0;
-    c->len = strlen(source);
-    c->fate_mode = true;
-    c->loop_depth = 0;
-    c->current_func = NULL;
-    c->base_var_count = 0;
+    // _rt_timer_free: rdi = unlinked node onto the free list, new generation
+    add_label(cg, "_rt_timer_free");
+    emit_bytes(cg, (uint8_t[]){0x48, 0xff, 0x47, 0x28}, 4);  // inc qword [rdi+40]
+    emit_bytes(cg, (uint8_t[]){0x48, 0x81, 0x67, 0x28, 0xff, 0xff, 0x00, 0x00}, 8);  // and qword [rdi+40], 0xffff
+    rt_timer_state(cg, state);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x41, 0x08}, 4);  // mov rax, [rcx+8]
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x07}, 3);        // mov [rdi], rax
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x79, 0x08}, 4);  // mov [rcx+8], rdi
+    emit_bytes(cg, (uint8_t[]){0x48, 0xff, 0x49, 0x18}, 4);  // dec qword [rcx+24] (pending)
+    emit_bytes(cg, (uint8_t[]){0x74, 0x01}, 2);              // jz +1
+    gen_ret(cg);
+    emit_bytes(cg, (uint8_t[]){0x31, 0xd2}, 2);              // xor edx, edx
+    gen_jmp(cg, "_rt_timer_arm");
+    
+    // _rt_timers: rax = the timerfd, created on first use
+    add_label(cg, "_rt_timers");
+    rt_timer_state(cg, state);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x41, 0x10}, 4);  // mov rax, [rcx+16]
+    emit_bytes(cg, (uint8_t[]){0x48, 0x85, 0xc0, 0x74, 0x01}, 5);  // test rax, rax; jz +1
+    gen_ret(cg);
+    emit_bytes(cg, (uint8_t[]){0xbf, 0x01, 0x00, 0x00, 0x00}, 5);  // mov edi, CLOCK_MONOTONIC
+    emit_bytes(cg, (uint8_t[]){0xbe, 0x00, 0x00, 0x08, 0x00}, 5);  // mov esi, TFD_CLOEXEC
+    gen_mov_rax_imm(cg, 283);                                 // sys_timerfd_create
+    gen_syscall(cg);
+    rt_timer_state(cg, state);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x41, 0x10}, 4);  // mov [rcx+16], rax
+    gen_ret(cg);
     
-    unified_init(&c->unified);
-    tile_init(&c->tile, &c->unified);
-    fate_init(&c->fate);
-    codegen_init(&c->codegen);
+    // _rt_after / _rt_every: rdi = ms, rsi = fn; rax = handle, 0 when out of memory
+    add_label(cg, "_rt_after");
+    emit_bytes(cg, (uint8_t[]){0x31, 0xd2}, 2);              // xor edx, edx (once)
+    gen_jmp(cg, "_rt_timer_add");
+    add_label(cg, "_rt_every");
+    emit_bytes(cg, (uint8_t[]){0xba, 0x01, 0x00, 0x00, 0x00}, 5);  // mov edx, 1 (repeat)
+    add_label(cg, "_rt_timer_add");
+    emit_bytes(cg, (uint8_t[]){0x41, 0x54, 0x41, 0x55, 0x41, 0x56}, 6);  // push r12; push r13; push r14
+    emit_bytes(cg, (uint8_t[]){0x49, 0x89, 0xfc}, 3);        // mov r12, rdi
+    emit_bytes(cg, (uint8_t[]){0x49, 0x89, 0xf5}, 3);        // mov r13, rsi
+    emit_bytes(cg, (uint8_t[]){0x49, 0x89, 0xd6}, 3);        // mov r14, rdx
+    emit_bytes(cg, (uint8_t[]){0xb8, 0x01, 0x00, 0x00, 0x00}, 5);  // mov eax, 1
+    emit_bytes(cg, (uint8_t[]){0x49, 0x39, 0xc4}, 3);        // cmp r12, rax
+    emit_bytes(cg, (uint8_t[]){0x4c, 0x0f, 0x4c, 0xe0}, 4);  // cmovl r12, rax (at least one tick)
+    gen_call(cg, "_rt_timers");
+    rt_timer_state(cg, state);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x79, 0x08}, 4);  // mov rdi, [rcx+8] (free list)
+    emit_bytes(cg, (uint8_t[]){0x48, 0x85, 0xff}, 3);        // test rdi, rdi
+    gen_je(cg, "_rt_timer_new");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x07}, 3);        // mov rax, [rdi]
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x41, 0x08}, 4);  // mov [rcx+8], rax
+    gen_jmp(cg, "_rt_timer_init");
+    add_label(cg, "_rt_timer_new");
+    emit_bytes(cg, (uint8_t[]){0xbf, 0x30, 0x00, 0x00, 0x00}, 5);  // mov edi, 48
+    gen_call(cg, "_rt_alloc");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xc7}, 3);        // mov rdi, rax
+    emit_bytes(cg, (uint8_t[]){0x48, 0x85, 0xc0}, 3);        // test rax, rax
+    gen_je(cg, "_rt_timer_added");
+    add_label(cg, "_rt_timer_init");
+    rt_timer_state(cg, state);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x01}, 3);        // mov rax, [rcx]
+    emit_bytes(cg, (uint8_t[]){0x4c, 0x01, 0xe0}, 3);        // add rax, r12
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x47, 0x10}, 4);  // mov [rdi+16], rax (expires)
+    emit_bytes(cg, (uint8_t[]){0x4c, 0x89, 0x6f, 0x18}, 4);  // mov [rdi+24], r13 (fn)
+    emit_bytes(cg, (uint8_t[]){0x4d, 0x0f, 0xaf, 0xf4}, 4);  // imul r14, r12
+    emit_bytes(cg, (uint8_t[]){0x4c, 0x89, 0x77, 0x20}, 4);  // mov [rdi+32], r14 (period)
+    emit_byte(cg, 0x57);                                      // push rdi
+    gen_call(cg, "_rt_timer_link");
+    emit_byte(cg, 0x5f);                                      // pop rdi
+    rt_timer_state(cg, state);
+    emit_bytes(cg, (uint8_t[]){0x48, 0xff, 0x41, 0x18}, 4);  // inc qword [rcx+24]
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0x79, 0x18, 0x01}, 5);  // cmp qword [rcx+24], 1
+    gen_jne(cg, "_rt_timer_handle");
+    emit_byte(cg, 0x57);                                      // push rdi
+    emit_byte(cg, 0xba);                                      // mov edx, TIMER_TICK_NS
+    emit_u32(cg, TIMER_TICK_NS);
+    gen_call(cg, "_rt_timer_arm");
+    emit_byte(cg, 0x5f);                                      // pop rdi
+    add_label(cg, "_rt_timer_handle");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x47, 0x28}, 4);  // mov rax, [rdi+40]
+    emit_bytes(cg, (uint8_t[]){0x48, 0xc1, 0xe0, 0x30}, 4);  // shl rax, 48
+    emit_bytes(cg, (uint8_t[]){0x48, 0x09, 0xf8}, 3);        // or rax, rdi
+    add_label(cg, "_rt_timer_added");
+    emit_bytes(cg, (uint8_t[]){0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c}, 6);  // pop r14; pop r13; pop r12
+    gen_ret(cg);
     
-    // Initialize compatibility layer (minimal universal)
-    platform_init(&c->platform);
-    bridge_init(&c->bridge);
-    compat_init(&c->compat);
+    // _rt_cancel: rdi = handle; rax = 1 when a pending timer was cancelled
+    add_label(cg, "_rt_cancel");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xf8}, 3);        // mov rax, rdi
+    emit_bytes(cg, (uint8_t[]){0x48, 0xc1, 0xe8, 0x30}, 4);  // shr rax, 48 (generation)
+    emit_bytes(cg, (uint8_t[]){0x48, 0xba, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00}, 10);  // movabs rdx, 2^48 - 1
+    emit_bytes(cg, (uint8_t[]){0x48, 0x21, 0xd7}, 3);        // and rdi, rdx (node)
+    gen_je(cg, "_rt_cancel_none");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x39, 0x47, 0x28}, 4);  // cmp [rdi+40], rax
+    gen_jne(cg, "_rt_cancel_none");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0x7f, 0x08, 0x00}, 5);  // cmp qword [rdi+8], 0
+    gen_je(cg, "_rt_cancel_none");
+    gen_call(cg, "_rt_timer_unlink");
+    gen_call(cg, "_rt_timer_free");
+    emit_bytes(cg, (uint8_t[]){0xb8, 0x01, 0x00, 0x00, 0x00}, 5);  // mov eax, 1
+    gen_ret(cg);
+    add_label(cg, "_rt_cancel_none");
+    emit_bytes(cg, (uint8_t[]){0x31, 0xc0}, 2);              // xor eax, eax
+    gen_ret(cg);
     
-    // Fate adaptive probing
-    platform_probe(&c->platform, &c->fate);
-    compat_probe(&c->compat, &c->fate);
+    // _rt_tick: rax = callbacks run. r12 = tick or fn, r13 = ticks left,
+    // r14 = level or slot, r15 = count (callbacks preserve r12-r15)
+    add_label(cg, "_rt_tick");
+    emit_bytes(cg, (uint8_t[]){0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57}, 8);  // push r12-r15
+    emit_bytes(cg, (uint8_t[]){0x45, 0x31, 0xff}, 3);        // xor r15d, r15d
+    rt_timer_state(cg, state);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0x79, 0x18, 0x00}, 5);  // cmp qword [rcx+24], 0
+    gen_je(cg, "_rt_tick_done");                              // Disarmed: nothing to wait for
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0xec, 0x10}, 4);  // sub rsp, 16
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x79, 0x10}, 4);  // mov rdi, [rcx+16]
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xe6}, 3);        // mov rsi, rsp
+    emit_bytes(cg, (uint8_t[]){0xba, 0x08, 0x00, 0x00, 0x00}, 5);  // mov edx, 8
+    emit_bytes(cg, (uint8_t[]){0x31, 0xc0}, 2);              // xor eax, eax (sys_read)
+    gen_syscall(cg);
+    emit_bytes(cg, (uint8_t[]){0x4c, 0x8b, 0x2c, 0x24}, 4);  // mov r13, [rsp] (expirations)
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0xc4, 0x10}, 4);  // add rsp, 16
+    emit_bytes(cg, (uint8_t[]){0x48, 0x85, 0xc0}, 3);        // test rax, rax
+    rt_jcc(cg, 0x8e, "_rt_tick_done");
+    add_label(cg, "_rt_tick_next");
+    emit_bytes(cg, (uint8_t[]){0x4d, 0x85, 0xed}, 3);        // test r13, r13
+    gen_je(cg, "_rt_tick_done");
+    emit_bytes(cg, (uint8_t[]){0x49, 0xff, 0xcd}, 3);        // dec r13
+    rt_timer_state(cg, state);
+    emit_bytes(cg, (uint8_t[]){0x4c, 0x8b, 0x21}, 3);        // mov r12, [rcx] (now)
+    emit_bytes(cg, (uint8_t[]){0x4c, 0x89, 0xe0}, 3);        // mov rax, r12
+    emit_bytes(cg, (uint8_t[]){0x41, 0xbe, 0x01, 0x00, 0x00, 0x00}, 6);  // mov r14d, 1
+    // While the index below wrapped to 0, cascade the level above
+    add_label(cg, "_rt_tick_cascade");
+    emit_bytes(cg, (uint8_t[]){0xa8, 0x3f}, 2);              // test al, 63
+    gen_jne(cg, "_rt_tick_run");
+    emit_bytes(cg, (uint8_t[]){0x41, 0x83, 0xfe, TIMER_LEVELS}, 4);  // cmp r14d, TIMER_LEVELS
+    rt_jcc(cg, 0x83, "_rt_tick_run");
+    emit_bytes(cg, (uint8_t[]){0x48, 0xc1, 0xe8, 0x06}, 4);  // shr rax, 6
+    emit_byte(cg, 0x50);                                      // push rax
+    emit_bytes(cg, (uint8_t[]){0x89, 0xc2}, 2);              // mov edx, eax
+    emit_bytes(cg, (uint8_t[]){0x83, 0xe2, 0x3f}, 3);        // and edx, 63
+    emit_bytes(cg, (uint8_t[]){0x44, 0x89, 0xf6}, 3);        // mov esi, r14d
+    emit_bytes(cg, (uint8_t[]){0xc1, 0xe6, 0x06}, 3);        // shl esi, 6
+    emit_bytes(cg, (uint8_t[]){0x01, 0xf2}, 2);              // add edx, esi
+    rt_timer_state(cg, state);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8d, 0x54, 0xd1, TIMER_STATE}, 5);  // lea rdx, [rcx + rdx*8 + wheels]
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x3a}, 3);        // mov rdi, [rdx]
+    emit_bytes(cg, (uint8_t[]){0x48, 0xc7, 0x02, 0x00, 0x00, 0x00, 0x00}, 7);  // mov qword [rdx], 0
+    add_label(cg, "_rt_tick_relink");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x85, 0xff}, 3);        // test rdi, rdi
+    gen_je(cg, "_rt_tick_relinked");
+    emit_bytes(cg, (uint8_t[]){0xff, 0x37}, 2);              // push qword [rdi] (next)
+    gen_call(cg, "_rt_timer_link");
+    emit_byte(cg, 0x5f);                                      // pop rdi
+    gen_jmp(cg, "_rt_tick_relink");
+    add_label(cg, "_rt_tick_relinked");
+    emit_byte(cg, 0x58);                                      // pop rax
+    emit_bytes(cg, (uint8_t[]){0x41, 0xff, 0xc6}, 3);        // inc r14d
+    gen_jmp(cg, "_rt_tick_cascade");
+    // Run the level-0 slot of this tick; every timers go back in first.
+    // The slot's list moves to a head on the stack before any callback
+    // runs: a timer re-armed 63 ticks ahead links into the emptied slot,
+    // for the next turn of the wheel, and cancel still unlinks from it
+    add_label(cg, "_rt_tick_run");
+    rt_timer_state(cg, state);
+    emit_bytes(cg, (uint8_t[]){0x44, 0x89, 0xe0}, 3);        // mov eax, r12d
+    emit_bytes(cg, (uint8_t[]){0x83, 0xe0, 0x3f}, 3);        // and eax, 63
+    emit_bytes(cg, (uint8_t[]){0x4c, 0x8d, 0x74, 0xc1, TIMER_STATE}, 5);  // lea r14, [rcx + rax*8 + wheels]
+    emit_bytes(cg, (uint8_t[]){0x48, 0xff, 0x01}, 3);        // inc qword [rcx] (now)
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0xec, 0x10}, 4);  // sub rsp, 16 (detached head)
+    emit_bytes(cg, (uint8_t[]){0x49, 0x8b, 0x06}, 3);        // mov rax, [r14]
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x04, 0x24}, 4);  // mov [rsp], rax
+    emit_bytes(cg, (uint8_t[]){0x49, 0xc7, 0x06, 0x00, 0x00, 0x00, 0x00}, 7);  // mov qword [r14], 0
+    emit_bytes(cg, (uint8_t[]){0x48, 0x85, 0xc0, 0x74, 0x04}, 5);  // test rax, rax; jz +4
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x60, 0x08}, 4);  // mov [rax+8], rsp (pprev)
+    emit_bytes(cg, (uint8_t[]){0x49, 0x89, 0xe6}, 3);        // mov r14, rsp
+    add_label(cg, "_rt_tick_fire");
+    emit_bytes(cg, (uint8_t[]){0x49, 0x8b, 0x3e}, 3);        // mov rdi, [r14]
+    emit_bytes(cg, (uint8_t[]){0x48, 0x85, 0xff}, 3);        // test rdi, rdi
+    gen_je(cg, "_rt_tick_drained");
+    gen_call(cg, "_rt_timer_unlink");
+    emit_bytes(cg, (uint8_t[]){0x4c, 0x8b, 0x67, 0x18}, 4);  // mov r12, [rdi+24] (fn)
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x47, 0x20}, 4);  // mov rax, [rdi+32] (period)
+    emit_bytes(cg, (uint8_t[]){0x48, 0x85, 0xc0}, 3);        // test rax, rax
+    gen_je(cg, "_rt_tick_once");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x01, 0x47, 0x10}, 4);  // add [rdi+16], rax
+    gen_call(cg, "_rt_timer_link");
+    gen_jmp(cg, "_rt_tick_call");
+    add_label(cg, "_rt_tick_once");
+    gen_call(cg, "_rt_timer_free");
+    add_label(cg, "_rt_tick_call");
+    emit_bytes(cg, (uint8_t[]){0x41, 0xff, 0xd4}, 3);        // call r12
+    emit_bytes(cg, (uint8_t[]){0x49, 0xff, 0xc7}, 3);        // inc r15
+    gen_jmp(cg, "_rt_tick_fire");
+    add_label(cg, "_rt_tick_drained");
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0xc4, 0x10}, 4);  // add rsp, 16
+    gen_jmp(cg, "_rt_tick_next");
+    add_label(cg, "_rt_tick_done");
+    emit_bytes(cg, (uint8_t[]){0x4c, 0x89, 0xf8}, 3);        // mov rax, r15
+    emit_bytes(cg, (uint8_t[]){0x41, 0x5f, 0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c}, 8);  // pop r15-r12
+    gen_ret(cg);
+    rt_add_sym(cg, "_rt_timer", start);
 }
 
-void compiler_free(Compiler* c) {
-    codegen_free(&c->codegen);
+// keep with timers scheduled: run the wheel instead of spinning
+void gen_timer_loop(CodeGen* cg) {
+    size_t head = cg->code_pos;
+    gen_rt_call(cg, RT_TICK);
+    gen_pause(cg);
+    emit_byte(cg, 0xe9);
+    emit_i32(cg, (int32_t)(head - cg->code_pos - 4));
 }
 
-// ═══════════════════════════════════════════════════════════════
-// Parsing helper functions
-// ═══════════════════════════════════════════════════════════════
+// CPUID + XGETBV once: r8d = level - 1 (0 SSE2, 1 AVX2, 2 AVX-512), then
+// store the chosen variant of every requested helper in its slot
+void rt_emit_cpu_init(CodeGen* cg) {
+    size_t start = cg->code_pos;
+    add_label(cg, "_rt_cpu_init");
+    emit_byte(cg, 0x53);                                             // push rbx
+    emit_bytes(cg, (uint8_t[]){0x45, 0x31, 0xc0}, 3);                // xor r8d, r8d
+    emit_bytes(cg, (uint8_t[]){0xb8, 0x01, 0x00, 0x00, 0x00}, 5);    // mov eax, 1
+    emit_bytes(cg, (uint8_t[]){0x0f, 0xa2}, 2);                      // cpuid
+    emit_bytes(cg, (uint8_t[]){0x0f, 0xba, 0xe1, 27}, 4);            // bt ecx, 27 (OSXSAVE)
+    emit_bytes(cg, (uint8_t[]){0x0f, 0x83}, 2);                      // jnc done
+    add_fixup(cg, "_rt_cpu_done");
+    emit_bytes(cg, (uint8_t[]){0x0f, 0xba, 0xe1, 28}, 4);            // bt ecx, 28 (AVX)
+    emit_bytes(cg, (uint8_t[]){0x0f, 0x83}, 2);
+    add_fixup(cg, "_rt_cpu_done");
+    emit_bytes(cg, (uint8_t[]){0x31, 0xc9, 0x0f, 0x01, 0xd0}, 5);    // xor ecx, ecx; xgetbv
+    emit_bytes(cg, (uint8_t[]){0x41, 0x89, 0xc1}, 3);                // mov r9d, eax
+    emit_bytes(cg, (uint8_t[]){0x83, 0xe0, 0x06, 0x83, 0xf8, 0x06}, 6);  // XMM|YMM state enabled?
+    gen_jne(cg, "_rt_cpu_done");
+    emit_bytes(cg, (uint8_t[]){0xb8, 0x07, 0x00, 0x00, 0x00}, 5);    // mov eax, 7
+    emit_bytes(cg, (uint8_t[]){0x31, 0xc9, 0x0f, 0xa2}, 4);          // xor ecx, ecx; cpuid
+    emit_bytes(cg, (uint8_t[]){0x0f, 0xba, 0xe3, 5}, 4);             // bt ebx, 5 (AVX2)
+    emit_bytes(cg, (uint8_t[]){0x0f, 0x83}, 2);
+    add_fixup(cg, "_rt_cpu_done");
+    emit_bytes(cg, (uint8_t[]){0x41, 0xff, 0xc0}, 3);                // inc r8d
+    emit_bytes(cg, (uint8_t[]){0x0f, 0xba, 0xe3, 16}, 4);            // bt ebx, 16 (AVX512F)
+    emit_bytes(cg, (uint8_t[]){0x0f, 0x83}, 2);
+    add_fixup(cg, "_rt_cpu_done");
+    emit_bytes(cg, (uint8_t[]){0x41, 0x81, 0xe1, 0xe6, 0x00, 0x00, 0x00}, 7);  // and r9d, 0xe6
+    emit_bytes(cg, (uint8_t[]){0x41, 0x81, 0xf9, 0xe6, 0x00, 0x00, 0x00}, 7);  // cmp r9d, 0xe6 (opmask/ZMM state)
+    gen_jne(cg, "_rt_cpu_done");
+    emit_bytes(cg, (uint8_t[]){0x41, 0xff, 0xc0}, 3);                // inc r8d
+    add_label(cg, "_rt_cpu_done");
+    
+    for (int rt = 0; rt < RT_COUNT; rt++) {
+        if (!(cg->rt_request & (1u << rt)) || !rt_variants[rt] || !cg->rt_slot[rt]) continue;
+        char label[64];
+        for (int level = MARCH_V2; level <= MARCH_V4; level++) {
+            rt_label(label, rt, level);
+            emit_bytes(cg, (uint8_t[]){0x48, 0x8d, level == MARCH_V2 ? 0x05 : 0x0d}, 3);  // lea rax/rcx, [rip+label]
+            add_fixup(cg, label);
+            if (level == MARCH_V2) continue;
+            emit_bytes(cg, (uint8_t[]){0x41, 0x83, 0xf8, level - MARCH_V2}, 4);  // cmp r8d, level
+            emit_bytes(cg, (uint8_t[]){0x48, 0x0f, 0x43, 0xc1}, 4);              // cmovae rax, rcx
+        }
+        gen_mov_abs_rax(cg, cg->rt_slot[rt]);
+    }
+    emit_byte(cg, 0x5b);  // pop rbx
+    gen_ret(cg);
+    rt_add_sym(cg, "_rt_cpu_init", start);
+}
 
-char peek(Compiler* c) { return (c->pos < c->len) ? c->source[c->pos] : 0; }
-char peek_n(Compiler* c, int n) { return (c->pos + n < c->len) ? c->source[c->pos + n] : 0; }
-char advance(Compiler* c) { return (c->pos < c->len) ? c->source[c->pos++] : 0; }
+// Reserve the prologue call to _rt_cpu_init as a 5-byte NOP
+void gen_cpu_init_slot(CodeGen* cg) {
+    if (cg->march != MARCH_DISPATCH) return;
+    cg->cpu_init_pos = cg->code_pos;
+    emit_bytes(cg, (uint8_t[]){0x0f, 0x1f, 0x44, 0x00, 0x00}, 5);
+}
 
-void skip_whitespace(Compiler* c) {
-    while (c->pos < c->len) {
-        char ch = peek(c);
-        if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
-            advance(c);
+// Emit the helpers requested so far (after all user code)
+void gen_runtime(CodeGen* cg) {
+    uint32_t pending = cg->rt_request & ~cg->rt_emitted;
+    if (!pending) return;
+    if (pending & RT_TIMER_MASK) {
+        // One block serves every timer builtin; its nodes come from alloc
+        cg->rt_request |= RT_TIMER_MASK | (1u << RT_ALLOC);
+        pending = cg->rt_request & ~cg->rt_emitted;
+    }
+    for (int rt = 0; rt < RT_COUNT; rt++) {
+        if (!(pending & (1u << rt))) continue;
+        if (rt == RT_ALLOC) {
+            rt_emit_alloc(cg);
+        } else if (rt == RT_AFTER) {
+            rt_emit_timers(cg);
+        } else if ((1u << rt) & RT_TIMER_MASK) {
+            continue;
+        } else if (cg->march != MARCH_DISPATCH) {
+            rt_emit_variant(cg, rt, cg->march);
+        } else {
+            for (int level = MARCH_V2; level <= MARCH_V4; level++) rt_emit_variant(cg, rt, level);
+        }
+    }
+    cg->rt_emitted |= pending;
+    
+    bool dispatched = false;
+    for (int rt = 0; rt < RT_COUNT; rt++) {
+        dispatched |= rt_variants[rt] && (cg->rt_request & (1u << rt));
+    }
+    if (cg->march == MARCH_DISPATCH && cg->cpu_init_pos && dispatched) {
+        rt_emit_cpu_init(cg);
+        size_t saved_pos = cg->code_pos;
+        cg->code_pos = cg->cpu_init_pos;
+        gen_call(cg, "_rt_cpu_init");
+        cg->code_pos = saved_pos;
+        cg->cpu_init_pos = 0;
+    }
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Layout - Cold region and Fate profile counters
+// ═══════════════════════════════════════════════════════════════
+//
+// Code compiled out of line is cut from the text stream into a ColdBlock
+// and appended after the function bodies by gen_cold_text. The block's
+// labels, fixups and global references travel with it, so jumps in and
+// out of it resolve as usual.
+//
+// Profile file (written at exit by --fate-instrument builds):
+//   "WFPR" source_hash count   u32 each
+//   { kind pos }[count]        u32 each; pos is the site's source offset
+//   counts[count]              u64 each
+//
+// Function entries are counted at the body, and each parameter gets a
+// majority vote over its values: PROF_ARG_VALUE holds the candidate and
+// PROF_ARG_VOTES its lead, so votes / 2 + calls / 2 is a lower bound on
+// how often the candidate was passed.
+
+enum { PROF_WHEN, PROF_TAKEN, PROF_CALL, PROF_ENTRY, PROF_ARG_VALUE, PROF_ARG_VOTES };
+
+// FNV-1a
+uint32_t source_hash(const char* s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) h = (h ^ (uint8_t)s[i]) * 16777619u;
+    return h;
+}
+
+typedef struct { size_t code; int labels, fixups, grefs, sites; } LayoutMark;
+
+LayoutMark layout_mark(CodeGen* cg) {
+    return (LayoutMark){ cg->code_pos, cg->label_count, cg->fixup_count,
+                         cg->gref_count, cg->prof_site_count };
+}
+
+void* layout_take(void* base, int from, int to, size_t size) {
+    void* out = malloc((to - from) * size + 1);
+    memcpy(out, (char*)base + from * size, (to - from) * size);
+    return out;
+}
+
+// Move everything emitted since mark into a cold block
+void layout_cut(CodeGen* cg, LayoutMark m) {
+    ColdBlock* b = &cg->cold[cg->cold_count];
+    b->origin = m.code;
+    b->len = cg->code_pos - m.code;
+    b->code = layout_take(cg->code, m.code, cg->code_pos, 1);
+    b->labels = layout_take(cg->labels, m.labels, cg->label_count, sizeof(cg->labels[0]));
+    b->label_count = cg->label_count - m.labels;
+    b->fixups = layout_take(cg->fixups, m.fixups, cg->fixup_count, sizeof(cg->fixups[0]));
+    b->fixup_count = cg->fixup_count - m.fixups;
+    b->grefs = layout_take(cg->grefs, m.grefs, cg->gref_count, sizeof(cg->grefs[0]));
+    b->gref_count = cg->gref_count - m.grefs;
+    // Counters of nested cold blocks already belong to those blocks
+    for (int i = m.sites; i < cg->prof_site_count; i++) {
+        if (!cg->prof_sites[i].block) cg->prof_sites[i].block = cg->cold_count + 1;
+    }
+    cg->code_pos = m.code;
+    cg->label_count = m.labels;
+    cg->fixup_count = m.fixups;
+    cg->gref_count = m.grefs;
+    cg->cold_count++;
+}
+
+// Append the pending cold blocks at the current position
+void gen_cold_text(CodeGen* cg) {
+    if (cg->cold_count == 0) return;
+    size_t start = cg->code_pos;
+    for (int k = 0; k < cg->cold_count; k++) {
+        ColdBlock* b = &cg->cold[k];
+        size_t delta = cg->code_pos - b->origin;
+        emit_bytes(cg, b->code, b->len);
+        
+        int n = b->label_count;
+        if (n > MAX_LABELS - cg->label_count) n = MAX_LABELS - cg->label_count;
+        memcpy(&cg->labels[cg->label_count], b->labels, n * sizeof(cg->labels[0]));
+        for (int i = 0; i < n; i++) cg->labels[cg->label_count++].pos += delta;
+        
+        n = b->fixup_count;
+        if (n > MAX_LABELS - cg->fixup_count) n = MAX_LABELS - cg->fixup_count;
+        memcpy(&cg->fixups[cg->fixup_count], b->fixups, n * sizeof(cg->fixups[0]));
+        for (int i = 0; i < n; i++) cg->fixups[cg->fixup_count++].pos += delta;
+        
+        n = b->gref_count;
+        if (n > MAX_GREFS - cg->gref_count) n = MAX_GREFS - cg->gref_count;
+        memcpy(&cg->grefs[cg->gref_count], b->grefs, n * sizeof(cg->grefs[0]));
+        for (int i = 0; i < n; i++) cg->grefs[cg->gref_count++].pos += delta;
+        
+        for (int i = 0; i < cg->prof_site_count; i++) {
+            if (cg->prof_sites[i].block != k + 1) continue;
+            cg->prof_sites[i].ref += delta;
+            cg->prof_sites[i].block = 0;
+        }
+        free(b->code);
+        free(b->labels);
+        free(b->fixups);
+        free(b->grefs);
+    }
+    cg->cold_count = 0;
+    rt_add_sym(cg, "_cold_text", start);
+}
+
+// Count one execution of a profile site (clobbers rax). The counter
+// address is filled in by gen_prof_dump.
+void gen_prof_count(CodeGen* cg, int kind, size_t pos) {
+    if (!cg->prof_path || cg->prof_site_count >= MAX_PROF_SITES) return;
+    int i = cg->prof_site_count++;
+    cg->prof_sites[i].kind = kind;
+    cg->prof_sites[i].pos = (uint32_t)pos;
+    cg->prof_sites[i].block = 0;
+    emit_bytes(cg, (uint8_t[]){0x48, 0xb8}, 2);  // movabs rax, counter
+    cg->prof_sites[i].ref = cg->code_pos;
+    emit_u64(cg, 0);
+    emit_bytes(cg, (uint8_t[]){0x48, 0xff, 0x00}, 3);  // inc qword [rax]
+}
+
+// Vote on the value of the argument at [rbp + arg] (clobbers rax, rcx, rdx)
+void gen_prof_value(CodeGen* cg, size_t pos, int32_t arg) {
+    if (!cg->prof_path || cg->prof_site_count + 2 > MAX_PROF_SITES) return;
+    int i = cg->prof_site_count;
+    cg->prof_site_count += 2;
+    for (int k = 0; k < 2; k++) {
+        cg->prof_sites[i + k].kind = k ? PROF_ARG_VOTES : PROF_ARG_VALUE;
+        cg->prof_sites[i + k].pos = (uint32_t)pos;
+        cg->prof_sites[i + k].block = 0;
+    }
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x8d}, 3);           // mov rcx, [rbp + arg]
+    emit_u32(cg, (uint32_t)arg);
+    emit_bytes(cg, (uint8_t[]){0x48, 0xb8}, 2);                 // movabs rax, value
+    cg->prof_sites[i].ref = cg->code_pos;
+    emit_u64(cg, 0);
+    emit_bytes(cg, (uint8_t[]){0x48, 0xba}, 2);                 // movabs rdx, votes
+    cg->prof_sites[i + 1].ref = cg->code_pos;
+    emit_u64(cg, 0);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x3b, 0x08, 0x75, 5}, 5);  // cmp rcx, [rax]; jne other
+    emit_bytes(cg, (uint8_t[]){0x48, 0xff, 0x02, 0xeb, 21}, 5); // inc qword [rdx]; jmp done
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0x3a, 0x00}, 4);     // other: cmp qword [rdx], 0
+    emit_bytes(cg, (uint8_t[]){0x75, 12}, 2);                   // jne lose
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x08}, 3);           // mov [rax], rcx
+    emit_bytes(cg, (uint8_t[]){0x48, 0xc7, 0x02, 1, 0, 0, 0}, 7); // mov qword [rdx], 1
+    emit_bytes(cg, (uint8_t[]){0xeb, 3}, 2);                    // jmp done
+    emit_bytes(cg, (uint8_t[]){0x48, 0xff, 0x0a}, 3);           // lose: dec qword [rdx]
+}
+
+// _rt_prof_dump: write the profile file, called by gen_exit in instrumented
+// builds. Preserves rax and rdi (the exit code).
+void gen_prof_dump(CodeGen* cg) {
+    int n = cg->prof_site_count;
+    uint64_t counts = cg->global_base + cg->global_data_pos;
+    cg->global_data_pos += n * 8;
+    for (int i = 0; i < n; i++) {
+        uint64_t addr = counts + i * 8;
+        memcpy(cg->code + cg->prof_sites[i].ref, &addr, 8);
+        if (cg->gref_count < MAX_GREFS) {
+            cg->grefs[cg->gref_count].pos = cg->prof_sites[i].ref;
+            cg->grefs[cg->gref_count].off = (uint32_t)(addr - cg->global_base);
+            cg->gref_count++;
+        }
+    }
+    
+    size_t start = cg->code_pos;
+    add_label(cg, "_rt_prof_dump");
+    emit_bytes(cg, (uint8_t[]){0x50, 0x57}, 2);                 // push rax; push rdi
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8d, 0x3d}, 3);           // lea rdi, [rip+path]
+    add_fixup(cg, "_rt_prof_path");
+    emit_bytes(cg, (uint8_t[]){0xbe, 0x41, 0x02, 0x00, 0x00}, 5);  // mov esi, O_WRONLY|O_CREAT|O_TRUNC
+    emit_bytes(cg, (uint8_t[]){0xba, 0xa4, 0x01, 0x00, 0x00}, 5);  // mov edx, 0644
+    gen_mov_rax_imm(cg, 2);                                     // sys_open
+    gen_syscall(cg);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x85, 0xc0, 0x78, 0x00}, 5);  // test rax, rax; js done
+    size_t to_done = cg->code_pos - 1;
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xc3}, 3);           // mov rbx, rax
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xdf}, 3);           // mov rdi, rbx
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8d, 0x35}, 3);           // lea rsi, [rip+header]
+    add_fixup(cg, "_rt_prof_header");
+    emit_byte(cg, 0xba);                                        // mov edx, header bytes
+    emit_u32(cg, 12 + n * 8);
+    gen_mov_rax_imm(cg, 1);                                     // sys_write
+    gen_syscall(cg);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xdf}, 3);           // mov rdi, rbx
+    emit_bytes(cg, (uint8_t[]){0x48, 0xbe}, 2);                 // movabs rsi, counts
+    add_gref(cg, counts);
+    emit_u64(cg, counts);
+    emit_byte(cg, 0xba);                                        // mov edx, counter bytes
+    emit_u32(cg, n * 8);
+    gen_mov_rax_imm(cg, 1);                                     // sys_write
+    gen_syscall(cg);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xdf}, 3);           // mov rdi, rbx
+    gen_mov_rax_imm(cg, 3);                                     // sys_close
+    gen_syscall(cg);
+    rt_patch_rel8(cg, to_done);
+    emit_bytes(cg, (uint8_t[]){0x5f, 0x58}, 2);                 // pop rdi; pop rax
+    gen_ret(cg);
+    
+    add_label(cg, "_rt_prof_path");
+    emit_bytes(cg, (const uint8_t*)cg->prof_path, strlen(cg->prof_path) + 1);
+    add_label(cg, "_rt_prof_header");
+    emit_u32(cg, PROF_MAGIC);
+    emit_u32(cg, cg->prof_hash);
+    emit_u32(cg, n);
+    for (int i = 0; i < n; i++) {
+        emit_u32(cg, cg->prof_sites[i].kind);
+        emit_u32(cg, cg->prof_sites[i].pos);
+    }
+    rt_add_sym(cg, "_rt_prof_dump", start);
+}
+
+// ═══════════════════════════════════════════════════════════════
+// ELF Generator
+// ═══════════════════════════════════════════════════════════════
+
+// --tiny: the 56-byte program header starts at offset 56, in the ELF
+// header's last 8 bytes. p_type = 1 doubles as e_phnum, p_flags = 7 as
+// e_shnum, which the loader ignores like the rest of the section fields.
+// The globals move from GLOBAL_BASE to just past the data, initial values
+// included, so a single segment, a single page for small programs, holds
+// the whole process and the loader's zeroing of its tail faults it in.
+// Needs every global reference recorded, to move them. False when the file
+// cannot be written.
+bool write_elf_tiny(CodeGen* cg, const char* filename) {
+    uint64_t base = ELF_BASE;
+    uint64_t entry = base + ELF_TINY_OFFSET;
+    uint64_t file_size = ELF_TINY_OFFSET + cg->code_pos + cg->data_pos;
+    uint64_t globals = (base + file_size + 63) & ~63ull;
+    uint64_t mem_size = globals + cg->global_data_pos - base;
+    size_t pad = globals - base - file_size;
+    if (cg->global_init_len) file_size += pad + cg->global_init_len;
+    uint64_t align = 0x1000;
+    
+    uint8_t* code = malloc(cg->code_pos + 1);
+    memcpy(code, cg->code, cg->code_pos);
+    for (int i = 0; i < cg->gref_count; i++) {
+        uint64_t addr = globals + cg->grefs[i].off;
+        memcpy(code + cg->grefs[i].pos, &addr, 8);
+    }
+    
+    uint8_t hdr[ELF_TINY_OFFSET] = {0};
+    hdr[0] = 0x7f; hdr[1] = 'E'; hdr[2] = 'L'; hdr[3] = 'F';
+    hdr[4] = 2; hdr[5] = 1; hdr[6] = 1;
+    hdr[16] = 2; hdr[18] = 0x3e; hdr[20] = 1;
+    memcpy(hdr + 24, &entry, 8);
+    hdr[32] = 56;                       // e_phoff
+    hdr[52] = 64; hdr[54] = 56;         // e_ehsize, e_phentsize
+    uint8_t* phdr = hdr + 56;
+    phdr[0] = 1;                        // PT_LOAD / e_phnum
+    phdr[4] = 7;                        // RWX / e_shnum
+    memcpy(phdr + 16, &base, 8);
+    memcpy(phdr + 24, &base, 8);
+    memcpy(phdr + 32, &file_size, 8);
+    memcpy(phdr + 40, &mem_size, 8);
+    memcpy(phdr + 48, &align, 8);
+    
+    FILE* f = fopen(filename, "wb");
+    if (f) {
+        fwrite(hdr, 1, ELF_TINY_OFFSET, f);
+        fwrite(code, 1, cg->code_pos, f);
+        fwrite(cg->data, 1, cg->data_pos, f);
+        if (cg->global_init_len) {
+            fwrite((uint8_t[64]){0}, 1, pad, f);
+            fwrite(cg->global_init, 1, cg->global_init_len, f);
+        }
+        fclose(f);
+        chmod(filename, 0755);
+    }
+    free(code);
+    return f != NULL;
+}
+
+// False when the file cannot be written
+bool write_elf(CodeGen* cg, const char* filename) {
+    // mem_size needs to cover global variable area at 0x600000+
+    // Global vars are at 0x600000, so we need at least 0x200000 + globals
+    uint64_t global_size = cg->global_data_pos > 0 ? cg->global_data_pos : 0x1000;
+    uint64_t mem_size = GLOBAL_BASE - ELF_BASE + global_size + 0x10000; // Cover 0x400000 to 0x600000+globals
+    // --tiny maps only the file and the globals: a literal that may be an
+    // address in the range mapped here (copy(0x501000, 0x500000, n)) keeps
+    // this layout
+    bool mapped_literal = cg->low_literal < ELF_BASE + mem_size;
+    if (cg->tiny && cg->gref_count < MAX_GREFS && !mapped_literal) return write_elf_tiny(cg, filename);
+    FILE* f = fopen(filename, "wb");
+    if (!f) return false;
+    
+    uint64_t base = ELF_BASE;
+    // Code lands at the offset it was aligned for: a --tiny build kept
+    // here is padded from byte 112's alignment to past the headers
+    size_t lead = (cg->text_bias + ALIGN_MAX - ELF_TEXT_OFFSET % ALIGN_MAX) % ALIGN_MAX;
+    uint64_t entry = base + ELF_TEXT_OFFSET + lead;
+    size_t total_size = lead + cg->code_pos + cg->data_pos;
+    
+    uint8_t ehdr[64] = {0};
+    ehdr[0] = 0x7f; ehdr[1] = 'E'; ehdr[2] = 'L'; ehdr[3] = 'F';
+    ehdr[4] = 2; ehdr[5] = 1; ehdr[6] = 1;
+    ehdr[16] = 2; ehdr[18] = 0x3e; ehdr[20] = 1;
+    memcpy(ehdr + 24, &entry, 8);
+    uint64_t phoff = 64;
+    memcpy(ehdr + 32, &phoff, 8);
+    ehdr[52] = 64; ehdr[54] = 56; ehdr[56] = 1;
+    
+    uint8_t phdr[56] = {0};
+    uint32_t p_type = 1, p_flags = 7;
+    memcpy(phdr + 0, &p_type, 4);
+    memcpy(phdr + 4, &p_flags, 4);
+    uint64_t file_size = ELF_TEXT_OFFSET + total_size;
+    memcpy(phdr + 16, &base, 8);
+    memcpy(phdr + 24, &base, 8);
+    memcpy(phdr + 32, &file_size, 8);
+    memcpy(phdr + 40, &mem_size, 8);
+    // Large code: 2MB segment alignment so the text can sit on huge pages
+    uint64_t align = cg->code_pos >= HUGE_TEXT_MIN ? HUGE_PAGE_SIZE : 0x1000;
+    memcpy(phdr + 48, &align, 8);
+    
+    // Initialized globals: a second segment maps their image at GLOBAL_BASE
+    // from a page boundary of the file, and the first one stops where it
+    // begins, still mapping 0x400000-0x600000 for peek/poke addresses. The
+    // two-entry header table follows the image so the code keeps its offset
+    // (the header at 64 is left unused).
+    uint8_t init_phdr[56] = {0};
+    uint64_t image_off = (file_size + 0xfff) & ~0xfffull;
+    uint64_t table_off = (image_off + cg->global_init_len + 7) & ~7ull;
+    if (cg->global_init_len) {
+        memcpy(ehdr + 32, &table_off, 8);
+        ehdr[56] = 2;
+        uint64_t text_mem = GLOBAL_BASE - ELF_BASE;
+        memcpy(phdr + 40, &text_mem, 8);
+        uint32_t init_flags = 6;
+        uint64_t global_base = GLOBAL_BASE, init_size = cg->global_init_len;
+        uint64_t init_mem = global_size + 0x10000, page = 0x1000;
+        memcpy(init_phdr + 0, &p_type, 4);
+        memcpy(init_phdr + 4, &init_flags, 4);
+        memcpy(init_phdr + 8, &image_off, 8);
+        memcpy(init_phdr + 16, &global_base, 8);
+        memcpy(init_phdr + 24, &global_base, 8);
+        memcpy(init_phdr + 32, &init_size, 8);
+        memcpy(init_phdr + 40, &init_mem, 8);
+        memcpy(init_phdr + 48, &page, 8);
+    }
+    
+    fwrite(ehdr, 1, 64, f);
+    fwrite(phdr, 1, 56, f);
+    fwrite((uint8_t[ALIGN_MAX]){0}, 1, lead, f);
+    fwrite(cg->code, 1, cg->code_pos, f);
+    fwrite(cg->data, 1, cg->data_pos, f);
+    if (cg->global_init_len) {
+        fseek(f, image_off, SEEK_SET);
+        fwrite(cg->global_init, 1, cg->global_init_len, f);
+        fseek(f, table_off, SEEK_SET);
+        fwrite(phdr, 1, 56, f);
+        fwrite(init_phdr, 1, 56, f);
+    }
+    fclose(f);
+    chmod(filename, 0755);
+    return true;
+}
+
+bool write_raw(CodeGen* cg, const char* filename) {
+    FILE* f = fopen(filename, "wb");
+    if (!f) return false;
+    fwrite(cg->code, 1, cg->code_pos, f);
+    fclose(f);
+    return true;
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Compiler
+// ═══════════════════════════════════════════════════════════════
+
+typedef struct Compiler Compiler;
+
+typedef struct { uint32_t kind, pos; uint64_t count; } ProfileEntry;
+
+// Optimization passes, in pipeline order. Code is generated in one sweep,
+// so a pass is a hook at the point it applies rather than a walk of its
+// own; its setting comes from the unified field (passes_configure)
+enum {
+    PASS_CTFOLD, PASS_STATIC, PASS_COALESCE, PASS_INLINE, PASS_CSE, PASS_STRENGTH, PASS_IFCONV,
+    PASS_REGALLOC, PASS_PROMOTE, PASS_MEMO, PASS_PREFETCH, PASS_LAYOUT, PASS_ALIGN, PASS_COUNT
+};
+
+typedef struct {
+    const char* name;
+    bool on;
+    int64_t level;        // Pass setting: budget, size limit, distance...
+    uint64_t runs;        // Times the hook applied
+    uint64_t ns;          // Time inside the hook (--time-passes), nested passes included
+} Pass;
+
+struct Compiler {
+    const char* source;
+    size_t pos;
+    size_t len;
+    size_t import_pos;    // Source past this point is imported IR from other modules
+    bool fate_mode;
+    int loop_depth;
+    char loop_labels[16][2][64];
+    
+    UnifiedField unified;
+    TileManager tile;
+    FateScheduler fate;
+    CodeGen codegen;
+    
+    // Compatibility layer (minimal universal)
+    Platform platform;
+    Bridge bridge;
+    Compat compat;
+    
+    Function* current_func;
+    int base_var_count;
+    
+    // Frame capture for tiered execution (locals of the last function body)
+    bool capture_frame;
+    Variable* captured_vars;
+    int captured_count;
+    
+    bool osr_entries;     // Loop heads may be entered from the interpreter (tier)
+    
+    // Fate profile of an instrumented run (--fate-profile)
+    ProfileEntry* profile;
+    int profile_count;
+    // limit memory/cpu/fds (0 = none), applied at startup
+    uint64_t limit_memory;   // Bytes of address space
+    uint64_t limit_cpu;      // CPU seconds
+    uint64_t limit_fds;
+    
+    uint32_t spec_mask;      // Parameters compiled as constants (bit per parameter)
+    int64_t spec_values[16];
+    
+    Pass passes[PASS_COUNT];
+    uint32_t pass_enable, pass_disable;  // Command line overrides (bit per pass)
+    bool time_passes;
+    bool unified_pinned;                 // Tuned field: unified blocks are ignored
+    bool static_init;        // Main has emitted no code yet: constant stores are initial values
+    char error[256];         // First compile error; no output is written when set
+};
+
+// ═══════════════════════════════════════════════════════════════
+// Pass manager - Unified field presets
+// ═══════════════════════════════════════════════════════════════
+//
+// i (information density) trades speed for size: inlining budget, code
+// alignment and the hot/cold layout. e (entropy) trades predictable
+// branches for branch-free code: if-conversion to cmov and prefetch
+// distance. r (relation strength) trades recompute for caching: common
+// subexpressions, promoted globals, memoization and compile-time folding.
+
+const char* pass_names[PASS_COUNT] = {
+    "ctfold", "static", "coalesce", "inline", "cse", "strength", "ifconv",
+    "regalloc", "promote", "memo", "prefetch", "layout", "align",
+};
+
+void passes_configure(Compiler* c) {
+    double i = c->unified.i, e = c->unified.e, r = c->unified.r;
+    Pass* p = c->passes;
+    for (int k = 0; k < PASS_COUNT; k++) {
+        p[k].name = pass_names[k];
+        p[k].on = true;
+        p[k].level = 0;
+    }
+    p[PASS_CTFOLD].level = (int64_t)(CT_STEP_BUDGET * 2 * r);
+    p[PASS_INLINE].on = i < 0.9;
+    p[PASS_INLINE].level = (int64_t)(INLINE_MAX_BODY * fmin(1.0, 2 * (1.0 - i)));
+    p[PASS_CSE].on = r >= 0.25;
+    p[PASS_CSE].level = (int64_t)(CSE_WINDOW * 2 * r);
+    p[PASS_IFCONV].on = e > 0.5;
+    p[PASS_PROMOTE].on = r >= 0.25;
+    p[PASS_MEMO].level = (int64_t)(MEMO_AUTO_R * 100);  // Auto-memoize at r >= level%
+    p[PASS_PREFETCH].level = 256 + (int64_t)(e * 1792);  // Lookahead bytes
+    p[PASS_LAYOUT].on = i < 0.9;
+    p[PASS_ALIGN].on = i < 0.8;
+    p[PASS_ALIGN].level = i < 0.3 ? 32 : 16;
+    // A pass forced on works at no less than its setting for a neutral
+    // field (0.5), which the preset may have scaled down to nothing
+    const int64_t neutral[PASS_COUNT] = {
+        [PASS_CTFOLD] = CT_STEP_BUDGET, [PASS_INLINE] = INLINE_MAX_BODY, [PASS_CSE] = CSE_WINDOW,
+    };
+    for (int k = 0; k < PASS_COUNT; k++) {
+        if (c->pass_enable & (1u << k)) p[k].on = true;
+        if ((c->pass_enable & (1u << k)) && p[k].level < neutral[k]) p[k].level = neutral[k];
+        if (c->pass_disable & (1u << k)) p[k].on = false;
+    }
+}
+
+// Comma-separated pass names into a bit set; false on an unknown name
+bool pass_mask(const char* list, uint32_t* mask) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", list);
+    char* save;
+    for (char* name = strtok_r(buf, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+        int k = 0;
+        while (k < PASS_COUNT && strcmp(pass_names[k], name) != 0) k++;
+        if (k == PASS_COUNT) return false;
+        *mask |= 1u << k;
+    }
+    return true;
+}
+
+uint64_t pass_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Bracket a pass hook; applied counts the runs that changed the code
+uint64_t pass_begin(Compiler* c) {
+    return c->time_passes ? pass_clock() : 0;
+}
+
+bool pass_end(Compiler* c, int k, uint64_t start, bool applied) {
+    if (c->time_passes) c->passes[k].ns += pass_clock() - start;
+    if (applied) c->passes[k].runs++;
+    return applied;
+}
+
+void passes_report(Compiler* c, FILE* out) {
+    fprintf(out, "Pass        On   Setting      Runs   Time (ms)\n");
+    for (int k = 0; k < PASS_COUNT; k++) {
+        Pass* p = &c->passes[k];
+        fprintf(out, "%-10s  %-3s  %7lld  %8llu  %10.3f\n", p->name, p->on ? "yes" : "no",
+                (long long)p->level, (unsigned long long)p->runs, p->ns / 1e6);
+    }
+}
+
+// Per-build state. The probed platform and the code buffers outlive it,
+// so a warm compiler (--watch) starts each rebuild from here
+void compiler_reset(Compiler* c, const char* source) {
+    c->source = source;
+    c->pos = 0;
+    c->len = strlen(source);
+    c->import_pos = c->len;
+    c->fate_mode = true;
+    c->loop_depth = 0;
+    c->current_func = NULL;
+    c->base_var_count = 0;
+    c->capture_frame = false;
+    c->captured_vars = NULL;
+    c->captured_count = 0;
+    c->osr_entries = false;
+    free(c->profile);
+    c->profile = NULL;
+    c->profile_count = 0;
+    c->spec_mask = 0;
+    c->limit_memory = 0;
+    c->limit_cpu = 0;
+    c->limit_fds = 0;
+    c->error[0] = 0;
+    c->pass_enable = 0;
+    c->pass_disable = 0;
+    c->time_passes = false;
+    c->unified_pinned = false;
+    c->static_init = false;
+    
+    unified_init(&c->unified);
+    tile_init(&c->tile, &c->unified);
+    codegen_reset(&c->codegen);
+    passes_configure(c);
+}
+
+void compiler_init(Compiler* c, const char* source) {
+    c->profile = NULL;
+    fate_init(&c->fate);
+    codegen_init(&c->codegen);
+    
+    // Initialize compatibility layer (minimal universal)
+    platform_init(&c->platform);
+    bridge_init(&c->bridge);
+    compat_init(&c->compat);
+    
+    // Fate adaptive probing
+    platform_probe(&c->platform, &c->fate);
+    compat_probe(&c->compat, &c->fate);
+    compiler_reset(c, source);
+}
+
+void compiler_free(Compiler* c) {
+    codegen_free(&c->codegen);
+    free(c->profile);
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Parsing helper functions
+// ═══════════════════════════════════════════════════════════════
+
+char peek(Compiler* c) { return (c->pos < c->len) ? c->source[c->pos] : 0; }
+char peek_n(Compiler* c, int n) { return (c->pos + n < c->len) ? c->source[c->pos + n] : 0; }
+char advance(Compiler* c) { return (c->pos < c->len) ? c->source[c->pos++] : 0; }
+
+void skip_whitespace(Compiler* c) {
+    while (c->pos < c->len) {
+        char ch = peek(c);
+        if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
+            advance(c);
         }
         else if (ch == '/' && peek_n(c, 1) == '/') {
             // Skip // comment to end of line
@@ -1044,54 +2667,550 @@ int64_t parse_number(Compiler* c) {
         }
     }
     
+    if ((uint64_t)num >= ELF_BASE && (uint64_t)num < c->codegen.low_literal) {
+        c->codegen.low_literal = (uint64_t)num;
+    }
     return neg ? -num : num;
 }
 
+// Real literal (unified field values); parse_number keeps integer semantics
+double parse_real(Compiler* c) {
+    char* end;
+    double val = strtod(c->source + c->pos, &end);
+    c->pos = end - c->source;
+    return val;
+}
+
 // Forward declarations
 void compile_block(Compiler* c);
 void compile_statement(Compiler* c);
 int64_t compile_expr(Compiler* c);
+void skip_block_decl(Compiler* c);
+void compile_prefetch(Compiler* c);
+void compile_error(Compiler* c, const char* fmt, ...);
+bool ct_fold_call(Compiler* c, Function* fn, int64_t* value);
 
 // ═══════════════════════════════════════════════════════════════
-// Expression compilation
+// Calls and inlining
 // ═══════════════════════════════════════════════════════════════
 
-int64_t compile_expr(Compiler* c) {
-    skip_whitespace(c);
+// A function is inlinable when its body is a single "-> expr" / "return expr"
+// line that only reads its own parameters. The expression is compiled in
+// place of the call, which is also how cross-module calls disappear at link.
+bool fn_is_inlinable(Compiler* c, Function* fn) {
+    if (fn->inline_state != 0) return fn->inline_state > 0;
+    fn->inline_state = -1;
+    if (fn->body_end <= fn->body_pos || fn->body_end - fn->body_pos > INLINE_MAX_BODY) return false;
+    
+    const char* src = c->source;
+    size_t p = fn->body_pos, end = fn->body_end;
+    while (p < end && isspace((unsigned char)src[p])) p++;
+    if (end - p > 7 && strncmp(src + p, "return ", 7) == 0) p += 7;
+    else if (end - p > 3 && strncmp(src + p, "-> ", 3) == 0) p += 3;
+    else return false;
+    size_t expr_pos = p;
+    
+    // Expression must be the whole body and only reference parameters
+    for (; p < end && src[p] != '\n'; p++) {
+        char ch = src[p];
+        if (ch == '{' || ch == '}' || ch == '"' || ch == '#') return false;
+        if (is_ident_start(ch) && (p == expr_pos || !is_ident_char(src[p - 1]))) {
+            size_t s = p;
+            while (p < end && is_ident_char(src[p])) p++;
+            size_t n = p - s;
+            size_t q = p;
+            while (q < end && (src[q] == ' ' || src[q] == '\t')) q++;
+            if (q < end && src[q] == '(') {
+                if (n == strlen(fn->name) && strncmp(src + s, fn->name, n) == 0) return false;
+            } else {
+                bool is_param = false;
+                for (int i = 0; i < fn->param_count; i++) {
+                    if (strlen(fn->params[i]) == n && strncmp(src + s, fn->params[i], n) == 0) {
+                        is_param = true;
+                        break;
+                    }
+                }
+                if (!is_param) return false;
+            }
+            p--;
+        }
+    }
+    for (; p < end; p++) {
+        if (!isspace((unsigned char)src[p])) return false;
+    }
     
-    int64_t left = 0;
+    fn->inline_pos = expr_pos;
+    fn->inline_state = 1;
+    return true;
+}
+
+// Bind pushed arguments to shadow slots and compile the body expression
+void gen_inline_call(Compiler* c, Function* fn) {
+    CodeGen* cg = &c->codegen;
+    int saved_var_count = cg->var_count;
+    int saved_stack_size = cg->stack_size;
     
-    if (isdigit(peek(c)) || (peek(c) == '-' && isdigit(peek_n(c, 1)))) {
-        left = parse_number(c);
-        gen_mov_rax_imm(&c->codegen, left);
-    }
-    else if (peek(c) == '"') {
-        char* str = parse_string(c);
-        size_t len = strlen(str);
-        
-        // Embed string inline in code, use lea to get address
-        // jmp over string data
-        emit_byte(&c->codegen, 0xeb);  // jmp short
-        emit_byte(&c->codegen, len + 1);  // skip len+1 bytes
-        
-        size_t str_pos = c->codegen.code_pos;
-        for (size_t i = 0; i <= len; i++) emit_byte(&c->codegen, str[i]);
-        
-        // lea rax, [rip - offset_to_string]
-        int32_t rel = -(int32_t)(c->codegen.code_pos - str_pos + 7);
-        emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x8d, 0x05}, 3);  // lea rax, [rip+disp32]
-        emit_i32(&c->codegen, rel);
-        
-        left = 0;  // Address is computed at runtime
-        free(str);
+    for (int i = fn->param_count - 1; i >= 0; i--) {
+        Variable* v = &cg->vars[cg->var_count++];
+        strncpy(v->name, fn->params[i], MAX_IDENT - 1);
+        v->type = VAR_INT;
+        v->int_val = 0;
+        v->is_param = false;
+        v->is_const = false;
+        v->is_global = false;
+        v->global_addr = 0;
+        v->reg = 0;
+        cg->stack_size += 8;
+        v->stack_offset = -cg->stack_size;
+        gen_pop_rax(cg);
+        gen_store_var(cg, v);
     }
-    else if (is_ident_start(peek(c))) {
-        char* name = parse_ident(c);
-        skip_whitespace(c);
-        
-        if (peek(c) == '(') {
-            advance(c);
-            skip_whitespace(c);
+    
+    size_t saved_pos = c->pos;
+    c->pos = fn->inline_pos;
+    cg->inline_depth++;
+    compile_expr(c);
+    cg->inline_depth--;
+    c->pos = saved_pos;
+    
+    cg->var_count = saved_var_count;
+    cg->stack_size = saved_stack_size;
+}
+
+// syscall.<name>(...) beyond the file calls: sockets, epoll and workers.
+// recv and send are recvfrom/sendto without an address; kernel arguments
+// past the ones written are zero
+typedef struct { const char* name; int nr, argc, regs; } SyscallDef;
+
+const SyscallDef syscall_defs[] = {
+    { "socket", 41, 3, 3 }, { "connect", 42, 3, 3 }, { "bind", 49, 3, 3 },
+    { "listen", 50, 2, 2 }, { "accept4", 288, 4, 4 }, { "setsockopt", 54, 5, 5 },
+    { "recv", 45, 4, 6 }, { "send", 44, 4, 6 }, { "shutdown", 48, 2, 2 },
+    { "epoll_create1", 291, 1, 1 }, { "epoll_ctl", 233, 4, 4 }, { "epoll_wait", 232, 4, 4 },
+    { "fork", 57, 0, 0 }, { "sched_getaffinity", 204, 3, 3 },
+};
+
+const SyscallDef* syscall_def(const char* name) {
+    for (size_t i = 0; i < sizeof(syscall_defs) / sizeof(syscall_defs[0]); i++) {
+        if (strcmp(syscall_defs[i].name, name) == 0) return &syscall_defs[i];
+    }
+    return NULL;
+}
+
+// Arguments (opening paren consumed, closing one left) into rdi, rsi, rdx,
+// r10, r8, r9, then the syscall; result in rax
+void compile_syscall_def(Compiler* c, const SyscallDef* d) {
+    static const uint8_t pops[6][2] = {
+        {0x5f}, {0x5e}, {0x5a}, {0x41, 0x5a}, {0x41, 0x58}, {0x41, 0x59},
+    };
+    static const uint8_t zeros[6][3] = {
+        {0x31, 0xff}, {0x31, 0xf6}, {0x31, 0xd2}, {0x45, 0x31, 0xd2}, {0x45, 0x31, 0xc0}, {0x45, 0x31, 0xc9},
+    };
+    CodeGen* cg = &c->codegen;
+    for (int i = 0; i < d->argc; i++) {
+        compile_expr(c);
+        gen_push_rax(cg);
+        skip_whitespace(c);
+        if (peek(c) == ',') advance(c);
+    }
+    for (int i = d->argc - 1; i >= 0; i--) emit_bytes(cg, pops[i], i < 3 ? 1 : 2);
+    for (int i = d->argc; i < d->regs; i++) emit_bytes(cg, zeros[i], i < 3 ? 2 : 3);
+    gen_mov_rax_imm(cg, d->nr);
+    gen_syscall(cg);
+}
+
+// Timer callback: a function name is its address, anything else a value
+void compile_timer_fn(Compiler* c) {
+    CodeGen* cg = &c->codegen;
+    skip_whitespace(c);
+    size_t saved = c->pos;
+    if (is_ident_start(peek(c))) {
+        char* name = parse_ident(c);
+        Function* fn = find_func(cg, name);
+        free(name);
+        skip_whitespace(c);
+        if (fn && (peek(c) == ')' || peek(c) == ',')) {
+            emit_bytes(cg, (uint8_t[]){0x48, 0x8d, 0x05}, 3);  // lea rax, [rip + fn]
+            add_fixup(cg, fn->name);
+            return;
+        }
+        c->pos = saved;
+    }
+    compile_expr(c);
+}
+
+// Runtime builtin: arguments into rdi, rsi, rdx, then the helper
+void compile_rt_builtin(Compiler* c, int rt) {
+    CodeGen* cg = &c->codegen;
+    void (*arg_reg[3])(CodeGen*) = { gen_mov_rdi_rax, gen_mov_rsi_rax, gen_mov_rdx_rax };
+    int argc = rt_argc[rt];
+    for (int i = 0; i < argc; i++) {
+        if (i == 1 && (rt == RT_AFTER || rt == RT_EVERY)) compile_timer_fn(c);
+        else compile_expr(c);
+        if (i < argc - 1) {
+            gen_push_rax(cg);
+            skip_whitespace(c);
+            if (peek(c) == ',') advance(c);
+        }
+    }
+    if (argc > 0) arg_reg[argc - 1](cg);
+    for (int i = argc - 2; i >= 0; i--) {
+        gen_pop_rax(cg);
+        arg_reg[i](cg);
+    }
+    skip_whitespace(c);
+    if (peek(c) == ')') advance(c);
+    gen_rt_call(cg, rt);
+}
+
+// Compile "(args)" of a user call (opening paren consumed) and emit the call
+void compile_call(Compiler* c, const char* name) {
+    // Profile site: the '(' of the call
+    size_t site = c->pos;
+    while (site > 0 && isspace((unsigned char)c->source[site - 1])) site--;
+    if (site > 0) site--;
+    
+    // Builtins yield to user functions of the same name
+    bool user_fn = find_func(&c->codegen, name) != NULL;
+    int rt = user_fn ? -1 : rt_builtin(name);
+    if (rt >= 0) {
+        compile_rt_builtin(c, rt);
+        return;
+    }
+    if (!user_fn && strcmp(name, "prefetch") == 0) {
+        compile_prefetch(c);
+        return;
+    }
+    
+    // Pure function, constant arguments: the call is its result
+    int64_t value;
+    if (user_fn && c->passes[PASS_CTFOLD].on) {
+        uint64_t t = pass_begin(c);
+        if (pass_end(c, PASS_CTFOLD, t, ct_fold_call(c, find_func(&c->codegen, name), &value))) {
+            gen_mov_rax_imm(&c->codegen, value);
+            return;
+        }
+    }
+    
+    int argc = 0;
+    while (peek(c) != ')' && c->pos < c->len && argc < 16) {
+        compile_expr(c);
+        gen_push_rax(&c->codegen);
+        argc++;
+        skip_whitespace(c);
+        if (peek(c) == ',') advance(c);
+        skip_whitespace(c);
+    }
+    if (peek(c) == ')') advance(c);
+    
+    CodeGen* cg = &c->codegen;
+    Function* fn = find_func(cg, name);
+    if (fn && fn->param_count == argc && !fn->memo && cg->inline_depth < INLINE_MAX_DEPTH &&
+        cg->var_count + argc < MAX_VARS &&
+        cg->stack_size + argc * 8 <= cg->frame_size &&
+        c->passes[PASS_INLINE].on && fn->body_end - fn->body_pos <= (size_t)c->passes[PASS_INLINE].level &&
+        fn_is_inlinable(c, fn)) {
+        uint64_t t = pass_begin(c);
+        gen_inline_call(c, fn);
+        pass_end(c, PASS_INLINE, t, true);
+        return;
+    }
+    
+    gen_prof_count(cg, PROF_CALL, site);
+    gen_call(cg, name);
+    if (argc > 0) gen_add_rsp(cg, argc * 8);
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Common subexpressions - Local value numbering on source text
+// ═══════════════════════════════════════════════════════════════
+
+// An expression is numbered by its exact text: a pure one (variables,
+// numbers, operators, peek) that occurs again a little further on keeps its
+// value in r8-r10, and the repeat becomes a register move. Entries live
+// until a label, call, syscall or a store to what they read (cse_clear and
+// friends), so a hit is always dominated by the computation it reuses.
+
+enum { CSE_MISS, CSE_EXPR, CSE_PRIMARY };
+
+bool cse_pure(const char* s, size_t len) {
+    for (size_t i = 0; i < len; ) {
+        if (is_ident_start(s[i])) {
+            size_t j = i;
+            while (j < len && is_ident_char(s[j])) j++;
+            size_t k = j;
+            while (k < len && isspace((unsigned char)s[k])) k++;
+            if (k < len && s[k] == '(' && !(j - i == 4 && memcmp(s + i, "peek", 4) == 0)) return false;
+            i = j;
+        } else if (isalnum((unsigned char)s[i]) || isspace((unsigned char)s[i]) || strchr("+-*/<>=!^&|()", s[i])) {
+            i++;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Binary operators. compile_expr, ct_expr and bc_expr all read them here,
+// so the three agree on where an expression ends
+enum {
+    BIN_NONE, BIN_ADD, BIN_SUB, BIN_MUL, BIN_DIV, BIN_GE, BIN_LE, BIN_EQ, BIN_NE,
+    BIN_GT, BIN_LT, BIN_XOR, BIN_AND, BIN_OR
+};
+
+// The operator at pos, or BIN_NONE where the expression ends: before a
+// compound assignment, a negative number, && || << >>, or a "->" on the
+// next line (a return)
+int binop_at(Compiler* c) {
+    char op = peek(c);
+    char op2 = peek_n(c, 1);
+    switch (op) {
+        case '+': return op2 != '=' ? BIN_ADD : BIN_NONE;
+        case '-': return !isdigit(op2) && op2 != '=' && op2 != '>' ? BIN_SUB : BIN_NONE;
+        case '*': return op2 != '=' ? BIN_MUL : BIN_NONE;
+        case '/': return op2 != '=' ? BIN_DIV : BIN_NONE;
+        case '^': return op2 != '=' ? BIN_XOR : BIN_NONE;
+        case '&': return op2 != '&' && op2 != '=' ? BIN_AND : BIN_NONE;
+        case '|': return op2 != '|' && op2 != '=' ? BIN_OR : BIN_NONE;
+        case '>': return op2 == '=' ? BIN_GE : op2 != '>' ? BIN_GT : BIN_NONE;
+        case '<': return op2 == '=' ? BIN_LE : op2 != '<' ? BIN_LT : BIN_NONE;
+        case '=': return op2 == '=' ? BIN_EQ : BIN_NONE;
+        case '!': return op2 == '=' ? BIN_NE : BIN_NONE;
+        default: return BIN_NONE;
+    }
+}
+
+// binop_at, moving pos past the operator
+int parse_binop(Compiler* c) {
+    int op = binop_at(c);
+    if (op >= BIN_GE && op <= BIN_NE) c->pos += 2;
+    else if (op != BIN_NONE) c->pos += 1;
+    return op;
+}
+
+// "name = ..." at pos
+bool cse_is_assign(Compiler* c) {
+    if (!is_ident_start(peek(c))) return false;
+    size_t p = c->pos;
+    while (p < c->len && is_ident_char(c->source[p])) p++;
+    while (p < c->len && (c->source[p] == ' ' || c->source[p] == '\t')) p++;
+    return p + 1 < c->len && c->source[p] == '=' && c->source[p + 1] != '=';
+}
+
+// A cached expression (or peek primary) starting at pos: load it into rax
+int cse_lookup(Compiler* c) {
+    CodeGen* cg = &c->codegen;
+    if (cg->inline_depth || !c->passes[PASS_CSE].on) return CSE_MISS;
+    uint64_t t = pass_begin(c);
+    for (int i = 0; i < CSE_SLOTS; i++) {
+        const char* k = cg->cse[i].key;
+        size_t n = cg->cse[i].len;
+        if (!k || c->pos + n > c->len || memcmp(c->source + c->pos, k, n) != 0) continue;
+        size_t saved_pos = c->pos;
+        c->pos += n;
+        bool ok = !(is_ident_char(k[n - 1]) && is_ident_char(peek(c)));
+        skip_whitespace(c);
+        if (peek(c) == '(' || (!cg->cse[i].primary && binop_at(c) != BIN_NONE)) ok = false;
+        if (!ok) {
+            c->pos = saved_pos;
+            continue;
+        }
+        gen_mov_rax_reg(cg, CSE_FIRST_REG + i);
+        pass_end(c, PASS_CSE, t, true);
+        return cg->cse[i].primary ? CSE_PRIMARY : CSE_EXPR;
+    }
+    pass_end(c, PASS_CSE, t, false);
+    return CSE_MISS;
+}
+
+// rax holds the value of source[start, pos): cache it if it repeats soon
+void cse_record(Compiler* c, size_t start, bool primary) {
+    CodeGen* cg = &c->codegen;
+    if (cg->inline_depth || !c->passes[PASS_CSE].on) return;
+    uint64_t t = pass_begin(c);
+    size_t end = c->pos;
+    while (end > start && isspace((unsigned char)c->source[end - 1])) end--;
+    const char* key = c->source + start;
+    size_t n = end - start;
+    size_t limit = (size_t)c->passes[PASS_CSE].level;
+    size_t window = c->len - c->pos < limit ? c->len - c->pos : limit;
+    if (n == 0 || !cse_pure(key, n) || !memmem(c->source + c->pos, window, key, n)) {
+        pass_end(c, PASS_CSE, t, false);
+        return;
+    }
+    pass_end(c, PASS_CSE, t, true);
+    
+    int slot = cg->cse_next;
+    cg->cse_next = (slot + 1) % CSE_SLOTS;
+    cg->cse[slot].key = key;
+    cg->cse[slot].len = n;
+    cg->cse[slot].primary = primary;
+    gen_mov_reg_rax(cg, CSE_FIRST_REG + slot);
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Strength reduction - Constant multiplies and scaled addresses
+// ═══════════════════════════════════════════════════════════════
+
+// The right operand of * is a bare literal: consume it into k
+bool mul_constant(Compiler* c, int64_t* k) {
+    size_t saved_pos = c->pos;
+    skip_whitespace(c);
+    if (isdigit(peek(c)) || (peek(c) == '-' && isdigit(peek_n(c, 1)))) {
+        *k = parse_number(c);
+        if (!is_ident_char(peek(c))) {
+            skip_whitespace(c);
+            if (peek(c) != '(' && binop_at(c) == BIN_NONE) return true;
+        }
+    } else if (is_ident_start(peek(c))) {
+        // A specialized parameter is a literal too
+        char* name = parse_ident(c);
+        Variable* v = find_var(&c->codegen, name);
+        free(name);
+        skip_whitespace(c);
+        if (v && v->is_const && peek(c) != '(' && binop_at(c) == BIN_NONE) {
+            *k = v->int_val;
+            return true;
+        }
+    }
+    c->pos = saved_pos;
+    return false;
+}
+
+// "base + index * scale" up to the closing delimiter, scale 2, 4 or 8: the
+// peek/poke address becomes [rbx + rcx*scale] instead of a multiply and add
+bool parse_scaled_addr(Compiler* c, char close, Variable** base, Variable** index, int* scale) {
+    size_t saved_pos = c->pos;
+    char* b = NULL;
+    char* i = NULL;
+    int64_t k = 0;
+    *base = *index = NULL;
+    if (!c->passes[PASS_STRENGTH].on) return false;
+    uint64_t t = pass_begin(c);
+    skip_whitespace(c);
+    if (is_ident_start(peek(c))) {
+        b = parse_ident(c);
+        skip_whitespace(c);
+        if (peek(c) == '+') {
+            advance(c);
+            skip_whitespace(c);
+            if (is_ident_start(peek(c))) {
+                i = parse_ident(c);
+                skip_whitespace(c);
+            }
+        }
+    }
+    if (i && peek(c) == '*') {
+        advance(c);
+        if (mul_constant(c, &k) && (k == 2 || k == 4 || k == 8) && peek(c) == close) {
+            *base = find_var(&c->codegen, b);
+            *index = find_var(&c->codegen, i);
+            *scale = (int)k;
+        }
+    }
+    free(b);
+    free(i);
+    if (pass_end(c, PASS_STRENGTH, t, *base && *index)) return true;
+    c->pos = saved_pos;
+    return false;
+}
+
+// rbx = base, rcx = index
+void gen_scaled_addr(CodeGen* cg, Variable* base, Variable* index) {
+    gen_load_var(cg, base);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xc3}, 3);  // mov rbx, rax
+    gen_load_var(cg, index);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xc1}, 3);  // mov rcx, rax
+}
+
+// SIB byte for [rbx + rcx*scale]
+uint8_t scaled_sib(int scale) {
+    return (scale == 2 ? 0x40 : scale == 4 ? 0x80 : 0xc0) | 0x0b;
+}
+
+// poke(addr, val) after "poke(", through the closing paren
+void compile_poke(Compiler* c) {
+    Variable *base, *index;
+    int scale;
+    if (parse_scaled_addr(c, ',', &base, &index, &scale)) {
+        gen_load_var(&c->codegen, base);
+        gen_push_rax(&c->codegen);
+        gen_load_var(&c->codegen, index);
+        gen_push_rax(&c->codegen);
+    } else {
+        compile_expr(c);  // addr
+        gen_push_rax(&c->codegen);
+        scale = 0;
+    }
+    skip_whitespace(c);
+    if (peek(c) == ',') advance(c);
+    skip_whitespace(c);
+    compile_expr(c);  // val in rax
+    skip_whitespace(c);
+    if (peek(c) == ')') advance(c);
+    if (scale) {
+        emit_byte(&c->codegen, 0x59);  // pop rcx
+        gen_pop_rbx(&c->codegen);
+        // mov [rbx + rcx*scale], al
+        emit_bytes(&c->codegen, (uint8_t[]){0x88, 0x04, scaled_sib(scale)}, 3);
+    } else {
+        gen_pop_rbx(&c->codegen);
+        // mov [rbx], al
+        emit_bytes(&c->codegen, (uint8_t[]){0x88, 0x03}, 2);
+    }
+    cse_kill_peek(&c->codegen);
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Expression compilation
+// ═══════════════════════════════════════════════════════════════
+
+int64_t compile_expr(Compiler* c) {
+    skip_whitespace(c);
+    
+    int64_t left = 0;
+    size_t start = c->pos;
+    bool binary = false;
+    size_t literal_pos = 0, literal_end = 0;  // mov rax, imm of a literal primary
+    int cached = cse_lookup(c);
+    if (cached == CSE_EXPR) return 0;
+    
+    if (cached == CSE_PRIMARY) {
+        // peek(...) reused; its operators follow
+    }
+    else if (isdigit(peek(c)) || (peek(c) == '-' && isdigit(peek_n(c, 1)))) {
+        left = parse_number(c);
+        literal_pos = c->codegen.code_pos;
+        gen_mov_rax_imm(&c->codegen, left);
+        literal_end = c->codegen.code_pos;
+    }
+    else if (peek(c) == '"') {
+        char* str = parse_string(c);
+        size_t len = strlen(str);
+        
+        // Embed string inline in code, use lea to get address
+        // jmp over string data
+        emit_byte(&c->codegen, 0xeb);  // jmp short
+        emit_byte(&c->codegen, len + 1);  // skip len+1 bytes
+        
+        size_t str_pos = c->codegen.code_pos;
+        for (size_t i = 0; i <= len; i++) emit_byte(&c->codegen, str[i]);
+        
+        // lea rax, [rip - offset_to_string]
+        int32_t rel = -(int32_t)(c->codegen.code_pos - str_pos + 7);
+        emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x8d, 0x05}, 3);  // lea rax, [rip+disp32]
+        emit_i32(&c->codegen, rel);
+        
+        left = 0;  // Address is computed at runtime
+        free(str);
+    }
+    else if (is_ident_start(peek(c))) {
+        char* name = parse_ident(c);
+        skip_whitespace(c);
+        
+        if (peek(c) == '(') {
+            advance(c);
+            skip_whitespace(c);
             
             // Built-in functions
             if (strcmp(name, "getchar") == 0) {
@@ -1108,26 +3227,26 @@ int64_t compile_expr(Compiler* c) {
             }
             // peek(addr) - read byte from memory
             else if (strcmp(name, "peek") == 0) {
-                compile_expr(c);  // addr in rax
-                skip_whitespace(c);
-                if (peek(c) == ')') advance(c);
-                // movzx rax, byte [rax]
-                emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x0f, 0xb6, 0x00}, 4);
+                Variable *base, *index;
+                int scale;
+                if (parse_scaled_addr(c, ')', &base, &index, &scale)) {
+                    gen_scaled_addr(&c->codegen, base, index);
+                    // movzx rax, byte [rbx + rcx*scale]
+                    emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x0f, 0xb6, 0x04, scaled_sib(scale)}, 5);
+                    advance(c);
+                } else {
+                    compile_expr(c);  // addr in rax
+                    skip_whitespace(c);
+                    if (peek(c) == ')') advance(c);
+                    // movzx rax, byte [rax]
+                    emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x0f, 0xb6, 0x00}, 4);
+                }
+                cse_record(c, start, true);
                 left = 0;
             }
             // poke(addr, val) - write byte to memory
             else if (strcmp(name, "poke") == 0) {
-                compile_expr(c);  // addr
-                gen_push_rax(&c->codegen);
-                skip_whitespace(c);
-                if (peek(c) == ',') advance(c);
-                skip_whitespace(c);
-                compile_expr(c);  // val in rax
-                skip_whitespace(c);
-                if (peek(c) == ')') advance(c);
-                gen_pop_rbx(&c->codegen);
-                // mov [rbx], al
-                emit_bytes(&c->codegen, (uint8_t[]){0x88, 0x03}, 2);
+                compile_poke(c);
                 left = 0;
             }
             // syscall.xxx - handle syscall.open, syscall.read, etc.
@@ -1209,31 +3328,24 @@ int64_t compile_expr(Compiler* c) {
                     gen_mov_rax_imm(&c->codegen, 9);  // sys_mmap
                     gen_syscall(&c->codegen);
                 }
+                else if (syscall_def(syscall_name)) {
+                    compile_syscall_def(c, syscall_def(syscall_name));
+                }
                 skip_whitespace(c);
                 if (peek(c) == ')') advance(c);
                 // Don't free syscall_name - it points into 'name' which is freed later
                 left = 0;
             }
             else {
-                int argc = 0;
-                while (peek(c) != ')' && c->pos < c->len && argc < 16) {
-                    compile_expr(c);
-                    gen_push_rax(&c->codegen);
-                    argc++;
-                    skip_whitespace(c);
-                    if (peek(c) == ',') advance(c);
-                    skip_whitespace(c);
-                }
-                if (peek(c) == ')') advance(c);
-                
-                gen_call(&c->codegen, name);
-                if (argc > 0) gen_add_rsp(&c->codegen, argc * 8);
+                compile_call(c, name);
                 left = 0;
             }
         } else {
             Variable* v = find_var(&c->codegen, name);
             if (v) {
+                if (v->is_const) literal_pos = c->codegen.code_pos;
                 gen_load_var(&c->codegen, v);
+                if (v->is_const) literal_end = c->codegen.code_pos;
                 left = v->int_val;
             } else {
                 left = 0;
@@ -1256,663 +3368,4397 @@ int64_t compile_expr(Compiler* c) {
     // Binary operators
     skip_whitespace(c);
     while (c->pos < c->len) {
-        char op = peek(c);
-        char op2 = peek_n(c, 1);
+        int op = parse_binop(c);
+        if (op == BIN_NONE) break;
         
-        if (op == '+' && op2 != '=') {
-            advance(c);
-            gen_push_rax(&c->codegen);
-            compile_expr(c);
-            gen_pop_rbx(&c->codegen);
-            emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x01, 0xd8}, 3);
-        }
-        else if (op == '-' && !isdigit(op2) && op2 != '=') {
-            advance(c);
-            gen_push_rax(&c->codegen);
-            compile_expr(c);
-            gen_pop_rbx(&c->codegen);
-            emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x89, 0xc1}, 3);
-            emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x89, 0xd8}, 3);
-            emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x29, 0xc8}, 3);
-        }
-        else if (op == '*' && op2 != '=') {
-            advance(c);
-            gen_push_rax(&c->codegen);
-            compile_expr(c);
-            gen_pop_rbx(&c->codegen);
-            gen_mul_rax_rbx(&c->codegen);
+        if (op == BIN_MUL) {
+            int64_t k;
+            bool strength = c->passes[PASS_STRENGTH].on;
+            uint64_t t = pass_begin(c);
+            if (strength && mul_constant(c, &k)) {
+                gen_mul_rax_imm(&c->codegen, k);
+                pass_end(c, PASS_STRENGTH, t, true);
+            } else if (strength && !binary && literal_end && literal_end == c->codegen.code_pos) {
+                // literal * expr: drop the literal load, scale the right side
+                c->codegen.code_pos = literal_pos;
+                compile_expr(c);
+                gen_mul_rax_imm(&c->codegen, left);
+                pass_end(c, PASS_STRENGTH, t, true);
+            } else {
+                gen_push_rax(&c->codegen);
+                compile_expr(c);
+                gen_pop_rbx(&c->codegen);
+                gen_mul_rax_rbx(&c->codegen);
+            }
         }
-        else if (op == '/' && op2 != '=') {
-            advance(c);
+        else if (op == BIN_DIV) {
             gen_push_rax(&c->codegen);
             compile_expr(c);
             emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x89, 0xc3}, 3);
             gen_pop_rax(&c->codegen);
             gen_div_rax_rbx(&c->codegen);
         }
-        else if (op == '>' && op2 == '=') {
-            advance(c); advance(c);
-            gen_push_rax(&c->codegen);
-            compile_expr(c);
-            gen_pop_rbx(&c->codegen);
-            emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x39, 0xc3}, 3);
-            emit_bytes(&c->codegen, (uint8_t[]){0x0f, 0x9d, 0xc0}, 3);
-            emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x0f, 0xb6, 0xc0}, 4);
-        }
-        else if (op == '<' && op2 == '=') {
-            advance(c); advance(c);
-            gen_push_rax(&c->codegen);
-            compile_expr(c);
-            gen_pop_rbx(&c->codegen);
-            emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x39, 0xc3}, 3);
-            emit_bytes(&c->codegen, (uint8_t[]){0x0f, 0x9e, 0xc0}, 3);
-            emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x0f, 0xb6, 0xc0}, 4);
-        }
-        else if (op == '=' && op2 == '=') {
-            advance(c); advance(c);
-            gen_push_rax(&c->codegen);
-            compile_expr(c);
-            gen_pop_rbx(&c->codegen);
-            emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x39, 0xc3}, 3);
-            emit_bytes(&c->codegen, (uint8_t[]){0x0f, 0x94, 0xc0}, 3);
-            emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x0f, 0xb6, 0xc0}, 4);
-        }
-        else if (op == '!' && op2 == '=') {
-            advance(c); advance(c);
-            gen_push_rax(&c->codegen);
-            compile_expr(c);
-            gen_pop_rbx(&c->codegen);
-            emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x39, 0xc3}, 3);
-            emit_bytes(&c->codegen, (uint8_t[]){0x0f, 0x95, 0xc0}, 3);
-            emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x0f, 0xb6, 0xc0}, 4);
-        }
-        else if (op == '>' && op2 != '>') {
-            advance(c);
-            gen_push_rax(&c->codegen);
-            compile_expr(c);
-            gen_pop_rbx(&c->codegen);
-            emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x39, 0xc3}, 3);
-            emit_bytes(&c->codegen, (uint8_t[]){0x0f, 0x9f, 0xc0}, 3);
-            emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x0f, 0xb6, 0xc0}, 4);
-        }
-        else if (op == '<' && op2 != '<') {
-            advance(c);
+        else {
             gen_push_rax(&c->codegen);
             compile_expr(c);
             gen_pop_rbx(&c->codegen);
-            emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x39, 0xc3}, 3);
-            emit_bytes(&c->codegen, (uint8_t[]){0x0f, 0x9c, 0xc0}, 3);
-            emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x0f, 0xb6, 0xc0}, 4);
-        }
-        else {
-            break;
+            // setcc for the comparisons, BIN_GE through BIN_LT
+            static const uint8_t setcc[] = { 0x9d, 0x9e, 0x94, 0x95, 0x9f, 0x9c };
+            switch (op) {
+                case BIN_ADD:
+                    emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x01, 0xd8}, 3);
+                    break;
+                case BIN_SUB:
+                    emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x89, 0xc1}, 3);
+                    emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x89, 0xd8}, 3);
+                    emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x29, 0xc8}, 3);
+                    break;
+                case BIN_XOR:
+                    emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x31, 0xd8}, 3);  // xor rax, rbx
+                    break;
+                case BIN_AND:
+                    emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x21, 0xd8}, 3);  // and rax, rbx
+                    break;
+                case BIN_OR:
+                    emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x09, 0xd8}, 3);  // or rax, rbx
+                    break;
+                default:
+                    emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x39, 0xc3}, 3);
+                    emit_bytes(&c->codegen, (uint8_t[]){0x0f, setcc[op - BIN_GE], 0xc0}, 3);
+                    emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x0f, 0xb6, 0xc0}, 4);
+                    break;
+            }
         }
+        binary = true;
     }
     
+    if (binary) cse_record(c, start, false);
     return left;
 }
 
 // ═══════════════════════════════════════════════════════════════
-// Statement compilation
+// Prefetch - Explicit hints and strided peek loops
 // ═══════════════════════════════════════════════════════════════
 
-void compile_out(Compiler* c) {
+// prefetch(addr, hint) - hint is t0 (default), t1, t2, nta or w (for write)
+void compile_prefetch(Compiler* c) {
+    compile_expr(c);
     skip_whitespace(c);
-    char* text = parse_string(c);
-    size_t len = strlen(text);
-    if (len == 0) { free(text); return; }
-    
-    // Use jmp near (32-bit offset) to skip data, supports long strings
-    emit_byte(&c->codegen, 0xe9);  // jmp near rel32
-    emit_i32(&c->codegen, len);    // Skip len bytes
-    
-    size_t data_pos = c->codegen.code_pos;
-    for (size_t i = 0; i < len; i++) emit_byte(&c->codegen, text[i]);
-    
-    gen_mov_rax_imm(&c->codegen, 1);
-    gen_mov_rdi_imm(&c->codegen, 1);
-    
-    int32_t rel = -(int32_t)(c->codegen.code_pos - data_pos + 7);
-    emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x8d, 0x35}, 3);
-    emit_i32(&c->codegen, rel);
-    
-    gen_mov_rdx_imm(&c->codegen, len);
-    gen_syscall(&c->codegen);
-    
-    free(text);
+    uint8_t op[3] = {0x0f, 0x18, 0x08};  // prefetcht0 [rax]
+    if (peek(c) == ',') {
+        advance(c);
+        skip_whitespace(c);
+        char* hint = parse_ident(c);
+        if (strcmp(hint, "t1") == 0) op[2] = 0x10;
+        else if (strcmp(hint, "t2") == 0) op[2] = 0x18;
+        else if (strcmp(hint, "nta") == 0) op[2] = 0x00;
+        else if (strcmp(hint, "w") == 0) op[1] = 0x0d;  // prefetchw [rax]
+        else if (strcmp(hint, "t0") != 0) compile_error(c, "Unknown prefetch hint: %s", hint);  // A typo is not t0
+        free(hint);
+        skip_whitespace(c);
+    }
+    if (peek(c) == ')') advance(c);
+    emit_bytes(&c->codegen, op, 3);
 }
 
-void compile_emit(Compiler* c) {
-    skip_whitespace(c);
-    char* bytes = parse_string(c);
-    size_t len = strlen(bytes);
-    if (len == 0) { free(bytes); return; }
-    
-    // Emit outputs bytes at runtime, use jmp near for long data
-    emit_byte(&c->codegen, 0xe9);  // jmp near rel32
-    emit_i32(&c->codegen, len);    // Skip len bytes
-    
-    size_t data_pos = c->codegen.code_pos;
-    for (size_t i = 0; i < len; i++) emit_byte(&c->codegen, (uint8_t)bytes[i]);
-    
-    gen_mov_rax_imm(&c->codegen, 1);
-    gen_mov_rdi_imm(&c->codegen, 1);
-    
-    int32_t rel = -(int32_t)(c->codegen.code_pos - data_pos + 7);
-    emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x8d, 0x35}, 3);
-    emit_i32(&c->codegen, rel);
-    
-    gen_mov_rdx_imm(&c->codegen, len);
-    gen_syscall(&c->codegen);
-    
-    free(bytes);
+typedef struct {
+    char base[MAX_IDENT];
+    char index[MAX_IDENT];
+    int64_t scale;       // Bytes per index unit
+    int64_t step;        // Index change per iteration
+} StridedPeek;
+
+// Skip a balanced { } block starting at c->pos (strings and comments aware)
+void skip_braces(Compiler* c) {
+    int depth = 0;
+    while (c->pos < c->len) {
+        char ch = advance(c);
+        if (ch == '{') depth++;
+        else if (ch == '}' && --depth <= 0) return;
+        else if (ch == '"') {
+            while (c->pos < c->len && peek(c) != '"') {
+                if (peek(c) == '\\') advance(c);
+                advance(c);
+            }
+            advance(c);
+        } else if (ch == '#') {
+            while (c->pos < c->len && peek(c) != '\n') advance(c);
+        }
+    }
 }
 
-void compile_fn_def(Compiler* c) {
-    skip_whitespace(c);
-    char* name = parse_ident(c);
-    
-    if (c->codegen.func_count >= MAX_FUNCS) { free(name); return; }
-    
-    Function* fn = &c->codegen.funcs[c->codegen.func_count++];
-    strncpy(fn->name, name, MAX_IDENT - 1);
-    fn->param_count = 0;
-    fn->body_pos = 0;
-    fn->body_end = 0;
-    
+// "I = I + N" at c->pos: returns true with the variable and step
+bool scan_step(Compiler* c, char* var, int64_t* step) {
+    char* a = parse_ident(c);
+    bool ok = false;
     skip_whitespace(c);
-    while (c->pos < c->len && peek(c) != '{' && fn->param_count < 16) {
-        if (is_ident_start(peek(c))) {
-            char* param = parse_ident(c);
-            strncpy(fn->params[fn->param_count++], param, MAX_IDENT - 1);
-            free(param);
-        }
-        skip_whitespace(c);
-    }
-    
-    if (peek(c) == '{') {
+    if (peek(c) == '=' && peek_n(c, 1) != '=') {
         advance(c);
-        fn->body_pos = c->pos;
-        int depth = 1;
-        while (c->pos < c->len && depth > 0) {
-            char ch = peek(c);
-            if (ch == '{') depth++;
-            else if (ch == '}') depth--;
-            else if (ch == '"') {
+        skip_whitespace(c);
+        if (is_ident_start(peek(c))) {
+            char* b = parse_ident(c);
+            skip_whitespace(c);
+            if (strcmp(a, b) == 0 && peek(c) == '+') {
                 advance(c);
-                while (c->pos < c->len && peek(c) != '"') {
-                    if (peek(c) == '\\') advance(c);
-                    advance(c);
+                skip_whitespace(c);
+                if (isdigit(peek(c))) {
+                    *step = parse_number(c);
+                    while (peek(c) == ' ' || peek(c) == '\t') advance(c);
+                    ok = peek(c) == '\n' || peek(c) == '}' || peek(c) == '#';
+                    strncpy(var, a, MAX_IDENT - 1);
                 }
-            } else if (ch == '#') {
-                while (c->pos < c->len && peek(c) != '\n') advance(c);
             }
-            advance(c);
+            free(b);
         }
-        fn->body_end = c->pos - 1;
     }
-    
-    free(name);
+    free(a);
+    return ok;
 }
 
-void compile_when(Compiler* c) {
-    int id = c->codegen.when_id++;
-    char end_label[64];
-    sprintf(end_label, "_when_end_%d", id);
-    
-    skip_whitespace(c);
-    compile_expr(c);
-    
-    gen_test_rax_rax(&c->codegen);
-    gen_je(&c->codegen, end_label);
-    
+// "X + I*K)" or "X + K*I)" after "peek(" at c->pos
+bool scan_strided(Compiler* c, StridedPeek* sp) {
+    if (!is_ident_start(peek(c))) return false;
+    char* base = parse_ident(c);
+    char* index = NULL;
+    int64_t scale = 0;
     skip_whitespace(c);
-    if (peek(c) == '{') compile_block(c);
-    
-    add_label(&c->codegen, end_label);
+    if (peek(c) == '+') {
+        advance(c);
+        skip_whitespace(c);
+        if (is_ident_start(peek(c))) {
+            index = parse_ident(c);
+            skip_whitespace(c);
+            if (peek(c) == '*') {
+                advance(c);
+                skip_whitespace(c);
+                if (isdigit(peek(c))) scale = parse_number(c);
+            }
+        } else if (isdigit(peek(c))) {
+            scale = parse_number(c);
+            skip_whitespace(c);
+            if (peek(c) == '*') {
+                advance(c);
+                skip_whitespace(c);
+                if (is_ident_start(peek(c))) index = parse_ident(c);
+            }
+        }
+        skip_whitespace(c);
+    }
+    bool ok = index && scale > 0 && peek(c) == ')' && strcmp(base, index) != 0;
+    if (ok) {
+        strncpy(sp->base, base, MAX_IDENT - 1);
+        strncpy(sp->index, index, MAX_IDENT - 1);
+        sp->scale = scale;
+    }
+    free(base);
+    free(index);
+    return ok;
 }
 
-void compile_loop(Compiler* c) {
-    int id = c->codegen.loop_id++;
-    
-    char start_label[64], end_label[64];
-    sprintf(start_label, "_loop_start_%d", id);
-    sprintf(end_label, "_loop_end_%d", id);
-    
-    if (c->loop_depth < 16) {
-        strncpy(c->loop_labels[c->loop_depth][0], start_label, 63);
-        strncpy(c->loop_labels[c->loop_depth][1], end_label, 63);
-        c->loop_depth++;
+// Collect strided peeks of the loop body at c->pos whose index is stepped
+// by a constant in the same body. Nested loops are left to their own head.
+int find_strided_peeks(Compiler* c, StridedPeek* out, int max) {
+    size_t saved_pos = c->pos;
+    size_t body_start = c->pos;
+    skip_braces(c);
+    size_t body_end = c->pos;
+    
+    char vars[16][MAX_IDENT];
+    int64_t steps[16];
+    int var_count = 0;
+    int count = 0;
+    StridedPeek found[PREFETCH_MAX_SITES * 2];
+    int found_count = 0;
+    
+    c->pos = body_start + 1;
+    while (c->pos < body_end) {
+        char ch = peek(c);
+        bool word_start = !is_ident_char(c->source[c->pos - 1]);
+        if (ch == '"' || ch == '#') {
+            size_t p = c->pos;
+            if (ch == '#') skip_line(c);
+            else { advance(c); while (c->pos < body_end && peek(c) != '"') advance(c); advance(c); }
+            if (c->pos == p) advance(c);
+        }
+        else if (word_start && match(c, "loop") && !is_ident_char(peek_n(c, 4))) {
+            c->pos += 4;
+            skip_whitespace(c);
+            if (peek(c) == '{') skip_braces(c);
+        }
+        else if (word_start && match(c, "peek(") && found_count < PREFETCH_MAX_SITES * 2) {
+            c->pos += 5;
+            skip_whitespace(c);
+            if (scan_strided(c, &found[found_count])) found_count++;
+        }
+        else if (word_start && is_ident_start(ch)) {
+            size_t p = c->pos;
+            if (var_count < 16 && scan_step(c, vars[var_count], &steps[var_count])) var_count++;
+            else { c->pos = p; free(parse_ident(c)); }
+        }
+        else advance(c);
     }
     
-    add_label(&c->codegen, start_label);
-    
-    skip_whitespace(c);
-    if (peek(c) == '{') compile_block(c);
-    
-    // Fate hook: insert observation in loop
-    if (c->fate_mode && c->fate.on) {
-        fate_tick(&c->fate, &c->tile);
+    for (int i = 0; i < found_count && count < max; i++) {
+        for (int v = 0; v < var_count; v++) {
+            if (strcmp(found[i].index, vars[v]) != 0) continue;
+            found[i].step = steps[v];
+            bool dup = false;
+            for (int k = 0; k < count; k++) {
+                dup |= strcmp(out[k].base, found[i].base) == 0 &&
+                       strcmp(out[k].index, found[i].index) == 0 && out[k].scale == found[i].scale;
+            }
+            if (!dup && found[i].scale * found[i].step >= PREFETCH_MIN_STRIDE) out[count++] = found[i];
+            break;
+        }
     }
-    
-    gen_jmp(&c->codegen, start_label);
-    add_label(&c->codegen, end_label);
-    
-    if (c->loop_depth > 0) c->loop_depth--;
+    c->pos = saved_pos;
+    return count;
 }
 
-void compile_break(Compiler* c) {
-    if (c->loop_depth > 0) {
-        gen_jmp(&c->codegen, c->loop_labels[c->loop_depth - 1][1]);
-    }
+// Lookahead in bytes: 256B..2KB, farther as the field leans to speed (e)
+int prefetch_distance(Compiler* c, int64_t stride) {
+    int64_t lookahead = c->passes[PASS_PREFETCH].level;
+    int64_t iters = (lookahead + stride - 1) / stride;
+    return iters < 1 ? 1 : (int)iters;
 }
 
-void compile_return(Compiler* c) {
-    skip_whitespace(c);
-    if (c->pos < c->len && peek(c) != '\n' && peek(c) != '}') {
-        compile_expr(c);
+// At a loop head: prefetcht0 [X + (I + d*step)*K] for every strided stream
+void gen_loop_prefetch(Compiler* c) {
+    if (!c->passes[PASS_PREFETCH].on) return;
+    uint64_t t = pass_begin(c);
+    StridedPeek sites[PREFETCH_MAX_SITES];
+    int count = find_strided_peeks(c, sites, PREFETCH_MAX_SITES);
+    CodeGen* cg = &c->codegen;
+    pass_end(c, PASS_PREFETCH, t, count > 0);
+    
+    for (int i = 0; i < count; i++) {
+        Variable* base = find_var(cg, sites[i].base);
+        Variable* index = find_var(cg, sites[i].index);
+        int64_t stride = sites[i].scale * sites[i].step;
+        int64_t ahead = prefetch_distance(c, stride) * sites[i].step;
+        if (!base || !index || sites[i].scale > INT32_MAX || ahead > INT32_MAX) continue;
+        
+        gen_load_var(cg, index);
+        emit_bytes(cg, (uint8_t[]){0x48, 0x05}, 2);        // add rax, ahead
+        emit_u32(cg, (uint32_t)ahead);
+        emit_bytes(cg, (uint8_t[]){0x48, 0x69, 0xc0}, 3);  // imul rax, rax, scale
+        emit_u32(cg, (uint32_t)sites[i].scale);
+        gen_push_rax(cg);
+        gen_load_var(cg, base);
+        gen_pop_rbx(cg);
+        emit_bytes(cg, (uint8_t[]){0x48, 0x01, 0xd8}, 3);  // add rax, rbx
+        emit_bytes(cg, (uint8_t[]){0x0f, 0x18, 0x08}, 3);  // prefetcht0 [rax]
+        fate_learn(&c->fate, "prefetch.distance", ahead / sites[i].step);
     }
-    
-    // If inside a loop, -> acts as break (jump to loop end)
-    // If outside loops (at function level), -> acts as return
-    if (c->loop_depth > 0) {
-        // Break out of innermost loop
-        gen_jmp(&c->codegen, c->loop_labels[c->loop_depth - 1][1]);
-    } else {
-        // Return from function
-        gen_epilogue(&c->codegen);
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Layout - Cold when bodies and function order
+// ═══════════════════════════════════════════════════════════════
+//
+// With a Fate profile, a when body taken at most once per PROF_COLD_RATIO
+// evaluations is cold; without one, bodies that exit the program are. Cold
+// bodies move to the cold region so the likely path falls through.
+//
+// Functions are placed Pettis-Hansen style: chains are merged along the
+// heaviest call edges first, so hot callers and callees share pages and
+// cache lines. Edge weights are profiled call counts, or without a profile
+// one per call site times 8 per enclosing loop.
+
+#define MAX_LAYOUT_EDGES 4096
+
+typedef struct { int a, b; uint64_t weight; } CallEdge;
+
+bool profile_load(Compiler* c, const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    uint32_t head[3];
+    bool ok = fread(head, 4, 3, f) == 3 && head[0] == PROF_MAGIC &&
+              head[1] == source_hash(c->source, c->len) && head[2] <= MAX_PROF_SITES;
+    if (ok) {
+        uint32_t n = head[2];
+        uint32_t* sites = malloc(n * 8 + 1);
+        uint64_t* counts = malloc(n * 8 + 1);
+        ok = fread(sites, 8, n, f) == n && fread(counts, 8, n, f) == n;
+        if (ok) {
+            c->profile = malloc(n * sizeof(ProfileEntry) + 1);
+            for (uint32_t i = 0; i < n; i++) {
+                c->profile[i].kind = sites[i * 2];
+                c->profile[i].pos = sites[i * 2 + 1];
+                c->profile[i].count = counts[i];
+            }
+            c->profile_count = n;
+        }
+        free(sites);
+        free(counts);
     }
+    fclose(f);
+    return ok;
 }
 
-void compile_assign(Compiler* c, const char* name) {
-    skip_whitespace(c);
-    
-    Variable* v = find_var(&c->codegen, name);
-    if (!v) v = add_var(&c->codegen, name, VAR_INT);
-    
-    if (v) {
-        compile_expr(c);
-        gen_store_var(&c->codegen, v);
+// Profiled count of a site, -1 when the profile has no such site. A site
+// compiled more than once (inlined bodies) sums its counters.
+int64_t profile_lookup(Compiler* c, int kind, size_t pos) {
+    int64_t total = -1;
+    for (int i = 0; i < c->profile_count; i++) {
+        if (c->profile[i].kind == (uint32_t)kind && c->profile[i].pos == pos) {
+            total = (total < 0 ? 0 : total) + (int64_t)c->profile[i].count;
+        }
     }
+    return total;
 }
 
-void compile_block(Compiler* c) {
-    skip_whitespace(c);
-    if (peek(c) == '{') advance(c);
+// c->pos is at the '{' of the body of the when whose condition starts at site
+bool when_is_cold(Compiler* c, size_t site) {
+    if (!c->passes[PASS_LAYOUT].on) return false;
+    int64_t evals = profile_lookup(c, PROF_WHEN, site);
+    int64_t taken = profile_lookup(c, PROF_TAKEN, site);
+    if (evals >= 0 && taken >= 0) return taken * PROF_COLD_RATIO <= evals;
     
-    while (c->pos < c->len) {
-        skip_whitespace(c);
-        if (peek(c) == '}') {
-            advance(c);
-            break;
+    size_t saved_pos = c->pos;
+    skip_braces(c);
+    size_t end = c->pos;
+    c->pos = saved_pos;
+    for (size_t p = saved_pos; p + 12 <= end; p++) {
+        if (strncmp(c->source + p, "syscall.exit", 12) == 0 && !is_ident_char(c->source[p - 1])) {
+            return true;
         }
-        compile_statement(c);
     }
+    return false;
 }
 
-// Skip block declarations
-void skip_block_decl(Compiler* c) {
-    while (c->pos < c->len && peek(c) != '{') advance(c);
-    if (peek(c) == '{') {
-        advance(c);
-        int depth = 1;
-        while (c->pos < c->len && depth > 0) {
-            char ch = peek(c);
-            if (ch == '{') depth++;
-            else if (ch == '}') depth--;
-            else if (ch == '"') {
+// Function whose body holds pos, or func_count for the main program
+int layout_caller(CodeGen* cg, size_t pos) {
+    for (int i = 0; i < cg->func_count; i++) {
+        if (pos >= cg->funcs[i].body_pos && pos < cg->funcs[i].body_end) return i;
+    }
+    return cg->func_count;
+}
+
+void layout_add_edge(CallEdge* edges, int* count, int a, int b, uint64_t weight) {
+    if (a == b || weight == 0) return;
+    if (a > b) { int t = a; a = b; b = t; }
+    for (int i = 0; i < *count; i++) {
+        if (edges[i].a == a && edges[i].b == b) { edges[i].weight += weight; return; }
+    }
+    if (*count < MAX_LAYOUT_EDGES) edges[(*count)++] = (CallEdge){ a, b, weight };
+}
+
+int layout_call_edges(Compiler* c, CallEdge* edges) {
+    CodeGen* cg = &c->codegen;
+    int count = 0;
+    int depth = 0;
+    uint32_t loop_mask = 0;  // Brace depths opened by a loop
+    bool loop_pending = false;
+    size_t saved_pos = c->pos;
+    
+    c->pos = 0;
+    while (c->pos < c->import_pos) {
+        char ch = peek(c);
+        if (ch == '#' || (ch == '/' && peek_n(c, 1) == '/')) {
+            skip_line(c);
+        } else if (ch == '"') {
+            advance(c);
+            while (c->pos < c->len && peek(c) != '"') {
+                if (peek(c) == '\\') advance(c);
                 advance(c);
-                while (c->pos < c->len && peek(c) != '"') {
-                    if (peek(c) == '\\') advance(c);
-                    advance(c);
+            }
+            advance(c);
+        } else if (ch == '{') {
+            if (loop_pending && depth < 32) loop_mask |= 1u << depth;
+            loop_pending = false;
+            depth++;
+            advance(c);
+        } else if (ch == '}') {
+            if (depth > 0) depth--;
+            if (depth < 32) loop_mask &= ~(1u << depth);
+            advance(c);
+        } else if (is_ident_start(ch) && (c->pos == 0 || !is_ident_char(c->source[c->pos - 1]))) {
+            size_t word = c->pos;
+            char* name = parse_ident(c);
+            if (strcmp(name, "loop") == 0) loop_pending = true;
+            bool def = word >= 3 && strncmp(c->source + word - 3, "fn ", 3) == 0;
+            skip_whitespace(c);
+            Function* fn = find_func(cg, name);
+            if (fn && !def && peek(c) == '(') {
+                uint64_t weight;
+                if (c->profile_count > 0) {
+                    int64_t n = profile_lookup(c, PROF_CALL, c->pos);
+                    weight = n > 0 ? (uint64_t)n : 0;
+                } else {
+                    int levels = __builtin_popcount(loop_mask);
+                    weight = 1ULL << (3 * (levels < 4 ? levels : 4));
                 }
-            } else if (ch == '#') {
-                while (c->pos < c->len && peek(c) != '\n') advance(c);
+                layout_add_edge(edges, &count, layout_caller(cg, word), fn - cg->funcs, weight);
             }
+            free(name);
+        } else {
             advance(c);
         }
     }
+    c->pos = saved_pos;
+    return count;
 }
 
-// Parse unified { i: v, e: v, r: v }
-void parse_unified_block(Compiler* c) {
-    skip_whitespace(c);
-    if (peek(c) != '{') { skip_line(c); return; }
-    advance(c);
+int layout_edge_cmp(const void* x, const void* y) {
+    const CallEdge* a = x;
+    const CallEdge* b = y;
+    if (a->weight != b->weight) return a->weight < b->weight ? 1 : -1;
+    if (a->a != b->a) return a->a - b->a;
+    return a->b - b->b;
+}
+
+// Fill order with the function indices in layout order
+void layout_function_order(Compiler* c, int* order) {
+    CodeGen* cg = &c->codegen;
+    int n = cg->func_count;
+    if (!c->passes[PASS_LAYOUT].on) {
+        for (int k = 0; k < n; k++) order[k] = k;
+        return;
+    }
+    uint64_t t = pass_begin(c);
+    CallEdge* edges = malloc(sizeof(CallEdge) * MAX_LAYOUT_EDGES);
+    int edge_count = layout_call_edges(c, edges);
+    qsort(edges, edge_count, sizeof(CallEdge), layout_edge_cmp);
+    
+    // Node n is main, whose chain always comes first
+    int* next = malloc(sizeof(int) * (n + 1));
+    int* head = malloc(sizeof(int) * (n + 1));
+    int* tail = malloc(sizeof(int) * (n + 1));
+    uint64_t* weight = calloc(n + 1, sizeof(uint64_t));
+    for (int i = 0; i <= n; i++) { next[i] = -1; head[i] = i; tail[i] = i; }
+    
+    for (int e = 0; e < edge_count; e++) {
+        int ha = head[edges[e].a], hb = head[edges[e].b];
+        if (ha == hb) continue;
+        if (hb == head[n]) { int t = ha; ha = hb; hb = t; }
+        next[tail[ha]] = hb;
+        tail[ha] = tail[hb];
+        weight[ha] += weight[hb] + edges[e].weight;
+        for (int k = hb; k >= 0; k = next[k]) head[k] = ha;
+    }
     
-    while (c->pos < c->len && peek(c) != '}') {
-        skip_whitespace(c);
-        if (peek(c) == '}') break;
-        
-        char* key = parse_ident(c);
-        skip_whitespace(c);
-        if (peek(c) == ':') advance(c);
-        skip_whitespace(c);
-        double val = (double)parse_number(c);
-        
-        if (strcmp(key, "i") == 0 || strcmp(key, "information_density") == 0) {
-            c->unified.i = val;
-        } else if (strcmp(key, "e") == 0 || strcmp(key, "entropy_gradient") == 0) {
-            c->unified.e = val;
-        } else if (strcmp(key, "r") == 0 || strcmp(key, "relation_strength") == 0) {
-            c->unified.r = val;
+    int count = 0;
+    for (int k = head[n]; k >= 0; k = next[k]) {
+        if (k != n) order[count++] = k;
+    }
+    // Remaining chains hottest first, uncalled functions in declaration order
+    while (count < n) {
+        int best = -1;
+        for (int i = 0; i < n; i++) {
+            if (head[i] != i || i == head[n]) continue;
+            if (best < 0 || weight[i] > weight[best]) best = i;
         }
-        
-        free(key);
+        for (int k = best; k >= 0; k = next[k]) order[count++] = k;
+        head[best] = -1;
+    }
+    pass_end(c, PASS_LAYOUT, t, edge_count > 0);
+    
+    free(edges);
+    free(next);
+    free(head);
+    free(tail);
+    free(weight);
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Register allocation - Linear scan over function locals
+// ═══════════════════════════════════════════════════════════════
+//
+// Parameters and locals of a function body get live intervals in source
+// order. A variable used inside a loop is live across the whole loop, so
+// its value survives the back edge. Intervals are then scanned by start:
+// each takes a free register from r12-r15, or under pressure the lighter
+// of it and the active intervals is spilled to its stack slot for the
+// whole function. Uses weigh 8 per enclosing loop, so loop counters win.
+//
+// Globals are promoted the same way inside a region (a function body, or a
+// top-level loop) that cannot touch global memory behind the compiler's
+// back: no calls that stay calls, no poke/copy/fill, no syscalls that
+// write memory. They are loaded on entry and written back on exit.
+
+typedef struct {
+    char name[64];
+    size_t start, end;
+    uint64_t weight;
+    int reg;
+    Variable* global;   // Promoted global
+    bool dirty;         // Assigned in the region
+} RegInterval;
+
+// Advance to the next identifier before end, skipping strings and comments
+bool scan_ident(Compiler* c, size_t end) {
+    while (c->pos < end) {
+        char ch = peek(c);
+        if (ch == '#' || (ch == '/' && peek_n(c, 1) == '/')) {
+            skip_line(c);
+        } else if (ch == '"') {
+            advance(c);
+            while (c->pos < c->len && peek(c) != '"') {
+                if (peek(c) == '\\') advance(c);
+                advance(c);
+            }
+            advance(c);
+        } else if (is_ident_start(ch) && !is_ident_char(c->source[c->pos - 1])) {
+            return true;
+        } else {
+            advance(c);
+        }
+    }
+    return false;
+}
+
+// [start, end) calls something: a function, builtin or syscall
+bool region_calls(Compiler* c, size_t start, size_t end) {
+    size_t saved_pos = c->pos;
+    bool calls = false;
+    c->pos = start;
+    while (!calls && scan_ident(c, end)) {
+        free(parse_ident(c));
         skip_whitespace(c);
-        if (peek(c) == ',') advance(c);
+        calls = peek(c) == '(';
     }
-    if (peek(c) == '}') advance(c);
+    c->pos = saved_pos;
+    return calls;
 }
 
-void compile_statement(Compiler* c) {
-    skip_whitespace(c);
-    if (c->pos >= c->len) return;
-    
-    // Comments
+// No statement in [start, end) can read or write global memory other than
+// through the variables themselves. An inlined callee only reads its
+// parameters, but anything it calls in turn may write a global
+bool region_alias_free(Compiler* c, size_t start, size_t end) {
+    size_t saved_pos = c->pos;
+    bool ok = true;
+    c->pos = start;
+    while (ok && scan_ident(c, end)) {
+        char* name = parse_ident(c);
+        skip_whitespace(c);
+        if (peek(c) == '(') {
+            Function* fn = find_func(&c->codegen, name);
+            int rt = rt_builtin(name);
+            if (fn) ok = fn_is_inlinable(c, fn) && !region_calls(c, fn->inline_pos, fn->body_end);
+            else if (strcmp(name, "poke") == 0 || rt == RT_COPY || rt == RT_FILL || rt == RT_TICK) ok = false;
+            else if (strncmp(name, "syscall.", 8) == 0) {
+                ok = strcmp(name, "syscall.exit") == 0 || strcmp(name, "syscall.write") == 0 ||
+                     strcmp(name, "syscall.open") == 0 || strcmp(name, "syscall.close") == 0 ||
+                     strcmp(name, "syscall.send") == 0 || strcmp(name, "syscall.socket") == 0 ||
+                     strcmp(name, "syscall.listen") == 0 || strcmp(name, "syscall.shutdown") == 0;
+            }
+        }
+        free(name);
+    }
+    c->pos = saved_pos;
+    return ok;
+}
+
+// Candidate index for name (params, then locals assigned in the body)
+int reg_candidate(RegInterval* iv, int count, const char* name) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(iv[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+RegInterval* reg_add_candidate(RegInterval* iv, int* count, const char* name, size_t start, size_t end) {
+    if (*count >= MAX_REG_VARS || strlen(name) > 63) return NULL;
+    RegInterval* r = &iv[(*count)++];
+    strcpy(r->name, name);
+    r->start = start;
+    r->end = end;
+    r->weight = 0;
+    r->reg = 0;
+    r->global = NULL;
+    r->dirty = false;
+    return r;
+}
+
+// Weigh the uses of the candidates in [start, end), extending their
+// intervals; with promote, globals used there become candidates spanning
+// [start, end)
+void reg_scan_uses(Compiler* c, size_t start, size_t end, RegInterval* iv, int* count,
+                   size_t (*loops)[2], int loop_count, bool promote) {
+    c->pos = start;
+    while (scan_ident(c, end)) {
+        size_t word = c->pos;
+        char* name = parse_ident(c);
+        size_t name_end = c->pos;
+        skip_whitespace(c);
+        bool assign = peek(c) == '=' && peek_n(c, 1) != '=';
+        if (peek(c) != '(') {
+            int k = reg_candidate(iv, *count, name);
+            Variable* g = k < 0 && promote ? find_var(&c->codegen, name) : NULL;
+            if (g && g->is_global && reg_add_candidate(iv, count, name, start, end)) {
+                k = *count - 1;
+                iv[k].global = g;
+            }
+            if (k >= 0) {
+                int depth = 0;
+                for (int l = 0; l < loop_count; l++) {
+                    depth += word >= loops[l][0] && word < loops[l][1];
+                }
+                iv[k].weight += 1ULL << (3 * (depth < 4 ? depth : 4));
+                iv[k].dirty |= assign;
+                if (word < iv[k].start) iv[k].start = word;
+                if (name_end > iv[k].end) iv[k].end = name_end;
+            }
+        }
+        free(name);
+    }
+}
+
+int reg_intervals(Compiler* c, Function* fn, RegInterval* iv) {
+    CodeGen* cg = &c->codegen;
+    int count = 0;
+    size_t loops[64][2];
+    int loop_count = 0;
+    size_t saved_pos = c->pos;
+    
+    for (int i = 0; i < fn->param_count; i++) {
+        reg_add_candidate(iv, &count, fn->params[i], fn->body_pos, fn->body_pos);
+    }
+    
+    // Loops and assigned locals first, then the uses
+    c->pos = fn->body_pos;
+    while (scan_ident(c, fn->body_end)) {
+        size_t word = c->pos;
+        char* name = parse_ident(c);
+        size_t name_end = c->pos;
+        skip_whitespace(c);
+        if (strcmp(name, "loop") == 0 && loop_count < 64) {
+            size_t loop_pos = c->pos;
+            skip_braces(c);
+            loops[loop_count][0] = word;
+            loops[loop_count][1] = c->pos;
+            loop_count++;
+            c->pos = loop_pos;
+        } else if (peek(c) == '=' && peek_n(c, 1) != '=' && reg_candidate(iv, count, name) < 0) {
+            Variable* g = find_var(cg, name);
+            if (!g || !g->is_global) reg_add_candidate(iv, &count, name, word, name_end);
+        }
+        free(name);
+    }
+    bool promote = c->passes[PASS_PROMOTE].on && !c->osr_entries &&
+                   region_alias_free(c, fn->body_pos, fn->body_end);
+    reg_scan_uses(c, fn->body_pos, fn->body_end, iv, &count, loops, loop_count, promote);
+    c->pos = saved_pos;
+    
+    // Loop-carried liveness: grow intervals over every loop they touch
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < count; i++) {
+            for (int l = 0; l < loop_count; l++) {
+                if (iv[i].start >= loops[l][1] || iv[i].end <= loops[l][0]) continue;
+                if (loops[l][0] < iv[i].start) { iv[i].start = loops[l][0]; changed = true; }
+                if (loops[l][1] > iv[i].end) { iv[i].end = loops[l][1]; changed = true; }
+            }
+        }
+    }
+    return count;
+}
+
+int reg_interval_cmp(const void* x, const void* y) {
+    const RegInterval* a = x;
+    const RegInterval* b = y;
+    if (a->start != b->start) return a->start < b->start ? -1 : 1;
+    return strcmp(a->name, b->name);
+}
+
+// Linear scan of count intervals into cg->reg_vars; returns the registers used
+uint32_t reg_linear_scan(Compiler* c, RegInterval* iv, int count) {
+    CodeGen* cg = &c->codegen;
+    qsort(iv, count, sizeof(RegInterval), reg_interval_cmp);
+    
+    // The tier maps frames by variable, so registers are not shared there
+    bool reuse = !c->capture_frame;
+    int active[REG_ALLOC_COUNT];
+    for (int r = 0; r < REG_ALLOC_COUNT; r++) active[r] = -1;
+    uint32_t mask = 0;
+    
+    for (int i = 0; i < count; i++) {
+        iv[i].reg = 0;
+        if (iv[i].weight == 0) continue;
+        int free_reg = -1, lightest = -1;
+        for (int r = 0; r < REG_ALLOC_COUNT; r++) {
+            if (active[r] >= 0 && reuse && iv[active[r]].end <= iv[i].start) active[r] = -1;
+            if (active[r] < 0 && !(!reuse && (mask & (1u << r)))) {
+                if (free_reg < 0) free_reg = r;
+            } else if (active[r] >= 0 && (lightest < 0 || iv[active[r]].weight < iv[active[lightest]].weight)) {
+                lightest = r;
+            }
+        }
+        int r = free_reg;
+        if (r < 0 && lightest >= 0 && iv[active[lightest]].weight < iv[i].weight) {
+            r = lightest;
+            iv[active[r]].reg = 0;  // Spilled: lives in its stack slot
+        }
+        if (r < 0) continue;
+        active[r] = i;
+        iv[i].reg = REG_ALLOC_FIRST + r;
+        mask |= 1u << r;
+    }
+    
+    cg->reg_var_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (!iv[i].reg) continue;
+        strcpy(cg->reg_vars[cg->reg_var_count].name, iv[i].name);
+        cg->reg_vars[cg->reg_var_count].reg = iv[i].reg;
+        cg->reg_vars[cg->reg_var_count].global = iv[i].global;
+        cg->reg_vars[cg->reg_var_count].dirty = iv[i].dirty;
+        cg->reg_var_count++;
+    }
+    return mask;
+}
+
+// Allocate fn's variables into cg->reg_vars; returns the registers used
+uint32_t reg_allocate(Compiler* c, Function* fn) {
+    if (!c->passes[PASS_REGALLOC].on) {
+        c->codegen.reg_var_count = 0;
+        return 0;
+    }
+    uint64_t t = pass_begin(c);
+    RegInterval iv[MAX_REG_VARS];
+    int count = reg_intervals(c, fn, iv);
+    uint32_t mask = reg_linear_scan(c, iv, count);
+    bool promoted = false;
+    for (int i = 0; i < c->codegen.reg_var_count; i++) promoted |= c->codegen.reg_vars[i].global != NULL;
+    pass_end(c, PASS_PROMOTE, pass_begin(c), promoted);  // Its time is regalloc's
+    pass_end(c, PASS_REGALLOC, t, mask != 0);
+    return mask;
+}
+
+// Promote the globals of a top-level loop (c->pos at its '{'); true when
+// some were loaded, to be written back after the loop
+bool promote_loop_globals(Compiler* c) {
+    CodeGen* cg = &c->codegen;
+    if (cg->in_function || cg->reg_var_count > 0 || c->osr_entries || !c->passes[PASS_PROMOTE].on) return false;
+    uint64_t t = pass_begin(c);
+    size_t saved_pos = c->pos;
+    skip_braces(c);
+    size_t start = saved_pos, end = c->pos;
+    c->pos = saved_pos;
+    if (!region_alias_free(c, start, end)) return pass_end(c, PASS_PROMOTE, t, false);
+    
+    // Globals first assigned in the loop are created now, so they can be
+    // promoted too
+    size_t loops[64][2];
+    int loop_count = 0;
+    while (scan_ident(c, end)) {
+        size_t word = c->pos;
+        char* name = parse_ident(c);
+        skip_whitespace(c);
+        if (strcmp(name, "loop") == 0 && loop_count < 64) {
+            size_t loop_pos = c->pos;
+            skip_braces(c);
+            loops[loop_count][0] = word;
+            loops[loop_count][1] = c->pos;
+            loop_count++;
+            c->pos = loop_pos;
+        } else if (peek(c) == '=' && peek_n(c, 1) != '=' && !find_var(cg, name)) {
+            add_var(cg, name, VAR_INT);
+        }
+        free(name);
+    }
+    
+    RegInterval iv[MAX_REG_VARS];
+    int count = 0;
+    reg_scan_uses(c, start, end, iv, &count, loops, loop_count, true);
+    c->pos = saved_pos;
+    // Whole-region intervals all overlap: the heaviest four win
+    for (int i = 0; i < count; i++) iv[i].start = start;
+    reg_linear_scan(c, iv, count);
+    gen_promote_globals(cg);
+    return pass_end(c, PASS_PROMOTE, t, cg->reg_var_count > 0);
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Memoization - Pure functions behind a direct-mapped table
+// ═══════════════════════════════════════════════════════════════
+
+// name is a global: defined already, or assigned by the main program
+// (outside every function body) further on
+bool var_is_global(Compiler* c, const char* name) {
+    for (int i = 0; i < c->codegen.var_count; i++) {
+        if (c->codegen.vars[i].is_global && strcmp(c->codegen.vars[i].name, name) == 0) return true;
+    }
+    size_t n = strlen(name);
+    for (size_t p = 0; p + n < c->import_pos; p++) {
+        if (strncmp(c->source + p, name, n) != 0) continue;
+        if ((p > 0 && is_ident_char(c->source[p - 1])) || is_ident_char(c->source[p + n])) continue;
+        size_t q = p + n;
+        while (q < c->import_pos && (c->source[q] == ' ' || c->source[q] == '\t')) q++;
+        if (c->source[q] != '=' || c->source[q + 1] == '=') continue;
+        bool in_body = false;
+        for (int i = 0; i < c->codegen.func_count && !in_body; i++) {
+            in_body = p >= c->codegen.funcs[i].body_pos && p < c->codegen.funcs[i].body_end;
+        }
+        if (!in_body) return true;
+    }
+    return false;
+}
+
+// Some statement in fn's body assigns name
+bool body_assigns(Compiler* c, Function* fn, const char* name) {
+    size_t n = strlen(name);
+    for (size_t p = fn->body_pos; p + n < fn->body_end; p++) {
+        if (strncmp(c->source + p, name, n) != 0) continue;
+        if (p > 0 && is_ident_char(c->source[p - 1])) continue;
+        size_t q = p + n;
+        while (q < fn->body_end && (c->source[q] == ' ' || c->source[q] == '\t')) q++;
+        if (c->source[q] == '=' && c->source[q + 1] != '=') return true;
+    }
+    return false;
+}
+
+// A pure function only computes on its arguments: every identifier in the
+// body is a control keyword, a parameter, a local it assigns (that is not a
+// global), or a call to a pure function. Strings mean output.
+bool fn_is_pure(Compiler* c, Function* fn) {
+    if (fn->pure_state != 0) return fn->pure_state > 0;
+    fn->pure_state = -1;  // Recursion through fn is decided by the rest of the body
+    if (fn->body_end <= fn->body_pos || fn->param_count > 16 ||
+        memchr(c->source + fn->body_pos, '"', fn->body_end - fn->body_pos)) return false;
+    
+    static const char* keywords[] = {"when", "otherwise", "loop", "break", "return"};
+    size_t saved_pos = c->pos;
+    bool ok = true;
+    c->pos = fn->body_pos;
+    while (ok && scan_ident(c, fn->body_end)) {
+        char* name = parse_ident(c);
+        skip_whitespace(c);
+        bool known = false;
+        for (int i = 0; i < 5 && !known; i++) known = strcmp(name, keywords[i]) == 0;
+        for (int i = 0; i < fn->param_count && !known; i++) known = strcmp(name, fn->params[i]) == 0;
+        if (known) {
+            // Control keyword or parameter
+        } else if (peek(c) == '(') {
+            Function* callee = find_func(&c->codegen, name);
+            ok = callee && (callee == fn || fn_is_pure(c, callee));
+        } else if (var_is_global(c, name)) {
+            ok = false;
+        } else {
+            // A local: must be assigned somewhere in the body
+            ok = body_assigns(c, fn, name);
+        }
+        free(name);
+    }
+    c->pos = saved_pos;
+    fn->pure_state = ok ? 1 : -1;
+    return ok;
+}
+
+// The body calls fn itself
+bool fn_is_recursive(Compiler* c, Function* fn) {
+    size_t n = strlen(fn->name);
+    for (size_t p = fn->body_pos; p + n < fn->body_end; p++) {
+        if (strncmp(c->source + p, fn->name, n) != 0) continue;
+        if (p > 0 && is_ident_char(c->source[p - 1])) continue;
+        size_t q = p + n;
+        while (q < fn->body_end && (c->source[q] == ' ' || c->source[q] == '\t')) q++;
+        if (c->source[q] == '(') return true;
+    }
+    return false;
+}
+
+// Declared memo, or high r and a pure recursive function
+bool fn_memoized(Compiler* c, Function* fn) {
+    if (fn->param_count > MEMO_MAX_ARGS) return false;
+    if (fn->memo) return true;
+    bool forced = c->pass_enable & (1u << PASS_MEMO);
+    return c->passes[PASS_MEMO].on && (forced || c->unified.r * 100 >= c->passes[PASS_MEMO].level) && fn->param_count > 0 &&
+           fn_is_recursive(c, fn) && fn_is_pure(c, fn);
+}
+
+// Table in the global area, reserved on first use
+uint64_t memo_table(CodeGen* cg, Function* fn) {
+    if (!fn->memo_table) {
+        fn->memo_table = cg->global_base + cg->global_data_pos;
+        cg->global_data_pos += (size_t)MEMO_SLOTS * (fn->param_count + 2) * 8;
+    }
+    return fn->memo_table;
+}
+
+// Entry stub at fn's label: probe the table, call the body at body_label on
+// a miss and fill the entry. An entry is {valid, args..., result}, indexed
+// by the mixed arguments.
+void gen_memo_wrapper(Compiler* c, Function* fn, const char* body_label) {
+    CodeGen* cg = &c->codegen;
+    int n = fn->param_count;
+    int entry = (n + 2) * 8;
+    uint64_t table = memo_table(cg, fn);
+    char miss_label[64];
+    snprintf(miss_label, sizeof(miss_label), "_memo_miss_%.48s", fn->name);
+    
+    gen_prologue(cg);
+    gen_sub_rsp(cg, 16);
+    emit_bytes(cg, (uint8_t[]){0x31, 0xc0}, 2);                      // xor eax, eax
+    for (int i = 0; i < n; i++) {
+        uint8_t arg = 16 + (n - 1 - i) * 8;
+        emit_bytes(cg, (uint8_t[]){0x48, 0x03, 0x45, arg}, 4);       // add rax, [rbp + arg]
+        gen_mul_rax_imm(cg, MEMO_HASH);
+    }
+    emit_bytes(cg, (uint8_t[]){0x48, 0xc1, 0xe8, 20}, 4);            // shr rax, 20
+    emit_byte(cg, 0x25);                                              // and eax, MEMO_SLOTS - 1
+    emit_u32(cg, MEMO_SLOTS - 1);
+    gen_mul_rax_imm(cg, entry);
+    emit_bytes(cg, (uint8_t[]){0x48, 0xbb}, 2);                      // movabs rbx, table
+    add_gref(cg, table);
+    emit_u64(cg, table);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x01, 0xc3}, 3);                // add rbx, rax
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x5d, 0xf8}, 4);          // mov [rbp - 8], rbx
+    emit_bytes(cg, (uint8_t[]){0x48, 0x83, 0x3b, 0x00}, 4);          // cmp qword [rbx], 0
+    gen_je(cg, miss_label);
+    for (int i = 0; i < n; i++) {
+        uint8_t arg = 16 + (n - 1 - i) * 8;
+        emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x45, arg}, 4);       // mov rax, [rbp + arg]
+        emit_bytes(cg, (uint8_t[]){0x48, 0x3b, 0x43, 8 + 8 * i}, 4); // cmp rax, [rbx + key]
+        gen_jne(cg, miss_label);
+    }
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x43, 8 + 8 * n}, 4);     // mov rax, [rbx + result]
+    gen_epilogue(cg);
+    
+    add_label(cg, miss_label);
+    for (int i = 0; i < n; i++) {
+        uint8_t arg = 16 + (n - 1 - i) * 8;
+        emit_bytes(cg, (uint8_t[]){0xff, 0x75, arg}, 3);             // push qword [rbp + arg]
+    }
+    gen_call(cg, body_label);
+    if (n > 0) gen_add_rsp(cg, n * 8);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x5d, 0xf8}, 4);          // mov rbx, [rbp - 8]
+    for (int i = 0; i < n; i++) {
+        uint8_t arg = 16 + (n - 1 - i) * 8;
+        emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x4d, arg}, 4);       // mov rcx, [rbp + arg]
+        emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x4b, 8 + 8 * i}, 4); // mov [rbx + key], rcx
+    }
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0x43, 8 + 8 * n}, 4);     // mov [rbx + result], rax
+    emit_bytes(cg, (uint8_t[]){0x48, 0xc7, 0x03, 1, 0, 0, 0}, 7);    // mov qword [rbx], 1
+    gen_epilogue(cg);
+    add_label(cg, body_label);
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Compile-time evaluation - Pure calls with constant arguments
+// ═══════════════════════════════════════════════════════════════
+
+// A call to a pure function whose arguments are constant is interpreted
+// over the function's source, with the same right-recursive grammar and
+// statement quirks as the code generator, and replaced by its result.
+// Anything the interpreter cannot decide exactly (an unset local, division
+// by zero, falling off the end, the step budget) abandons the fold and the
+// call is compiled as usual.
+
+enum { CT_NEXT, CT_BREAK, CT_RETURN, CT_FAIL };
+
+typedef struct {
+    Compiler* c;
+    long steps;
+    int depth;
+} CtEval;
+
+typedef struct {
+    struct { char name[64]; int64_t val; } vars[CT_MAX_LOCALS];
+    int count;
+    int loop_depth;
+} CtFrame;
+
+int64_t* ct_var(CtFrame* f, const char* name, bool create) {
+    for (int i = 0; i < f->count; i++) {
+        if (strcmp(f->vars[i].name, name) == 0) return &f->vars[i].val;
+    }
+    if (!create || f->count >= CT_MAX_LOCALS || strlen(name) > 63) return NULL;
+    strcpy(f->vars[f->count].name, name);
+    f->vars[f->count].val = 0;
+    return &f->vars[f->count++].val;
+}
+
+bool ct_expr(CtEval* e, CtFrame* f, int64_t* out);
+bool ct_call(CtEval* e, Function* fn, int64_t* args, int argc, int64_t* out);
+
+// Arguments after "name(", through the closing paren
+bool ct_args(CtEval* e, CtFrame* f, int64_t* args, int* argc) {
+    Compiler* c = e->c;
+    *argc = 0;
+    skip_whitespace(c);
+    while (peek(c) != ')' && c->pos < c->len && *argc < 16) {
+        if (!ct_expr(e, f, &args[(*argc)++])) return false;
+        skip_whitespace(c);
+        if (peek(c) == ',') advance(c);
+        skip_whitespace(c);
+    }
+    if (peek(c) != ')') return false;
+    advance(c);
+    return true;
+}
+
+bool ct_expr(CtEval* e, CtFrame* f, int64_t* out) {
+    Compiler* c = e->c;
+    if (--e->steps < 0) return false;
+    skip_whitespace(c);
+    
+    int64_t left;
+    if (isdigit(peek(c)) || (peek(c) == '-' && isdigit(peek_n(c, 1)))) {
+        left = parse_number(c);
+    } else if (is_ident_start(peek(c))) {
+        char* name = parse_ident(c);
+        skip_whitespace(c);
+        bool ok;
+        if (peek(c) == '(') {
+            advance(c);
+            int64_t args[16];
+            int argc;
+            // Calls only fold while ctfold is on, whoever evaluates
+            Function* fn = c->passes[PASS_CTFOLD].on ? find_func(&c->codegen, name) : NULL;
+            ok = fn && ct_args(e, f, args, &argc) && ct_call(e, fn, args, argc, &left);
+        } else {
+            // Call arguments (no frame) may name a specialized parameter, or
+            // a global main has so far only given an initial value
+            Variable* cv = f ? NULL : find_var(&c->codegen, name);
+            int64_t* v = f ? ct_var(f, name, false) : cv && cv->is_const ? &cv->int_val : NULL;
+            if (!v && cv && cv->is_global && c->static_init) v = global_init_at(&c->codegen, cv->global_addr);
+            ok = v != NULL;
+            if (ok) left = *v;
+        }
+        free(name);
+        if (!ok) return false;
+    } else if (peek(c) == '(') {
+        advance(c);
+        if (!ct_expr(e, f, &left)) return false;
+        skip_whitespace(c);
+        if (peek(c) == ')') advance(c);
+    } else {
+        return false;
+    }
+    
+    // Operators, right-recursive like compile_expr
+    skip_whitespace(c);
+    while (c->pos < c->len) {
+        int op = parse_binop(c);
+        if (op == BIN_NONE) break;
+        
+        int64_t right;
+        if (!ct_expr(e, f, &right)) return false;
+        uint64_t a = (uint64_t)left, b = (uint64_t)right;
+        switch (op) {
+            case BIN_ADD: left = (int64_t)(a + b); break;
+            case BIN_SUB: left = (int64_t)(a - b); break;
+            case BIN_MUL: left = (int64_t)(a * b); break;
+            case BIN_DIV:
+                if (right == 0 || (left == INT64_MIN && right == -1)) return false;
+                left = left / right;
+                break;
+            case BIN_GE: left = left >= right; break;
+            case BIN_LE: left = left <= right; break;
+            case BIN_EQ: left = left == right; break;
+            case BIN_NE: left = left != right; break;
+            case BIN_GT: left = left > right; break;
+            case BIN_LT: left = left < right; break;
+            case BIN_XOR: left = (int64_t)(a ^ b); break;
+            case BIN_AND: left = (int64_t)(a & b); break;
+            case BIN_OR: left = (int64_t)(a | b); break;
+        }
+    }
+    *out = left;
+    return true;
+}
+
+int ct_statement(CtEval* e, CtFrame* f, int64_t* ret);
+
+// { statements } like compile_block
+int ct_block(CtEval* e, CtFrame* f, int64_t* ret) {
+    Compiler* c = e->c;
+    skip_whitespace(c);
+    if (peek(c) == '{') advance(c);
+    while (c->pos < c->len) {
+        skip_whitespace(c);
+        if (peek(c) == '}') {
+            advance(c);
+            return CT_NEXT;
+        }
+        int r = ct_statement(e, f, ret);
+        if (r != CT_NEXT) return r;
+    }
+    return CT_FAIL;
+}
+
+// The statements a pure body can hold, matched as compile_statement does
+int ct_statement(CtEval* e, CtFrame* f, int64_t* ret) {
+    Compiler* c = e->c;
+    if (--e->steps < 0) return CT_FAIL;
+    skip_whitespace(c);
+    if (c->pos >= c->len) return CT_FAIL;
+    if (peek(c) == '#') { skip_line(c); return CT_NEXT; }
+    
+    if (match(c, "when ")) {
+        c->pos += 5;
+        int64_t cond;
+        if (!ct_expr(e, f, &cond)) return CT_FAIL;
+        skip_whitespace(c);
+        if (peek(c) != '{') return CT_NEXT;
+        if (!cond) {
+            skip_braces(c);
+            return CT_NEXT;
+        }
+        return ct_block(e, f, ret);
+    }
+    if (match(c, "loop")) {
+        c->pos += 4;
+        skip_whitespace(c);
+        if (peek(c) != '{') return CT_FAIL;  // Loops forever
+        size_t head = c->pos;
+        f->loop_depth++;
+        for (;;) {
+            c->pos = head;
+            int r = ct_block(e, f, ret);
+            if (r == CT_BREAK) break;
+            if (r != CT_NEXT || --e->steps < 0) return CT_FAIL;
+        }
+        f->loop_depth--;
+        c->pos = head;
+        skip_braces(c);
+        return CT_NEXT;
+    }
+    if (match(c, "break")) {
+        c->pos += 5;
+        return f->loop_depth > 0 ? CT_BREAK : CT_NEXT;
+    }
+    if (match(c, "return") || match(c, "-> ")) {
+        c->pos += match(c, "return") ? 6 : 3;
+        skip_whitespace(c);
+        bool value = c->pos < c->len && peek(c) != '\n' && peek(c) != '}';
+        if (value && !ct_expr(e, f, ret)) return CT_FAIL;
+        if (f->loop_depth > 0) return CT_BREAK;  // -> in a loop acts as break
+        return value ? CT_RETURN : CT_FAIL;
+    }
+    if (match(c, "otherwise")) {
+        c->pos += 9;
+        skip_whitespace(c);
+        return peek(c) == '{' ? ct_block(e, f, ret) : CT_NEXT;
+    }
+    if (!is_ident_start(peek(c))) return CT_FAIL;
+    
+    char* name = parse_ident(c);
+    skip_whitespace(c);
+    int r = CT_NEXT;
+    if (peek(c) == '=' && peek_n(c, 1) != '=') {
+        advance(c);
+        int64_t val;
+        int64_t* v = ct_var(f, name, true);
+        if (!v || !ct_expr(e, f, &val)) r = CT_FAIL;
+        else *v = val;
+    } else if (peek(c) == '(') {
+        advance(c);
+        int64_t args[16], val;
+        int argc;
+        Function* fn = find_func(&c->codegen, name);
+        if (!fn || !ct_args(e, f, args, &argc) || !ct_call(e, fn, args, argc, &val)) r = CT_FAIL;
+    } else {
+        skip_line(c);
+    }
+    free(name);
+    return r;
+}
+
+bool ct_call(CtEval* e, Function* fn, int64_t* args, int argc, int64_t* out) {
+    Compiler* c = e->c;
+    if (e->depth >= CT_MAX_DEPTH || argc != fn->param_count || argc > CT_MAX_LOCALS ||
+        !fn_is_pure(c, fn)) return false;
+    CtFrame* f = calloc(1, sizeof(CtFrame));
+    for (int i = 0; i < argc; i++) *ct_var(f, fn->params[i], true) = args[i];
+    
+    size_t saved_pos = c->pos;
+    c->pos = fn->body_pos;
+    e->depth++;
+    int r = CT_NEXT;
+    while (r == CT_NEXT && c->pos < fn->body_end) r = ct_statement(e, f, out);
+    e->depth--;
+    c->pos = saved_pos;
+    free(f);
+    return r == CT_RETURN;
+}
+
+// At the arguments of a call to fn: fold it when every argument is a
+// constant expression and fn returns within the budget
+bool ct_fold_call(Compiler* c, Function* fn, int64_t* value) {
+    if (!fn || fn->body_end <= fn->body_pos) return false;
+    size_t saved_pos = c->pos;
+    CtEval e = { c, c->passes[PASS_CTFOLD].level, 0 };
+    int64_t args[16];
+    int argc;
+    if (ct_args(&e, NULL, args, &argc) && ct_call(&e, fn, args, argc, value)) return true;
+    c->pos = saved_pos;
+    return false;
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Specialization - Clones for dominant argument values
+// ═══════════════════════════════════════════════════════════════
+//
+// With a profile from an instrumented run, a hot function whose parameter
+// nearly always had one value gets a clone compiled with that parameter as
+// a constant: it folds into multiplies and compile-time calls. The entry
+// checks the argument and jumps to the generic body when it differs.
+
+void compile_function_body(Compiler* c, Function* fn);
+
+// Parameters to specialize, into c->spec_mask and c->spec_values: at least
+// 3 calls in 4 passed the value, and the body never reassigns it
+bool spec_params(Compiler* c, Function* fn) {
+    c->spec_mask = 0;
+    if (!c->profile_count || c->codegen.prof_path || fn_memoized(c, fn)) return false;
+    int64_t calls = profile_lookup(c, PROF_ENTRY, fn->body_pos);
+    if (calls < SPEC_MIN_CALLS) return false;
+    for (int i = 0; i < fn->param_count; i++) {
+        int64_t votes = profile_lookup(c, PROF_ARG_VOTES, fn->param_pos[i]);
+        if (votes * 2 < calls || body_assigns(c, fn, fn->params[i])) continue;
+        c->spec_mask |= 1u << i;
+        c->spec_values[i] = profile_lookup(c, PROF_ARG_VALUE, fn->param_pos[i]);
+    }
+    return c->spec_mask != 0;
+}
+
+// At fn's label: guards, then the clone; the generic body follows
+void gen_spec_clone(Compiler* c, Function* fn) {
+    CodeGen* cg = &c->codegen;
+    char generic_label[64];
+    snprintf(generic_label, sizeof(generic_label), "_spec_generic_%.48s", fn->name);
+    
+    for (int i = 0; i < fn->param_count; i++) {
+        if (!((c->spec_mask >> i) & 1)) continue;
+        uint32_t arg = 8 + (fn->param_count - 1 - i) * 8;
+        emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x84, 0x24}, 4);  // mov rax, [rsp + arg]
+        emit_u32(cg, arg);
+        emit_bytes(cg, (uint8_t[]){0x48, 0xbb}, 2);              // movabs rbx, value
+        emit_u64(cg, (uint64_t)c->spec_values[i]);
+        emit_bytes(cg, (uint8_t[]){0x48, 0x39, 0xd8}, 3);        // cmp rax, rbx
+        gen_jne(cg, generic_label);
+    }
+    
+    gen_prologue(cg);
+    gen_sub_rsp(cg, 256);
+    cg->frame_size = 256;
+    compile_function_body(c, fn);
+    c->spec_mask = 0;
+    gen_add_rsp(cg, 256);
+    gen_pop_rbp(cg);
+    emit_byte(cg, 0xc3);
+    add_label(cg, generic_label);
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Limits - Runtime resource budgets
+// ═══════════════════════════════════════════════════════════════
+//
+// limit memory/cpu/fds become prlimit64 calls at the top of main, so a job
+// holds to its budget without a cgroup around it. Under a memory limit the
+// Tile pools hand out smaller chunks, and an alloc() whose chunk cannot be
+// mapped retries with just the bytes it needs before returning 0.
+
+// Record the first error with its line; the build then writes nothing
+void compile_error(Compiler* c, const char* fmt, ...) {
+    if (c->error[0]) return;
+    int line = 1;
+    for (size_t i = 0; i < c->pos && i < c->len; i++) line += c->source[i] == '\n';
+    int n = snprintf(c->error, sizeof(c->error), "Line %d: ", line);
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(c->error + n, sizeof(c->error) - n, fmt, ap);
+    va_end(ap);
+}
+
+// limit N sets Fate's collapse threshold to 1/N; limit memory 512M,
+// limit cpu 2s and limit fds 1024 set runtime budgets
+void parse_limit(Compiler* c) {
+    skip_whitespace(c);
+    if (!is_ident_start(peek(c))) {
+        int n = (int)parse_number(c);
+        c->fate.marginal_threshold = 1.0 / n;
+        return;
+    }
+    char* kind = parse_ident(c);
+    skip_whitespace(c);
+    double value = parse_real(c);
+    char* unit = parse_ident(c);
+    bool ok = true;
+    if (strcmp(kind, "memory") == 0) {
+        double scale = !*unit ? 1.0 : strcasecmp(unit, "K") == 0 ? 1024.0 :
+                       strcasecmp(unit, "M") == 0 ? 1048576.0 : strcasecmp(unit, "G") == 0 ? 1073741824.0 : 0.0;
+        ok = scale > 0.0;
+        c->limit_memory = (uint64_t)(value * scale);
+    } else if (strcmp(kind, "cpu") == 0) {
+        if (strcasecmp(unit, "ms") == 0) value /= 1000.0;
+        else if (strcasecmp(unit, "m") == 0) value *= 60.0;
+        else if (strcasecmp(unit, "h") == 0) value *= 3600.0;
+        else ok = !*unit || strcasecmp(unit, "s") == 0;
+        c->limit_cpu = (uint64_t)ceil(value);
+    } else if (strcmp(kind, "fds") == 0) {
+        ok = !*unit;
+        c->limit_fds = (uint64_t)value;
+    } else {
+        compile_error(c, "Unknown limit: %s", kind);
+    }
+    if (!ok) compile_error(c, "Unknown %s unit: %s", kind, unit);
+    free(unit);
+    free(kind);
+}
+
+// prlimit64(0, resource, &{soft, hard}, NULL)
+void gen_prlimit(CodeGen* cg, int resource, uint64_t soft, uint64_t hard) {
+    uint64_t rlim = cg->global_base + cg->global_data_pos;
+    cg->global_data_pos += 16;
+    gen_mov_rax_imm(cg, (int64_t)soft);
+    gen_mov_abs_rax(cg, rlim);
+    gen_mov_rax_imm(cg, (int64_t)hard);
+    gen_mov_abs_rax(cg, rlim + 8);
+    emit_bytes(cg, (uint8_t[]){0x31, 0xff}, 2);          // xor edi, edi
+    emit_byte(cg, 0xbe);                                  // mov esi, resource
+    emit_u32(cg, (uint32_t)resource);
+    emit_bytes(cg, (uint8_t[]){0x48, 0xba}, 2);          // movabs rdx, rlim
+    add_gref(cg, rlim);
+    emit_u64(cg, rlim);
+    emit_bytes(cg, (uint8_t[]){0x45, 0x31, 0xd2}, 3);    // xor r10d, r10d
+    gen_mov_rax_imm(cg, 302);                             // sys_prlimit64
+    gen_syscall(cg);
+}
+
+// The CPU limit is soft, then hard a second later: SIGXCPU, then SIGKILL
+void gen_limits(Compiler* c) {
+    CodeGen* cg = &c->codegen;
+    if (c->limit_memory) gen_prlimit(cg, RLIMIT_AS, c->limit_memory, c->limit_memory);
+    if (c->limit_cpu) gen_prlimit(cg, RLIMIT_CPU, c->limit_cpu, c->limit_cpu + 1);
+    if (c->limit_fds) gen_prlimit(cg, RLIMIT_NOFILE, c->limit_fds, c->limit_fds);
+}
+
+// The same budgets for the process running the tier; memory counts on
+// top of what the compiler itself has mapped
+void limits_apply(Compiler* c) {
+    if (c->limit_memory) {
+        unsigned long pages = 0;
+        FILE* f = fopen("/proc/self/statm", "r");
+        if (f) {
+            if (fscanf(f, "%lu", &pages) != 1) pages = 0;
+            fclose(f);
+        }
+        uint64_t as = c->limit_memory + (uint64_t)pages * sysconf(_SC_PAGESIZE);
+        setrlimit(RLIMIT_AS, &(struct rlimit){ as, as });
+    }
+    if (c->limit_cpu) setrlimit(RLIMIT_CPU, &(struct rlimit){ c->limit_cpu, c->limit_cpu + 1 });
+    if (c->limit_fds) setrlimit(RLIMIT_NOFILE, &(struct rlimit){ c->limit_fds, c->limit_fds });
+}
+
+// alloc() chunk size from the Tile pools, capped by a memory limit
+uint64_t limit_chunk(Compiler* c) {
+    uint64_t chunk = tile_chunk_size(&c->tile);
+    uint64_t cap = c->limit_memory / LIMIT_CHUNK_SHARE & ~0xfffULL;
+    if (c->limit_memory && chunk > cap) chunk = cap > 0x1000 ? cap : 0x1000;
+    return chunk;
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Statement compilation
+// ═══════════════════════════════════════════════════════════════
+
+// write(1, bytes, len) with the bytes inline, jumped over (rel32, so long
+// strings fit)
+void gen_write_literal(CodeGen* cg, const uint8_t* bytes, size_t len) {
+    emit_byte(cg, 0xe9);  // jmp near rel32
+    emit_i32(cg, len);    // Skip len bytes
+    
+    size_t data_pos = cg->code_pos;
+    emit_bytes(cg, bytes, len);
+    
+    gen_mov_rax_imm(cg, 1);
+    gen_mov_rdi_imm(cg, 1);
+    
+    int32_t rel = -(int32_t)(cg->code_pos - data_pos + 7);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x8d, 0x35}, 3);
+    emit_i32(cg, rel);
+    
+    gen_mov_rdx_imm(cg, len);
+    gen_syscall(cg);
+}
+
+typedef struct { uint8_t* bytes; size_t len, cap; } OutRun;
+
+bool is_out_statement(Compiler* c) {
+    return match(c, "out ") || match(c, "emit ") || match(c, "byte(") || match(c, "putchar(");
+}
+
+// Append the output statement at pos when everything it writes is known at
+// compile time: an out or emit string, or byte/putchar of a constant.
+// Otherwise false, pos unchanged
+bool out_run_add(Compiler* c, OutRun* r) {
+    size_t saved_pos = c->pos;
+    uint8_t one;
+    const uint8_t* bytes = NULL;
+    char* text = NULL;
+    size_t len = 0;
+    
+    if (match(c, "out ") || match(c, "emit ")) {
+        c->pos += match(c, "out ") ? 4 : 5;
+        skip_whitespace(c);
+        text = parse_string(c);
+        bytes = (uint8_t*)text;
+        len = strlen(text);
+    } else if (match(c, "byte(") || match(c, "putchar(")) {
+        c->pos += match(c, "byte(") ? 5 : 8;
+        CtEval e = { c, CT_EXPR_BUDGET, 0 };
+        int64_t value;
+        if (ct_expr(&e, NULL, &value) && peek(c) == ')') {
+            advance(c);
+            one = (uint8_t)value;
+            bytes = &one;
+            len = 1;
+        }
+    }
+    if (!bytes) {
+        c->pos = saved_pos;
+        return false;
+    }
+    
+    if (r->len + len > r->cap) {
+        r->cap = (r->len + len) * 2;
+        r->bytes = realloc(r->bytes, r->cap);
+    }
+    memcpy(r->bytes + r->len, bytes, len);
+    r->len += len;
+    free(text);
+    return true;
+}
+
+// Back-to-back constant output statements become one literal and one
+// write: nothing runs between them, so only the syscall count changes.
+// False when the statement at pos writes a runtime value
+bool compile_out(Compiler* c) {
+    uint64_t start = pass_begin(c);
+    OutRun r = { NULL, 0, 0 };
+    int statements = 0;
+    size_t end = c->pos;
+    while (out_run_add(c, &r)) {
+        statements++;
+        end = c->pos;
+        if (!c->passes[PASS_COALESCE].on) break;
+        skip_whitespace(c);
+    }
+    c->pos = end;
+    if (r.len) gen_write_literal(&c->codegen, r.bytes, r.len);
+    free(r.bytes);
+    pass_end(c, PASS_COALESCE, start, statements > 1);
+    return statements > 0;
+}
+
+void compile_fn_def(Compiler* c) {
+    size_t def_pos = c->pos - 3;
+    skip_whitespace(c);
+    char* name = parse_ident(c);
+    
+    // Already collected by the first pass: just skip the definition
+    Function* existing = find_func(&c->codegen, name);
+    if (existing && existing->def_pos == def_pos) {
+        skip_block_decl(c);
+        free(name);
+        return;
+    }
+    
+    if (c->codegen.func_count >= MAX_FUNCS) { free(name); return; }
+    
+    Function* fn = &c->codegen.funcs[c->codegen.func_count++];
+    strncpy(fn->name, name, MAX_IDENT - 1);
+    fn->code_offset = 0;
+    fn->code_end = 0;
+    fn->param_count = 0;
+    fn->def_pos = def_pos;
+    fn->body_pos = 0;
+    fn->body_end = 0;
+    fn->is_import = def_pos >= c->import_pos;
+    fn->inline_state = 0;
+    fn->inline_pos = 0;
+    fn->memo = def_pos >= 5 && strncmp(c->source + def_pos - 5, "memo ", 5) == 0;
+    fn->pure_state = 0;
+    fn->memo_table = 0;
+    
+    skip_whitespace(c);
+    while (c->pos < c->len && peek(c) != '{' && fn->param_count < 16) {
+        if (is_ident_start(peek(c))) {
+            fn->param_pos[fn->param_count] = c->pos;
+            char* param = parse_ident(c);
+            strncpy(fn->params[fn->param_count++], param, MAX_IDENT - 1);
+            free(param);
+        }
+        skip_whitespace(c);
+    }
+    // An explicit memo is not dropped silently: the table keys on at most
+    // MEMO_MAX_ARGS arguments
+    if (fn->memo && fn->param_count > MEMO_MAX_ARGS) {
+        compile_error(c, "memo fn %s: %d parameters, at most %d can be memoized",
+                      fn->name, fn->param_count, MEMO_MAX_ARGS);
+    }
+    
+    if (peek(c) == '{') {
+        advance(c);
+        fn->body_pos = c->pos;
+        int depth = 1;
+        while (c->pos < c->len && depth > 0) {
+            char ch = peek(c);
+            if (ch == '{') depth++;
+            else if (ch == '}') depth--;
+            else if (ch == '"') {
+                advance(c);
+                while (c->pos < c->len && peek(c) != '"') {
+                    if (peek(c) == '\\') advance(c);
+                    advance(c);
+                }
+            } else if (ch == '#') {
+                while (c->pos < c->len && peek(c) != '\n') advance(c);
+            }
+            advance(c);
+        }
+        fn->body_end = c->pos - 1;
+    }
+    
+    free(name);
+}
+
+// when cond { x = y } with y a variable or literal, condition in rax:
+// select with cmov rather than branch on a condition that may not predict
+bool when_if_convert(Compiler* c) {
+    CodeGen* cg = &c->codegen;
+    if (!c->passes[PASS_IFCONV].on || cg->prof_path || peek(c) != '{') return false;
+    uint64_t t = pass_begin(c);
+    size_t saved_pos = c->pos;
+    Variable* target = NULL;
+    Variable* src = NULL;
+    int64_t imm = 0;
+    bool ok = false;
+    advance(c);
+    skip_whitespace(c);
+    if (is_ident_start(peek(c))) {
+        char* name = parse_ident(c);
+        target = find_var(cg, name);
+        free(name);
+        skip_whitespace(c);
+    }
+    if (target && peek(c) == '=' && peek_n(c, 1) != '=') {
+        advance(c);
+        skip_whitespace(c);
+        if (isdigit(peek(c)) || (peek(c) == '-' && isdigit(peek_n(c, 1)))) {
+            imm = parse_number(c);
+            ok = !is_ident_char(peek(c));
+        } else if (is_ident_start(peek(c))) {
+            char* name = parse_ident(c);
+            src = find_var(cg, name);
+            free(name);
+            ok = src != NULL;
+        }
+        skip_whitespace(c);
+        ok = ok && peek(c) == '}';
+    }
+    if (!pass_end(c, PASS_IFCONV, t, ok)) {
+        c->pos = saved_pos;
+        return false;
+    }
+    advance(c);
+    
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xc2}, 3);        // mov rdx, rax
+    if (src) gen_load_var(cg, src);
+    else gen_mov_rax_imm(cg, imm);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x89, 0xc1}, 3);        // mov rcx, rax
+    gen_load_var(cg, target);
+    emit_bytes(cg, (uint8_t[]){0x48, 0x85, 0xd2}, 3);        // test rdx, rdx
+    emit_bytes(cg, (uint8_t[]){0x48, 0x0f, 0x45, 0xc1}, 4);  // cmovne rax, rcx
+    gen_store_var(cg, target);
+    return true;
+}
+
+void compile_when(Compiler* c) {
+    CodeGen* cg = &c->codegen;
+    int id = cg->when_id++;
+    char end_label[64];
+    sprintf(end_label, "_when_end_%d", id);
+    
+    skip_whitespace(c);
+    size_t site = c->pos;
+    gen_prof_count(cg, PROF_WHEN, site);
+    compile_expr(c);
+    
+    skip_whitespace(c);
+    if (when_if_convert(c)) return;
+    gen_test_rax_rax(cg);
+    if (peek(c) == '{' && cg->cold_count < MAX_COLD_BLOCKS && when_is_cold(c, site)) {
+        // Not taken falls through; the body runs in the cold region
+        char cold_label[64];
+        sprintf(cold_label, "_when_cold_%d", id);
+        gen_jne(cg, cold_label);
+        LayoutMark mark = layout_mark(cg);
+        add_label(cg, cold_label);
+        gen_prof_count(cg, PROF_TAKEN, site);
+        compile_block(c);
+        gen_jmp(cg, end_label);
+        layout_cut(cg, mark);
+    } else {
+        gen_je(cg, end_label);
+        if (peek(c) == '{') {
+            gen_prof_count(cg, PROF_TAKEN, site);
+            compile_block(c);
+        }
+    }
+    
+    add_label(cg, end_label);
+}
+
+// Code alignment from the unified field: high i favours compact code (no
+// padding), otherwise 16 bytes, or 32 when i leans towards speed
+int code_align(Compiler* c) {
+    return c->passes[PASS_ALIGN].on ? (int)c->passes[PASS_ALIGN].level : 0;
+}
+
+// Pad a loop head when the body is short enough to be a hot, tight loop;
+// the padding runs once, on entry
+void gen_loop_align(Compiler* c) {
+    size_t saved_pos = c->pos;
+    skip_braces(c);
+    size_t body_len = c->pos - saved_pos;
+    c->pos = saved_pos;
+    
+    int align = code_align(c);
+    if (body_len > ALIGN_LOOP_MAX_BODY) return;
+    uint64_t t = pass_begin(c);
+    pass_end(c, PASS_ALIGN, t, gen_align(&c->codegen, align, align / 2 + 2));
+}
+
+void compile_loop(Compiler* c) {
+    int id = c->codegen.loop_id++;
+    
+    char start_label[64], end_label[64];
+    sprintf(start_label, "_loop_start_%d", id);
+    sprintf(end_label, "_loop_end_%d", id);
+    
+    if (c->loop_depth < 16) {
+        strncpy(c->loop_labels[c->loop_depth][0], start_label, 63);
+        strncpy(c->loop_labels[c->loop_depth][1], end_label, 63);
+        c->loop_depth++;
+    }
+    
+    skip_whitespace(c);
+    bool promoted = peek(c) == '{' && promote_loop_globals(c);
+    if (peek(c) == '{') gen_loop_align(c);
+    add_label(&c->codegen, start_label);
+    
+    if (peek(c) == '{') {
+        gen_loop_prefetch(c);
+        compile_block(c);
+    }
+    
+    // Fate hook: insert observation in loop
+    if (c->fate_mode && c->fate.on) {
+        fate_tick(&c->fate, &c->tile);
+    }
+    
+    gen_jmp(&c->codegen, start_label);
+    add_label(&c->codegen, end_label);
+    if (promoted) {
+        gen_writeback_globals(&c->codegen);
+        reg_release(&c->codegen);
+    }
+    
+    if (c->loop_depth > 0) c->loop_depth--;
+}
+
+void compile_break(Compiler* c) {
+    if (c->loop_depth > 0) {
+        gen_jmp(&c->codegen, c->loop_labels[c->loop_depth - 1][1]);
+    }
+}
+
+void compile_return(Compiler* c) {
+    skip_whitespace(c);
+    if (c->pos < c->len && peek(c) != '\n' && peek(c) != '}') {
+        compile_expr(c);
+    }
+    
+    // If inside a loop, -> acts as break (jump to loop end)
+    // If outside loops (at function level), -> acts as return
+    if (c->loop_depth > 0) {
+        // Break out of innermost loop
+        gen_jmp(&c->codegen, c->loop_labels[c->loop_depth - 1][1]);
+    } else {
+        // Return from function
+        gen_writeback_globals(&c->codegen);
+        gen_restore_regs(&c->codegen);
+        gen_epilogue(&c->codegen);
+    }
+}
+
+// Before main has emitted any code, a global assigned a constant expression
+// can simply start with that value: it goes into the initialized global area
+// and no store runs at startup
+bool static_assign(Compiler* c, Variable* v) {
+    if (!c->static_init || !v->is_global || !c->passes[PASS_STATIC].on) return false;
+    uint64_t start = pass_begin(c);
+    size_t saved_pos = c->pos;
+    CtEval e = { c, CT_EXPR_BUDGET, 0 };
+    int64_t value;
+    bool ok = ct_expr(&e, NULL, &value);
+    // ct_expr skips trailing blanks and // comments; the expression must
+    // have ended its line (a skipped comment ends with its own newline), or
+    // stop at a # comment
+    size_t end = c->pos;
+    while (end > saved_pos && (c->source[end - 1] == ' ' || c->source[end - 1] == '\t' || c->source[end - 1] == '\r')) end--;
+    ok = ok && (c->pos >= c->len || peek(c) == '#' || (end > saved_pos && c->source[end - 1] == '\n'));
+    if (ok) global_init_set(&c->codegen, v->global_addr, value);
+    else c->pos = saved_pos;
+    return pass_end(c, PASS_STATIC, start, ok);
+}
+
+void compile_assign(Compiler* c, const char* name) {
+    skip_whitespace(c);
+    
+    Variable* v = find_var(&c->codegen, name);
+    if (!v) v = add_var(&c->codegen, name, VAR_INT);
+    if (v && static_assign(c, v)) return;
+    c->static_init = false;  // Calls below may change globals before a fold reads them
+    
+    if (v) {
+        compile_expr(c);
+        gen_store_var(&c->codegen, v);
+    }
+}
+
+void compile_block(Compiler* c) {
+    skip_whitespace(c);
+    if (peek(c) == '{') advance(c);
+    
+    bool static_init = c->static_init;
+    c->static_init = false;  // A block body may run never or many times
+    while (c->pos < c->len) {
+        skip_whitespace(c);
+        if (peek(c) == '}') {
+            advance(c);
+            break;
+        }
+        compile_statement(c);
+    }
+    c->static_init = static_init;
+}
+
+// Skip block declarations
+void skip_block_decl(Compiler* c) {
+    while (c->pos < c->len && peek(c) != '{') advance(c);
+    if (peek(c) == '{') {
+        advance(c);
+        int depth = 1;
+        while (c->pos < c->len && depth > 0) {
+            char ch = peek(c);
+            if (ch == '{') depth++;
+            else if (ch == '}') depth--;
+            else if (ch == '"') {
+                advance(c);
+                while (c->pos < c->len && peek(c) != '"') {
+                    if (peek(c) == '\\') advance(c);
+                    advance(c);
+                }
+            } else if (ch == '#') {
+                while (c->pos < c->len && peek(c) != '\n') advance(c);
+            }
+            advance(c);
+        }
+    }
+}
+
+// pool Name { size: N } - resize a tile pool or add one
+void compile_pool_decl(Compiler* c) {
+    skip_whitespace(c);
+    char* name = parse_ident(c);
+    size_t size = 0;
+    
+    skip_whitespace(c);
+    if (peek(c) == '{') {
+        advance(c);
+        while (c->pos < c->len) {
+            skip_whitespace(c);
+            if (peek(c) == '}') { advance(c); break; }
+            if (match(c, "size:")) {
+                c->pos += 5;
+                skip_whitespace(c);
+                size = (size_t)parse_number(c);
+            }
+            else if (peek(c) == '"') free(parse_string(c));
+            else advance(c);
+        }
+    }
+    
+    if (size > 0) {
+        int idx = -1;
+        for (int i = 0; i < c->tile.pool_count; i++) {
+            if (strcasecmp(c->tile.pools[i].purpose, name) == 0) idx = i;
+        }
+        if (idx >= 0) c->tile.pools[idx].size = size;
+        else tile_add_pool(&c->tile, 0, size, name);
+    }
+    free(name);
+}
+
+// Parse unified { i: v, e: v, r: v }
+void parse_unified_block(Compiler* c) {
+    skip_whitespace(c);
+    if (peek(c) != '{') { skip_line(c); return; }
+    advance(c);
+    
+    while (c->pos < c->len && peek(c) != '}') {
+        skip_whitespace(c);
+        if (peek(c) == '}') break;
+        
+        char* key = parse_ident(c);
+        skip_whitespace(c);
+        if (peek(c) == ':') advance(c);
+        skip_whitespace(c);
+        double val = parse_real(c);
+        
+        if (c->unified_pinned) {
+            // Tuned by --autotune: the Fate store's field wins
+        } else if (strcmp(key, "i") == 0 || strcmp(key, "information_density") == 0) {
+            c->unified.i = val;
+        } else if (strcmp(key, "e") == 0 || strcmp(key, "entropy_gradient") == 0) {
+            c->unified.e = val;
+        } else if (strcmp(key, "r") == 0 || strcmp(key, "relation_strength") == 0) {
+            c->unified.r = val;
+        }
+        
+        free(key);
+        skip_whitespace(c);
+        if (peek(c) == ',') advance(c);
+    }
+    if (peek(c) == '}') advance(c);
+    passes_configure(c);
+}
+
+void compile_statement(Compiler* c) {
+    skip_whitespace(c);
+    if (c->pos >= c->len) return;
+    
+    // Comments
     if (peek(c) == '#') { skip_line(c); return; }
     
-    // out
-    if (match(c, "out ")) { c->pos += 4; compile_out(c); return; }
+    // Only an assignment can be an initial value; anything else may run code
+    if (!cse_is_assign(c)) c->static_init = false;
+    
+    // Anything but these may store to memory behind the cached peeks
+    if (!match(c, "out ") && !match(c, "emit ") && !match(c, "poke(") && !match(c, "when ") &&
+        !match(c, "return") && !cse_is_assign(c)) {
+        cse_kill_peek(&c->codegen);
+    }
+    
+    // out, emit, and byte/putchar of a constant
+    if (is_out_statement(c) && compile_out(c)) return;
+    
+    // fn
+    if (match(c, "fn ")) { c->pos += 3; compile_fn_def(c); return; }
+    if (match(c, "memo fn ")) { c->pos += 8; compile_fn_def(c); return; }
+    
+    // when
+    if (match(c, "when ")) { c->pos += 5; compile_when(c); return; }
+    
+    // loop
+    if (match(c, "loop")) { c->pos += 4; skip_whitespace(c); compile_loop(c); return; }
+    
+    // break
+    if (match(c, "break")) { c->pos += 5; compile_break(c); return; }
+    
+    // return / ->
+    if (match(c, "return")) { c->pos += 6; compile_return(c); return; }
+    if (match(c, "-> ")) { c->pos += 3; compile_return(c); return; }
+    
+    // keep
+    if (match(c, "keep")) {
+        c->pos += 4;
+        if (c->codegen.rt_request & RT_TIMER_MASK) gen_timer_loop(&c->codegen);
+        else gen_event_loop(&c->codegen);
+        return;
+    }
+    
+    // fate on/off
+    if (match(c, "fate on")) { c->pos += 7; c->fate_mode = true; c->fate.on = true; return; }
+    if (match(c, "fate off")) { c->pos += 8; c->fate_mode = false; c->fate.on = false; return; }
+    
+    // limit
+    if (match(c, "limit ")) {
+        c->pos += 6;
+        parse_limit(c);
+        return;
+    }
+    
+    // syscall.exit
+    if (match(c, "syscall.exit(")) {
+        c->pos += 13;
+        skip_whitespace(c);
+        // Check if it's a simple number or an expression
+        char ch = peek(c);
+        if ((ch >= '0' && ch <= '9') || ch == '-') {
+            // Simple number - use optimized path
+            int code = (int)parse_number(c);
+            while (peek(c) != ')' && c->pos < c->len) advance(c);
+            if (peek(c) == ')') advance(c);
+            gen_exit(&c->codegen, code);
+        } else {
+            // Expression - compile it to rax
+            compile_expr(c);
+            skip_whitespace(c);
+            if (peek(c) == ')') advance(c);
+            gen_exit_rax(&c->codegen);
+        }
+        return;
+    }
+    
+    // syscall.write(fd, buf, count)
+    if (match(c, "syscall.write(")) {
+        c->pos += 14;
+        compile_expr(c); gen_push_rax(&c->codegen);
+        skip_whitespace(c); if (peek(c) == ',') advance(c);
+        compile_expr(c); gen_push_rax(&c->codegen);
+        skip_whitespace(c); if (peek(c) == ',') advance(c);
+        compile_expr(c); gen_mov_rdx_rax(&c->codegen);
+        gen_pop_rax(&c->codegen); gen_mov_rsi_rax(&c->codegen);
+        gen_pop_rax(&c->codegen); gen_mov_rdi_rax(&c->codegen);
+        gen_mov_rax_imm(&c->codegen, 1);
+        gen_syscall(&c->codegen);
+        skip_whitespace(c); if (peek(c) == ')') advance(c);
+        return;
+    }
+    
+    // syscall.read(fd, buf, count)
+    if (match(c, "syscall.read(")) {
+        c->pos += 13;
+        compile_expr(c); gen_push_rax(&c->codegen);
+        skip_whitespace(c); if (peek(c) == ',') advance(c);
+        compile_expr(c); gen_push_rax(&c->codegen);
+        skip_whitespace(c); if (peek(c) == ',') advance(c);
+        compile_expr(c); gen_mov_rdx_rax(&c->codegen);
+        gen_pop_rax(&c->codegen); gen_mov_rsi_rax(&c->codegen);
+        gen_pop_rax(&c->codegen); gen_mov_rdi_rax(&c->codegen);
+        gen_mov_rax_imm(&c->codegen, 0);
+        gen_syscall(&c->codegen);
+        skip_whitespace(c); if (peek(c) == ')') advance(c);
+        return;
+    }
+    
+    // syscall.open(path, flags, mode)
+    if (match(c, "syscall.open(")) {
+        c->pos += 13;
+        compile_expr(c); gen_push_rax(&c->codegen);
+        skip_whitespace(c); if (peek(c) == ',') advance(c);
+        compile_expr(c); gen_push_rax(&c->codegen);
+        skip_whitespace(c); if (peek(c) == ',') advance(c);
+        compile_expr(c); gen_mov_rdx_rax(&c->codegen);
+        gen_pop_rax(&c->codegen); gen_mov_rsi_rax(&c->codegen);
+        gen_pop_rax(&c->codegen); gen_mov_rdi_rax(&c->codegen);
+        gen_mov_rax_imm(&c->codegen, 2);
+        gen_syscall(&c->codegen);
+        skip_whitespace(c); if (peek(c) == ')') advance(c);
+        return;
+    }
+    
+    // syscall.close(fd)
+    if (match(c, "syscall.close(")) {
+        c->pos += 14;
+        compile_expr(c); gen_mov_rdi_rax(&c->codegen);
+        gen_mov_rax_imm(&c->codegen, 3);
+        gen_syscall(&c->codegen);
+        skip_whitespace(c); if (peek(c) == ')') advance(c);
+        return;
+    }
+    
+    // syscall.mmap(addr, len, prot, flags, fd, offset)
+    if (match(c, "syscall.mmap(")) {
+        c->pos += 13;
+        compile_expr(c); gen_push_rax(&c->codegen);
+        skip_whitespace(c); if (peek(c) == ',') advance(c);
+        compile_expr(c); gen_push_rax(&c->codegen);
+        skip_whitespace(c); if (peek(c) == ',') advance(c);
+        compile_expr(c); gen_push_rax(&c->codegen);
+        skip_whitespace(c); if (peek(c) == ',') advance(c);
+        compile_expr(c); gen_push_rax(&c->codegen);
+        skip_whitespace(c); if (peek(c) == ',') advance(c);
+        compile_expr(c); gen_push_rax(&c->codegen);
+        skip_whitespace(c); if (peek(c) == ',') advance(c);
+        compile_expr(c);
+        emit_bytes(&c->codegen, (uint8_t[]){0x49, 0x89, 0xc1}, 3);  // mov r9, rax
+        emit_bytes(&c->codegen, (uint8_t[]){0x41, 0x58}, 2);  // pop r8
+        emit_bytes(&c->codegen, (uint8_t[]){0x41, 0x5a}, 2);  // pop r10
+        gen_pop_rax(&c->codegen); gen_mov_rdx_rax(&c->codegen);
+        gen_pop_rax(&c->codegen); gen_mov_rsi_rax(&c->codegen);
+        gen_pop_rax(&c->codegen); gen_mov_rdi_rax(&c->codegen);
+        gen_mov_rax_imm(&c->codegen, 9);
+        gen_syscall(&c->codegen);
+        skip_whitespace(c); if (peek(c) == ')') advance(c);
+        return;
+    }
+    
+    // syscall.socket(...), syscall.epoll_wait(...) and the rest of the table
+    if (match(c, "syscall.")) {
+        size_t saved_pos = c->pos;
+        c->pos += 8;
+        char* name = parse_ident(c);
+        const SyscallDef* d = peek(c) == '(' ? syscall_def(name) : NULL;
+        free(name);
+        if (d) {
+            advance(c);
+            compile_syscall_def(c, d);
+            skip_whitespace(c); if (peek(c) == ')') advance(c);
+            return;
+        }
+        c->pos = saved_pos;
+    }
+    
+    // poke(addr, val) as statement
+    if (match(c, "poke(")) {
+        c->pos += 5;
+        compile_poke(c);
+        return;
+    }
+    
+    // peek(addr) as statement (result discarded)
+    if (match(c, "peek(")) {
+        c->pos += 5;
+        compile_expr(c);  // addr
+        emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x0f, 0xb6, 0x00}, 4);  // movzx rax, byte [rax]
+        skip_whitespace(c);
+        if (peek(c) == ')') advance(c);
+        return;
+    }
+    
+    // getchar() / putchar() / byte() as statements
+    if (match(c, "getchar()")) {
+        c->pos += 9;
+        gen_sub_rsp(&c->codegen, 16);
+        gen_mov_rax_imm(&c->codegen, 0);
+        gen_mov_rdi_imm(&c->codegen, 0);
+        emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x8d, 0x34, 0x24}, 4);
+        gen_mov_rdx_imm(&c->codegen, 1);
+        gen_syscall(&c->codegen);
+        emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x0f, 0xb6, 0x04, 0x24}, 5);
+        gen_add_rsp(&c->codegen, 16);
+        return;
+    }
+    
+    if (match(c, "putchar(")) {
+        c->pos += 8;
+        compile_expr(c);
+        skip_whitespace(c);
+        if (peek(c) == ')') advance(c);
+        gen_sub_rsp(&c->codegen, 16);
+        emit_bytes(&c->codegen, (uint8_t[]){0x88, 0x04, 0x24}, 3);
+        gen_mov_rax_imm(&c->codegen, 1);
+        gen_mov_rdi_imm(&c->codegen, 1);
+        emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x8d, 0x34, 0x24}, 4);
+        gen_mov_rdx_imm(&c->codegen, 1);
+        gen_syscall(&c->codegen);
+        gen_add_rsp(&c->codegen, 16);
+        return;
+    }
+    
+    if (match(c, "byte(")) {
+        c->pos += 5;
+        compile_expr(c);
+        skip_whitespace(c);
+        if (peek(c) == ')') advance(c);
+        gen_sub_rsp(&c->codegen, 16);
+        emit_bytes(&c->codegen, (uint8_t[]){0x88, 0x04, 0x24}, 3);
+        gen_mov_rax_imm(&c->codegen, 1);
+        gen_mov_rdi_imm(&c->codegen, 1);
+        emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x8d, 0x34, 0x24}, 4);
+        gen_mov_rdx_imm(&c->codegen, 1);
+        gen_syscall(&c->codegen);
+        gen_add_rsp(&c->codegen, 16);
+        return;
+    }
+    
+    // unified { } - parse and set Unified Field parameters
+    if (match(c, "unified ")) {
+        c->pos += 8;
+        parse_unified_block(c);
+        return;
+    }
+    if (match(c, "unified{")) {
+        c->pos += 7;
+        parse_unified_block(c);
+        return;
+    }
+    
+    // ═══════════════════════════════════════════════════════════════
+    // Minimal universal compatibility commands (Fate adaptive)
+    // ═══════════════════════════════════════════════════════════════
+    
+    // platform.probe - Fate probes platform
+    if (match(c, "platform.probe")) {
+        c->pos += 14;
+        // Fate probes at runtime, just record here
+        return;
+    }
+    
+    // bridge.read - Read bridge environment
+    if (match(c, "bridge.read")) {
+        c->pos += 11;
+        // Read from standard addresses at runtime
+        return;
+    }
+    
+    // compat.probe - Fate probes available devices
+    if (match(c, "compat.probe")) {
+        c->pos += 12;
+        // Fate probes at runtime
+        return;
+    }
+    
+    if (match(c, "pool ")) { c->pos += 5; compile_pool_decl(c); return; }
+    
+    // Other block declarations (skip)
+    if (match(c, "fate {") ||
+        match(c, "task {") || match(c, "gpu {") || match(c, "perf {") ||
+        match(c, "reg {") || match(c, "sys {") || match(c, "compiler {") ||
+        match(c, "collapse {") || match(c, "lib {") || match(c, "env {") ||
+        match(c, "rule ") || match(c, "intent ") || match(c, "platform {") ||
+        match(c, "tile {") || match(c, "codegen {") || match(c, "graphics {") ||
+        match(c, "gui {") || match(c, "style {") || match(c, "layout {") ||
+        match(c, "event {") || match(c, "db {") || match(c, "core {") ||
+        match(c, "kernel {") || match(c, "linux {") || match(c, "macos {") ||
+        match(c, "windows {") || match(c, "driver {") || match(c, "observe {") ||
+        match(c, "field {") || match(c, "use ")) {
+        skip_block_decl(c);
+        return;
+    }
+    
+    // otherwise
+    if (match(c, "otherwise")) {
+        c->pos += 9;
+        skip_whitespace(c);
+        if (peek(c) == '{') compile_block(c);
+        return;
+    }
+    
+    // Variable assignment or function call
+    if (is_ident_start(peek(c))) {
+        char* name = parse_ident(c);
+        skip_whitespace(c);
+        
+        if (peek(c) == '=' && peek_n(c, 1) != '=') {
+            advance(c);
+            compile_assign(c, name);
+        } else if (peek(c) == '(') {
+            advance(c);
+            skip_whitespace(c);
+            compile_call(c, name);
+        } else {
+            skip_line(c);
+        }
+        free(name);
+        return;
+    }
+    
+    skip_line(c);
+}
+
+void compile_function_body(Compiler* c, Function* fn) {
+    int saved_var_count = c->codegen.var_count;
+    int saved_stack_size = c->codegen.stack_size;
+    bool saved_in_function = c->codegen.in_function;
+    c->codegen.in_function = true;  // Mark we're inside a function
+    c->current_func = fn;
+    
+    c->codegen.saved_regs = reg_allocate(c, fn);
+    gen_save_regs(&c->codegen, c->codegen.saved_regs);
+    gen_promote_globals(&c->codegen);
+    gen_prof_count(&c->codegen, PROF_ENTRY, fn->body_pos);
+    for (int i = 0; i < fn->param_count; i++) {
+        gen_prof_value(&c->codegen, fn->param_pos[i], 16 + (fn->param_count - 1 - i) * 8);
+    }
+    
+    for (int i = 0; i < fn->param_count; i++) {
+        Variable* v = &c->codegen.vars[c->codegen.var_count++];
+        strncpy(v->name, fn->params[i], MAX_IDENT - 1);
+        v->type = VAR_INT;
+        v->is_const = (c->spec_mask >> i) & 1;
+        v->int_val = v->is_const ? c->spec_values[i] : 0;
+        v->is_param = true;
+        v->is_global = false;  // Parameters are never global
+        v->global_addr = 0;
+        v->stack_offset = 16 + (fn->param_count - 1 - i) * 8;
+        v->reg = v->is_const ? 0 : reg_lookup(&c->codegen, v->name);
+        if (v->reg) {
+            gen_mov_rax_rbp_off(&c->codegen, v->stack_offset);
+            gen_mov_reg_rax(&c->codegen, v->reg);
+        }
+    }
+    
+    size_t saved_pos = c->pos;
+    c->pos = fn->body_pos;
+    while (c->pos < fn->body_end) {
+        compile_statement(c);
+    }
+    c->pos = saved_pos;
+    gen_writeback_globals(&c->codegen);
+    gen_pop_regs(&c->codegen, c->codegen.saved_regs);
+    c->codegen.saved_regs = 0;
+    reg_release(&c->codegen);
+    
+    if (c->capture_frame) {
+        c->captured_count = c->codegen.var_count - saved_var_count;
+        c->captured_vars = malloc(sizeof(Variable) * (c->captured_count + 1));
+        memcpy(c->captured_vars, &c->codegen.vars[saved_var_count],
+               sizeof(Variable) * c->captured_count);
+    }
+    
+    c->codegen.var_count = saved_var_count;
+    c->codegen.stack_size = saved_stack_size;
+    c->codegen.in_function = saved_in_function;  // Restore in_function flag
+    c->current_func = NULL;
+}
+
+void compile_init_rules(Compiler* c) {
+    // Initialize rule systems
+    if (!c->unified_pinned) unified_init(&c->unified);
+    tile_init(&c->tile, &c->unified);
+    fate_init(&c->fate);
+    
+    // Add default four memory pools
+    tile_add_pool(&c->tile, 0x10000, 0x10000, "blackhole");
+    tile_add_pool(&c->tile, 0x20000, 0x10000, "meshbrain");
+    tile_add_pool(&c->tile, 0x30000, 0x10000, "multinova");
+    tile_add_pool(&c->tile, 0x40000, 0x10000, "baseforce");
+}
+
+void compile(Compiler* c) {
+    gen_prologue(&c->codegen);
+    gen_sub_rsp(&c->codegen, 512);
+    c->codegen.frame_size = 512;
+    if (c->codegen.object_mode) c->codegen.text_bias = 0;  // The linker keeps alignment
+    gen_cpu_init_slot(&c->codegen);
+    compile_init_rules(c);
+    
+    // First pass: collect function definitions
+    size_t saved_pos = c->pos;
+    while (c->pos < c->len) {
+        skip_whitespace(c);
+        if (match(c, "fn ")) {
+            c->pos += 3;
+            compile_fn_def(c);
+        } else if (match(c, "memo fn ")) {
+            c->pos += 8;
+            compile_fn_def(c);
+        } else if (match(c, "unified ") || match(c, "unified{")) {
+            c->pos += 7;  // Presets hold for the whole module
+            parse_unified_block(c);
+        } else if (match(c, "limit ")) {
+            c->pos += 6;  // Budgets hold from startup
+            parse_limit(c);
+        } else {
+            skip_line(c);
+        }
+    }
+    c->pos = saved_pos;
+    gen_limits(c);
+    
+    // Second pass: compile main program code (imported IR is not executable)
+    c->static_init = !c->codegen.raw_mode;  // A raw image has no global area to fill
+    while (c->pos < c->import_pos) {
+        size_t start = c->codegen.code_pos;
+        bool static_init = c->static_init;
+        compile_statement(c);
+        // Statements that emit nothing (fn, declarations) leave it as it was
+        c->static_init = static_init && c->codegen.code_pos == start;
+    }
+    c->static_init = false;
+    
+    // A module initializer returns to the link stub instead of exiting
+    if (c->codegen.object_mode) gen_epilogue(&c->codegen);
+    else gen_exit(&c->codegen, 0);
+    c->codegen.main_end = c->codegen.code_pos;
+    
+    // Third pass: generate function bodies in call affinity order
+    int* order = malloc(sizeof(int) * (c->codegen.func_count + 1));
+    layout_function_order(c, order);
+    for (int k = 0; k < c->codegen.func_count; k++) {
+        Function* fn = &c->codegen.funcs[order[k]];
+        if (fn->is_import) continue;
+        if (fn->body_pos > 0 && fn->body_end > fn->body_pos) {
+            uint64_t ta = pass_begin(c);
+            pass_end(c, PASS_ALIGN, ta, gen_align(&c->codegen, code_align(c), ALIGN_MAX));
+            fn->code_offset = c->codegen.code_pos;
+            add_label(&c->codegen, fn->name);
+            uint64_t t = pass_begin(c);
+            if (pass_end(c, PASS_MEMO, t, fn_memoized(c, fn))) {
+                char body_label[64];
+                snprintf(body_label, sizeof(body_label), "_memo_body_%.48s", fn->name);
+                gen_memo_wrapper(c, fn, body_label);
+            }
+            if (spec_params(c, fn)) gen_spec_clone(c, fn);
+            
+            gen_prologue(&c->codegen);
+            gen_sub_rsp(&c->codegen, 256);
+            c->codegen.frame_size = 256;
+            
+            compile_function_body(c, fn);
+            
+            gen_add_rsp(&c->codegen, 256);
+            gen_pop_rbp(&c->codegen);
+            emit_byte(&c->codegen, 0xc3);
+            fn->code_end = c->codegen.code_pos;
+        }
+    }
+    free(order);
+    
+    gen_cold_text(&c->codegen);
+    c->codegen.pool_chunk = limit_chunk(c);
+    gen_runtime(&c->codegen);
+    if (c->codegen.prof_path) gen_prof_dump(&c->codegen);
+    resolve_fixups(&c->codegen);
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Wave Object (.wo) - Relocatable module format
+// ═══════════════════════════════════════════════════════════════
+//
+// All fields are little-endian u32 unless noted:
+//   "WAVO" version
+//   source_len source[]          module source, the IR for link-time inlining
+//   code_len code[]              machine code, fixups left unresolved
+//   global_size march            march: MARCH_* level the code was built for
+//   init_len init[]              initial values of the first init_len global bytes
+//   sym_count   { name[64] start end def_pos body_end flags }
+//   label_count { name[64] pos }
+//   fixup_count { label[64] pos }  rel32 slots
+//   gref_count  { pos off }        imm64 slots holding GLOBAL_BASE + off
+//
+// Symbol 0 is the module initializer "_module_main". Every symbol owns the
+// code range [start, end) and is the unit of dead-function elimination.
+
+#define WO_VERSION 3
+#define WO_SYM_INLINE 1   // Single-expression function, IR usable for inlining
+#define WO_SYM_ALIGNED 2  // Code assumes start is at its offset modulo ALIGN_MAX
+
+typedef struct { char name[64]; uint32_t start, end, def_pos, body_end, flags; } WoSymbol;
+typedef struct { char name[64]; uint32_t pos; } WoLabel;
+typedef struct { uint32_t pos, off; } WoGref;
+
+typedef struct {
+    char* source;
+    uint32_t source_len;
+    uint8_t* code;
+    uint32_t code_len;
+    uint32_t global_size;
+    uint32_t march;
+    uint8_t* init;
+    uint32_t init_len;
+    WoSymbol* syms;
+    int sym_count;
+    WoLabel* labels;
+    int label_count;
+    WoLabel* fixups;
+    int fixup_count;
+    WoGref* grefs;
+    int gref_count;
+} WaveObject;
+
+void wo_free(WaveObject* o) {
+    free(o->source);
+    free(o->code);
+    free(o->init);
+    free(o->syms);
+    free(o->labels);
+    free(o->fixups);
+    free(o->grefs);
+    memset(o, 0, sizeof(*o));
+}
+
+// Capture a compiled module (compiled with codegen.object_mode set)
+void wo_from_compiler(Compiler* c, WaveObject* o) {
+    CodeGen* cg = &c->codegen;
+    memset(o, 0, sizeof(*o));
+    
+    o->source_len = (uint32_t)c->import_pos;
+    o->source = malloc(o->source_len + 1);
+    memcpy(o->source, c->source, o->source_len);
+    o->source[o->source_len] = 0;
+    
+    o->code_len = (uint32_t)cg->code_pos;
+    o->code = malloc(o->code_len + 1);
+    memcpy(o->code, cg->code, o->code_len);
+    o->global_size = (uint32_t)cg->global_data_pos;
+    o->march = (uint32_t)cg->march;
+    o->init_len = (uint32_t)cg->global_init_len;
+    o->init = malloc(o->init_len + 1);
+    if (o->init_len) memcpy(o->init, cg->global_init, o->init_len);
+    
+    o->syms = malloc(sizeof(WoSymbol) * (cg->func_count + cg->rt_sym_count + 1));
+    WoSymbol* m = &o->syms[o->sym_count++];
+    memset(m, 0, sizeof(*m));
+    strcpy(m->name, "_module_main");
+    m->end = (uint32_t)cg->main_end;
+    for (int i = 0; i < cg->func_count; i++) {
+        Function* fn = &cg->funcs[i];
+        if (fn->is_import || fn->code_end <= fn->code_offset) continue;
+        WoSymbol* s = &o->syms[o->sym_count++];
+        memset(s, 0, sizeof(*s));
+        strncpy(s->name, fn->name, 63);
+        s->start = (uint32_t)fn->code_offset;
+        s->end = (uint32_t)fn->code_end;
+        s->def_pos = (uint32_t)fn->def_pos;
+        s->body_end = (uint32_t)fn->body_end;
+        if (fn_is_inlinable(c, fn)) s->flags |= WO_SYM_INLINE;
+    }
+    for (int i = 0; i < cg->rt_sym_count; i++) {
+        WoSymbol* s = &o->syms[o->sym_count++];
+        memset(s, 0, sizeof(*s));
+        strcpy(s->name, cg->rt_syms[i].name);
+        s->start = (uint32_t)cg->rt_syms[i].start;
+        s->end = (uint32_t)cg->rt_syms[i].end;
+    }
+    if (cg->aligned) {
+        for (int i = 0; i < o->sym_count; i++) o->syms[i].flags |= WO_SYM_ALIGNED;
+    }
+    
+    o->labels = malloc(sizeof(WoLabel) * (cg->label_count + 1));
+    for (int i = 0; i < cg->label_count; i++) {
+        memcpy(o->labels[i].name, cg->labels[i].name, 64);
+        o->labels[i].pos = (uint32_t)cg->labels[i].pos;
+    }
+    o->label_count = cg->label_count;
+    
+    o->fixups = malloc(sizeof(WoLabel) * (cg->fixup_count + 1));
+    for (int i = 0; i < cg->fixup_count; i++) {
+        memcpy(o->fixups[i].name, cg->fixups[i].label, 64);
+        o->fixups[i].pos = (uint32_t)cg->fixups[i].pos;
+    }
+    o->fixup_count = cg->fixup_count;
+    
+    o->grefs = malloc(sizeof(WoGref) * (cg->gref_count + 1));
+    for (int i = 0; i < cg->gref_count; i++) {
+        o->grefs[i].pos = (uint32_t)cg->grefs[i].pos;
+        o->grefs[i].off = cg->grefs[i].off;
+    }
+    o->gref_count = cg->gref_count;
+}
+
+void wo_put_u32(FILE* f, uint32_t v) {
+    uint8_t b[4] = { v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, (v >> 24) & 0xff };
+    fwrite(b, 1, 4, f);
+}
+
+bool wo_get_u32(FILE* f, uint32_t* v) {
+    uint8_t b[4];
+    if (fread(b, 1, 4, f) != 4) return false;
+    *v = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+    return true;
+}
+
+bool wo_write(WaveObject* o, const char* filename) {
+    FILE* f = fopen(filename, "wb");
+    if (!f) return false;
+    
+    fwrite("WAVO", 1, 4, f);
+    wo_put_u32(f, WO_VERSION);
+    wo_put_u32(f, o->source_len);
+    fwrite(o->source, 1, o->source_len, f);
+    wo_put_u32(f, o->code_len);
+    fwrite(o->code, 1, o->code_len, f);
+    wo_put_u32(f, o->global_size);
+    wo_put_u32(f, o->march);
+    wo_put_u32(f, o->init_len);
+    fwrite(o->init, 1, o->init_len, f);
+    
+    wo_put_u32(f, o->sym_count);
+    for (int i = 0; i < o->sym_count; i++) {
+        WoSymbol* s = &o->syms[i];
+        fwrite(s->name, 1, 64, f);
+        wo_put_u32(f, s->start);
+        wo_put_u32(f, s->end);
+        wo_put_u32(f, s->def_pos);
+        wo_put_u32(f, s->body_end);
+        wo_put_u32(f, s->flags);
+    }
+    wo_put_u32(f, o->label_count);
+    for (int i = 0; i < o->label_count; i++) {
+        fwrite(o->labels[i].name, 1, 64, f);
+        wo_put_u32(f, o->labels[i].pos);
+    }
+    wo_put_u32(f, o->fixup_count);
+    for (int i = 0; i < o->fixup_count; i++) {
+        fwrite(o->fixups[i].name, 1, 64, f);
+        wo_put_u32(f, o->fixups[i].pos);
+    }
+    wo_put_u32(f, o->gref_count);
+    for (int i = 0; i < o->gref_count; i++) {
+        wo_put_u32(f, o->grefs[i].pos);
+        wo_put_u32(f, o->grefs[i].off);
+    }
+    
+    fclose(f);
+    return true;
+}
+
+bool wo_read(WaveObject* o, const char* filename) {
+    memset(o, 0, sizeof(*o));
+    FILE* f = fopen(filename, "rb");
+    if (!f) return false;
+    
+    // Sections are no longer than the file
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    
+    char magic[4];
+    uint32_t version, n;
+    bool ok = fread(magic, 1, 4, f) == 4 && memcmp(magic, "WAVO", 4) == 0 &&
+              wo_get_u32(f, &version) && version == WO_VERSION;
+    
+    ok = ok && wo_get_u32(f, &o->source_len) && o->source_len <= size;
+    if (ok) {
+        o->source = malloc(o->source_len + 1);
+        ok = fread(o->source, 1, o->source_len, f) == o->source_len;
+        o->source[o->source_len] = 0;
+    }
+    ok = ok && wo_get_u32(f, &o->code_len) && o->code_len <= MAX_CODE;
+    if (ok) {
+        o->code = malloc(o->code_len + 1);
+        ok = fread(o->code, 1, o->code_len, f) == o->code_len;
+    }
+    ok = ok && wo_get_u32(f, &o->global_size);
+    ok = ok && wo_get_u32(f, &o->march) && o->march <= MARCH_V4;
+    ok = ok && wo_get_u32(f, &o->init_len) && o->init_len <= size;
+    if (ok) {
+        o->init = malloc(o->init_len + 1);
+        ok = fread(o->init, 1, o->init_len, f) == o->init_len;
+    }
+    
+    ok = ok && wo_get_u32(f, &n) && n <= MAX_FUNCS + RT_MAX_SYMS + 1;
+    if (ok) {
+        o->syms = calloc(n + 1, sizeof(WoSymbol));
+        o->sym_count = n;
+        for (uint32_t i = 0; ok && i < n; i++) {
+            WoSymbol* s = &o->syms[i];
+            ok = fread(s->name, 1, 64, f) == 64 &&
+                 wo_get_u32(f, &s->start) && wo_get_u32(f, &s->end) &&
+                 wo_get_u32(f, &s->def_pos) && wo_get_u32(f, &s->body_end) &&
+                 wo_get_u32(f, &s->flags);
+            s->name[63] = 0;
+        }
+    }
+    ok = ok && wo_get_u32(f, &n) && n <= MAX_LABELS;
+    if (ok) {
+        o->labels = calloc(n + 1, sizeof(WoLabel));
+        o->label_count = n;
+        for (uint32_t i = 0; ok && i < n; i++) {
+            ok = fread(o->labels[i].name, 1, 64, f) == 64 && wo_get_u32(f, &o->labels[i].pos);
+            o->labels[i].name[63] = 0;
+        }
+    }
+    ok = ok && wo_get_u32(f, &n) && n <= MAX_LABELS;
+    if (ok) {
+        o->fixups = calloc(n + 1, sizeof(WoLabel));
+        o->fixup_count = n;
+        for (uint32_t i = 0; ok && i < n; i++) {
+            ok = fread(o->fixups[i].name, 1, 64, f) == 64 && wo_get_u32(f, &o->fixups[i].pos);
+            o->fixups[i].name[63] = 0;
+        }
+    }
+    ok = ok && wo_get_u32(f, &n) && n <= MAX_GREFS;
+    if (ok) {
+        o->grefs = calloc(n + 1, sizeof(WoGref));
+        o->gref_count = n;
+        for (uint32_t i = 0; ok && i < n; i++) {
+            ok = wo_get_u32(f, &o->grefs[i].pos) && wo_get_u32(f, &o->grefs[i].off);
+        }
+    }
+    
+    fclose(f);
+    if (!ok) wo_free(o);
+    return ok;
+}
+
+// Compile one module in object mode; imports is IR text of other modules'
+// inlinable functions (may be empty)
+void wo_compile(WaveObject* o, const char* source, size_t source_len, const char* imports, int march) {
+    size_t import_len = strlen(imports);
+    char* text = malloc(source_len + import_len + 2);
+    memcpy(text, source, source_len);
+    text[source_len] = '\n';
+    memcpy(text + source_len + 1, imports, import_len + 1);
+    
+    Compiler* c = malloc(sizeof(Compiler));
+    compiler_init(c, text);
+    c->import_pos = source_len;
+    c->codegen.object_mode = true;
+    c->codegen.march = march;
+    compile(c);
+    wo_from_compiler(c, o);
+    
+    compiler_free(c);
+    free(c);
+    free(text);
+}
+
+int wo_find_symbol(WaveObject* o, const char* name) {
+    for (int i = 1; i < o->sym_count; i++) {
+        if (strcmp(o->syms[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+// Every offset within its section: the linker copies and patches by them
+bool wo_valid(WaveObject* o) {
+    for (int i = 0; i < o->sym_count; i++) {
+        WoSymbol* s = &o->syms[i];
+        if (s->start > s->end || s->end > o->code_len) return false;
+        if (s->def_pos > s->body_end || s->body_end > o->source_len) return false;
+    }
+    for (int i = 0; i < o->label_count; i++) {
+        if (o->labels[i].pos > o->code_len) return false;
+    }
+    for (int i = 0; i < o->fixup_count; i++) {
+        if ((uint64_t)o->fixups[i].pos + 4 > o->code_len) return false;
+    }
+    // A global reference is an 8-byte slot; initial values are copied into
+    // the module's own globals
+    for (int i = 0; i < o->gref_count; i++) {
+        if ((uint64_t)o->grefs[i].pos + 8 > o->code_len) return false;
+        if ((uint64_t)o->grefs[i].off + 8 > o->global_size) return false;
+    }
+    return o->init_len <= o->global_size;
+}
+
+// Runtime helpers are private to each module; functions are global
+bool wo_is_runtime(WoSymbol* s) { return strncmp(s->name, "_rt_", 4) == 0; }
+
+int wo_symbol_at(WaveObject* o, uint32_t pos) {
+    for (int i = 0; i < o->sym_count; i++) {
+        if (pos >= o->syms[i].start && pos < o->syms[i].end) return i;
+    }
+    return -1;
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Linker - Cross-module inlining + dead-function elimination
+// ═══════════════════════════════════════════════════════════════
+
+// One timer wheel per program: a label inside object k's timer runtime
+// belongs to the first object that has one
+int link_timer_owner(WaveObject* objs, int k, const char* label) {
+    int s = wo_find_symbol(&objs[k], "_rt_timer");
+    if (s < 0) return k;
+    for (int i = 0; i < objs[k].label_count; i++) {
+        if (strcmp(objs[k].labels[i].name, label) != 0) continue;
+        uint32_t pos = objs[k].labels[i].pos;
+        if (pos < objs[k].syms[s].start || pos >= objs[k].syms[s].end) return k;
+        for (int j = 0; j < k; j++) {
+            if (wo_find_symbol(&objs[j], "_rt_timer") >= 0) return j;
+        }
+        return k;
+    }
+    return k;
+}
+
+// Resolve a fixup label of object k: module-local labels first, then the
+// global function symbols of every module (first definition wins)
+bool link_resolve(WaveObject* objs, int n, int k, const char* label, int* out_obj, uint32_t* out_pos) {
+    k = link_timer_owner(objs, k, label);
+    for (int i = 0; i < objs[k].label_count; i++) {
+        if (strcmp(objs[k].labels[i].name, label) == 0) {
+            *out_obj = k;
+            *out_pos = objs[k].labels[i].pos;
+            return true;
+        }
+    }
+    for (int j = 0; j < n; j++) {
+        int s = wo_find_symbol(&objs[j], label);
+        if (s >= 0) {
+            *out_obj = j;
+            *out_pos = objs[j].syms[s].start;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Count call sites of object k that target another module's function
+int link_external_calls(WaveObject* objs, int n, int k) {
+    int count = 0;
+    for (int i = 0; i < objs[k].fixup_count; i++) {
+        const char* name = objs[k].fixups[i].name;
+        if (wo_find_symbol(&objs[k], name) >= 0) continue;
+        for (int j = 0; j < n; j++) {
+            if (j != k && wo_find_symbol(&objs[j], name) >= 0) { count++; break; }
+        }
+    }
+    return count;
+}
+
+// Link-time inlining: recompile a module from its IR with the inlinable
+// functions it calls from other modules appended as imports
+int link_inline(WaveObject* objs, int n, int k) {
+    size_t cap = 4096, len = 0;
+    char* imports = malloc(cap);
+    imports[0] = 0;
+    
+    for (int j = 0; j < n; j++) {
+        if (j == k) continue;
+        for (int s = 1; s < objs[j].sym_count; s++) {
+            WoSymbol* sym = &objs[j].syms[s];
+            if (!(sym->flags & WO_SYM_INLINE)) continue;
+            if (wo_find_symbol(&objs[k], sym->name) >= 0) continue;
+            bool called = false;
+            for (int i = 0; i < objs[k].fixup_count && !called; i++) {
+                called = strcmp(objs[k].fixups[i].name, sym->name) == 0;
+            }
+            if (!called || sym->body_end < sym->def_pos || sym->body_end >= objs[j].source_len) continue;
+            
+            size_t ir_len = sym->body_end - sym->def_pos + 1;
+            if (len + ir_len + 2 > cap) {
+                while (len + ir_len + 2 > cap) cap *= 2;
+                imports = realloc(imports, cap);
+            }
+            memcpy(imports + len, objs[j].source + sym->def_pos, ir_len);
+            len += ir_len;
+            imports[len++] = '\n';
+            imports[len] = 0;
+        }
+    }
+    
+    int inlined = 0;
+    if (len > 0) {
+        int before = link_external_calls(objs, n, k);
+        WaveObject fresh;
+        wo_compile(&fresh, objs[k].source, objs[k].source_len, imports, objs[k].march);
+        wo_free(&objs[k]);
+        objs[k] = fresh;
+        inlined = before - link_external_calls(objs, n, k);
+    }
+    free(imports);
+    return inlined;
+}
+
+int link_objects(char** inputs, int n, const char* output, bool lto) {
+    WaveObject* objs = calloc(n, sizeof(WaveObject));
+    bool** live = calloc(n, sizeof(bool*));
+    uint32_t** new_start = calloc(n, sizeof(uint32_t*));
+    uint64_t* global_off = calloc(n, sizeof(uint64_t));
+    int rc = 1;
+    
+    for (int k = 0; k < n; k++) {
+        if (!wo_read(&objs[k], inputs[k])) {
+            fprintf(stderr, "Cannot read object: %s\n", inputs[k]);
+            goto done;
+        }
+        if (!wo_valid(&objs[k])) {
+            fprintf(stderr, "Corrupt object: %s\n", inputs[k]);
+            goto done;
+        }
+        for (int s = 1; s < objs[k].sym_count; s++) {
+            if (wo_is_runtime(&objs[k].syms[s])) continue;
+            for (int j = 0; j < k; j++) {
+                if (wo_find_symbol(&objs[j], objs[k].syms[s].name) < 0) continue;
+                fprintf(stderr, "Duplicate definition: %s (in %s and %s)\n",
+                        objs[k].syms[s].name, inputs[j], inputs[k]);
+                goto done;
+            }
+        }
+    }
     
-    // emit
-    if (match(c, "emit ")) { c->pos += 5; compile_emit(c); return; }
+    int inlined = 0;
+    if (lto) {
+        for (int k = 0; k < n; k++) inlined += link_inline(objs, n, k);
+    }
     
-    // fn
-    if (match(c, "fn ")) { c->pos += 3; compile_fn_def(c); return; }
+    // Each module keeps its own global area
+    uint64_t global_total = 0;
+    for (int k = 0; k < n; k++) {
+        global_off[k] = global_total;
+        global_total += ((uint64_t)objs[k].global_size + 7) & ~7ull;
+    }
     
-    // when
-    if (match(c, "when ")) { c->pos += 5; compile_when(c); return; }
+    // Reachability from every module initializer
+    int total_syms = 0, kept = 0;
+    int* stack = malloc(sizeof(int) * 2 * (MAX_FUNCS + 1) * n);
+    int sp = 0;
+    for (int k = 0; k < n; k++) {
+        live[k] = calloc(objs[k].sym_count, sizeof(bool));
+        new_start[k] = calloc(objs[k].sym_count, sizeof(uint32_t));
+        total_syms += objs[k].sym_count;
+        live[k][0] = true;
+        stack[sp++] = k;
+        stack[sp++] = 0;
+    }
+    while (sp > 0) {
+        int s = stack[--sp], k = stack[--sp];
+        WoSymbol* sym = &objs[k].syms[s];
+        for (int i = 0; i < objs[k].fixup_count; i++) {
+            WoLabel* fx = &objs[k].fixups[i];
+            if (fx->pos < sym->start || fx->pos >= sym->end) continue;
+            int tk;
+            uint32_t tpos;
+            if (!link_resolve(objs, n, k, fx->name, &tk, &tpos)) {
+                fprintf(stderr, "Undefined symbol: %s (in %s)\n", fx->name, inputs[k]);
+                free(stack);
+                goto done;
+            }
+            int ts = wo_symbol_at(&objs[tk], tpos);
+            if (ts >= 0 && !live[tk][ts]) {
+                live[tk][ts] = true;
+                stack[sp++] = tk;
+                stack[sp++] = ts;
+            }
+        }
+    }
+    free(stack);
+    
+    // Layout: startup stub calls library initializers, then the entry module
+    CodeGen* out = malloc(sizeof(CodeGen));
+    codegen_init(out);
+    size_t* stub_calls = calloc(n, sizeof(size_t));
+    for (int k = 1; k <= n; k++) {
+        emit_byte(out, 0xe8);
+        stub_calls[k % n] = out->code_pos;
+        emit_u32(out, 0);
+    }
+    gen_exit(out, 0);
+    
+    for (int k = 0; k < n; k++) {
+        for (int s = 0; s < objs[k].sym_count; s++) {
+            if (!live[k][s]) continue;
+            WoSymbol* sym = &objs[k].syms[s];
+            if (sym->flags & WO_SYM_ALIGNED) {
+                size_t at = (out->text_bias + out->code_pos) % ALIGN_MAX;
+                gen_nops(out, (int)((sym->start % ALIGN_MAX + ALIGN_MAX - at) % ALIGN_MAX));
+            }
+            new_start[k][s] = (uint32_t)out->code_pos;
+            emit_bytes(out, objs[k].code + sym->start, sym->end - sym->start);
+            kept++;
+        }
+    }
     
-    // loop
-    if (match(c, "loop")) { c->pos += 4; skip_whitespace(c); compile_loop(c); return; }
+    // Patch stub, rel32 fixups and global addresses
+    for (int k = 0; k < n; k++) {
+        int32_t rel = (int32_t)(new_start[k][0] - stub_calls[k] - 4);
+        memcpy(out->code + stub_calls[k], &rel, 4);
+    }
+    for (int k = 0; k < n; k++) {
+        for (int i = 0; i < objs[k].fixup_count; i++) {
+            WoLabel* fx = &objs[k].fixups[i];
+            int s = wo_symbol_at(&objs[k], fx->pos);
+            if (s < 0 || !live[k][s]) continue;
+            int tk;
+            uint32_t tpos;
+            link_resolve(objs, n, k, fx->name, &tk, &tpos);
+            int ts = wo_symbol_at(&objs[tk], tpos);
+            if (ts < 0) continue;
+            size_t fix_pos = new_start[k][s] + (fx->pos - objs[k].syms[s].start);
+            size_t target = new_start[tk][ts] + (tpos - objs[tk].syms[ts].start);
+            int32_t rel = (int32_t)(target - fix_pos - 4);
+            memcpy(out->code + fix_pos, &rel, 4);
+        }
+        for (int i = 0; i < objs[k].gref_count; i++) {
+            WoGref* g = &objs[k].grefs[i];
+            int s = wo_symbol_at(&objs[k], g->pos);
+            if (s < 0 || !live[k][s]) continue;
+            uint64_t addr = GLOBAL_BASE + global_off[k] + g->off;
+            memcpy(out->code + new_start[k][s] + (g->pos - objs[k].syms[s].start), &addr, 8);
+        }
+    }
+    out->global_data_pos = global_total;
+    
+    // Initial values keep their module's offset in the merged global area
+    for (int k = 0; k < n; k++) {
+        for (uint32_t i = 0; i + 8 <= objs[k].init_len; i += 8) {
+            int64_t value;
+            memcpy(&value, objs[k].init + i, 8);
+            if (value) global_init_set(out, GLOBAL_BASE + global_off[k] + i, value);
+        }
+    }
     
-    // break
-    if (match(c, "break")) { c->pos += 5; compile_break(c); return; }
+    bool written = write_elf(out, output);
+    if (written) {
+        printf("Linked: %s\n", output);
+        printf("   Code: %zu bytes\n", out->code_pos);
+        printf("   Objects: %d | Symbols kept: %d/%d | Inlined calls: %d\n",
+               n, kept, total_syms, inlined);
+    } else {
+        fprintf(stderr, "Cannot write: %s\n", output);
+    }
+    codegen_free(out);
+    free(out);
+    free(stub_calls);
+    rc = written ? 0 : 1;
+    
+done:
+    for (int k = 0; k < n; k++) {
+        wo_free(&objs[k]);
+        free(live[k]);
+        free(new_start[k]);
+    }
+    free(objs);
+    free(live);
+    free(new_start);
+    free(global_off);
+    return rc;
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Autotune - Fate searches the unified field by benchmarking variants
+// ═══════════════════════════════════════════════════════════════
+//
+// Each round compiles the neighbours of the best field so far (one axis
+// moved by AUTOTUNE_STEP), runs them on the benchmark input and keeps the
+// fastest whose output and exit status match the untuned build. The
+// speedup over that build is Fate's gain; when a round adds less than the
+// marginal threshold (limit N) Fate collapses. The field is stored only if
+// the winner, timed again against the untuned build, is faster on every run.
+
+// Pin the field a store entry holds
+void fate_store_pin(Compiler* c, FateScheduler* stored) {
+    unified_set(&c->unified, fate_recall(stored, "static:i"), fate_recall(stored, "static:e"),
+                fate_recall(stored, "static:r"));
+    c->unified_pinned = true;
+    passes_configure(c);
+}
+
+// Use the field --autotune stored for this source
+bool fate_store_apply(Compiler* c) {
+    FateScheduler stored;
+    fate_init(&stored);
+    if (!fate_store_load(&stored, FATE_STORE_PATH, source_hash(c->source, c->len))) return false;
+    fate_store_pin(c, &stored);
+    return true;
+}
+
+// Compile source to the executable path, with field pinned or, when pin is
+// false, as the source sets it (field and threshold receive that setting)
+bool autotune_build(const char* source, UnifiedField* field, bool pin, double* threshold,
+                    const char* path) {
+    Compiler* c = malloc(sizeof(Compiler));
+    if (!c) return false;
+    compiler_init(c, source);
+    if (pin) {
+        c->unified = *field;
+        c->unified_pinned = true;
+        passes_configure(c);
+    }
+    compile(c);
+    bool ok = !c->error[0];
+    if (!pin) {
+        *field = c->unified;
+        *threshold = c->fate.marginal_threshold;
+    }
+    ok = ok && write_elf(&c->codegen, path);
+    compiler_free(c);
+    free(c);
+    return ok;
+}
+
+// One run in ns with stdin from input and stdout to out, 0 when it could
+// not start or timed out
+uint64_t autotune_run(const char* path, const char* input, const char* out, int* status) {
+    uint64_t start = pass_clock();
+    pid_t pid = fork();
+    if (pid < 0) return 0;
+    if (pid == 0) {
+        int in_fd = open(input, O_RDONLY);
+        int out_fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (in_fd < 0 || out_fd < 0) _exit(127);
+        dup2(in_fd, 0);
+        dup2(out_fd, 1);
+        alarm(AUTOTUNE_TIMEOUT);
+        execl(path, path, (char*)NULL);
+        _exit(127);
+    }
+    int st;
+    if (waitpid(pid, &st, 0) < 0) return 0;
+    uint64_t ns = pass_clock() - start;
+    if ((WIFEXITED(st) && WEXITSTATUS(st) == 127) || (WIFSIGNALED(st) && WTERMSIG(st) == SIGALRM)) {
+        return 0;
+    }
+    *status = st;
+    return ns ? ns : 1;
+}
+
+// Fastest of AUTOTUNE_RUNS runs, 0 when one failed
+uint64_t autotune_time(const char* path, const char* input, const char* out, int* status) {
+    uint64_t best = 0;
+    for (int run = 0; run < AUTOTUNE_RUNS; run++) {
+        uint64_t ns = autotune_run(path, input, out, status);
+        if (!ns) return 0;
+        if (best == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+// Re-time the winner against the source build, alternating so that drift
+// hits both. The winner only counts when its slowest run beats the source
+// build's fastest: a speedup inside the run-to-run spread is noise.
+bool autotune_confirm(const char* base_bin, const char* best_bin, const char* input,
+                      const char* out, double* speedup) {
+    uint64_t base_min = 0, base_max = 0, best_min = 0, best_max = 0;
+    int status;
+    for (int run = 0; run < AUTOTUNE_CONFIRM_RUNS; run++) {
+        uint64_t a = autotune_run(base_bin, input, out, &status);
+        uint64_t b = autotune_run(best_bin, input, out, &status);
+        if (!a || !b) return false;
+        if (!base_min || a < base_min) base_min = a;
+        if (a > base_max) base_max = a;
+        if (!best_min || b < best_min) best_min = b;
+        if (b > best_max) best_max = b;
+    }
+    *speedup = (double)base_min / best_min;
+    printf("   Autotune: confirm source %.3f-%.3f ms, best %.3f-%.3f ms\n",
+           base_min / 1e6, base_max / 1e6, best_min / 1e6, best_max / 1e6);
+    return best_max < base_min;
+}
+
+bool files_equal(const char* a, const char* b) {
+    FILE* fa = fopen(a, "rb");
+    FILE* fb = fopen(b, "rb");
+    bool equal = fa && fb;
+    while (equal) {
+        int ca = fgetc(fa), cb = fgetc(fb);
+        if (ca != cb) equal = false;
+        if (ca == EOF) break;
+    }
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    return equal;
+}
+
+// --autotune: search, store the winning field; false when the untuned
+// program cannot be benchmarked
+bool autotune(const char* source, const char* input) {
+    char dir[] = "/tmp/wave_tune_XXXXXX";
+    if (!mkdtemp(dir)) return false;
+    char bin[64], base_bin[64], base_out[64], try_out[64];
+    snprintf(bin, sizeof(bin), "%s/variant", dir);
+    snprintf(base_bin, sizeof(base_bin), "%s/source", dir);
+    snprintf(base_out, sizeof(base_out), "%s/base.out", dir);
+    snprintf(try_out, sizeof(try_out), "%s/try.out", dir);
+    
+    FateScheduler fate;
+    fate_init(&fate);
+    int base_status = 0, status = 0;
+    if (!autotune_build(source, &fate.field, false, &fate.marginal_threshold, base_bin)) {
+        rmdir(dir);
+        return true;  // The build proper reports the error
+    }
+    uint64_t base_ns = autotune_time(base_bin, input, base_out, &base_status);
+    uint64_t best_ns = base_ns;
+    UnifiedField source_field = fate.field;
+    if (base_ns) {
+        printf("   Autotune: i=%.2f e=%.2f r=%.2f  %.3f ms (source)\n",
+               fate.field.i, fate.field.e, fate.field.r, base_ns / 1e6);
+    }
+    
+    for (int round = 0; base_ns && round < AUTOTUNE_MAX_ROUNDS; round++) {
+        UnifiedField center = fate.field;
+        for (int k = 0; k < 6; k++) {
+            UnifiedField f = center;
+            double* axis = k / 2 == 0 ? &f.i : k / 2 == 1 ? &f.e : &f.r;
+            double moved = fmax(0.0, fmin(1.0, *axis + (k % 2 ? AUTOTUNE_STEP : -AUTOTUNE_STEP)));
+            if (moved == *axis) continue;
+            *axis = moved;
+            if (f.i == source_field.i && f.e == source_field.e && f.r == source_field.r) continue;
+            
+            // A variant that fails to build would time the previous binary
+            if (!autotune_build(source, &f, true, NULL, bin)) {
+                printf("   Autotune: i=%.2f e=%.2f r=%.2f  build failed\n", f.i, f.e, f.r);
+                continue;
+            }
+            uint64_t ns = autotune_time(bin, input, try_out, &status);
+            bool same = ns && status == base_status && files_equal(try_out, base_out);
+            printf("   Autotune: i=%.2f e=%.2f r=%.2f  %.3f ms%s\n",
+                   f.i, f.e, f.r, ns / 1e6, same ? "" : " (rejected)");
+            if (same && ns < best_ns) {
+                best_ns = ns;
+                fate.field = f;
+            }
+        }
+        fate.gain = (double)base_ns / best_ns - 1.0;
+        if (fate_should_collapse(&fate)) break;
+    }
+    
+    bool tuned = false;
+    double speedup = 1.0;
+    if (best_ns < base_ns) {
+        tuned = autotune_build(source, &fate.field, true, NULL, bin) &&
+                autotune_confirm(base_bin, bin, input, try_out, &speedup);
+    }
+    
+    unlink(bin);
+    unlink(base_bin);
+    unlink(base_out);
+    unlink(try_out);
+    rmdir(dir);
+    if (!base_ns) return false;
+    
+    if (!tuned) {
+        printf("   Autotune: no speedup beyond run-to-run noise; %s unchanged\n", FATE_STORE_PATH);
+        return true;
+    }
+    fate_collapse(&fate);
+    printf("   Autotune: best i=%.2f e=%.2f r=%.2f  %.2fx -> %s\n",
+           fate.field.i, fate.field.e, fate.field.r, speedup, FATE_STORE_PATH);
+    if (!fate_store_save(&fate, FATE_STORE_PATH, source_hash(source, strlen(source)))) {
+        fprintf(stderr, "Cannot write: %s\n", FATE_STORE_PATH);
+    }
+    return true;
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Build - One compile request (command line or --server)
+// ═══════════════════════════════════════════════════════════════
+
+typedef struct {
+    const char* input;
+    const char* output;
+    const char* output_file;  // Where output is written; the server's is absolute
+    bool raw_mode;
+    bool object_mode;
+    bool tiny;
+    int march;
+    const char* profile_out;
+    const char* profile_in;
+    bool time_passes;
+    uint32_t pass_enable;
+    uint32_t pass_disable;
+    const char* autotune_input;
+    const char* cache;    // Output cache directory (WAVEC_CACHE), NULL = off
+} BuildOptions;
+
+// argv[1] is the input, options follow; false (reason on err) on a bad one
+bool build_options(BuildOptions* o, int argc, char** argv, FILE* err) {
+    memset(o, 0, sizeof(*o));
+    o->input = argv[1];
+    o->march = MARCH_DISPATCH;
+    o->cache = getenv("WAVEC_CACHE");
+    if (o->cache && !*o->cache) o->cache = NULL;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) o->output = argv[++i];
+        else if (strcmp(argv[i], "--fate-instrument") == 0) o->profile_out = "fate.prof";
+        else if (strncmp(argv[i], "--fate-instrument=", 18) == 0) o->profile_out = argv[i] + 18;
+        else if (strncmp(argv[i], "--fate-profile=", 15) == 0) o->profile_in = argv[i] + 15;
+        else if (strcmp(argv[i], "--raw") == 0) o->raw_mode = true;
+        else if (strcmp(argv[i], "--tiny") == 0) o->tiny = true;
+        else if (strcmp(argv[i], "-c") == 0) o->object_mode = true;
+        else if (strcmp(argv[i], "--time-passes") == 0) o->time_passes = true;
+        else if (strcmp(argv[i], "--autotune") == 0 && i + 1 < argc) o->autotune_input = argv[++i];
+        else if (strncmp(argv[i], "--enable-pass=", 14) == 0 || strncmp(argv[i], "--disable-pass=", 15) == 0) {
+            bool enable = argv[i][2] == 'e';
+            const char* list = strchr(argv[i], '=') + 1;
+            if (!pass_mask(list, enable ? &o->pass_enable : &o->pass_disable)) {
+                fprintf(err, "Unknown pass in: %s\n", list);
+                return false;
+            }
+        }
+        else if (strncmp(argv[i], "--march=", 8) == 0) {
+            const char* arch = argv[i] + 8;
+            if (strcmp(arch, "native") == 0) o->march = march_host();
+            else if (strcmp(arch, "x86-64-v2") == 0) o->march = MARCH_V2;
+            else if (strcmp(arch, "x86-64-v3") == 0) o->march = MARCH_V3;
+            else if (strcmp(arch, "x86-64-v4") == 0) o->march = MARCH_V4;
+            else { fprintf(err, "Unknown --march: %s\n", arch); return false; }
+        }
+    }
+    if (!o->output) o->output = o->object_mode ? "a.wo" : "a.out";
+    o->output_file = o->output;
+    return true;
+}
+
+// Whole file, NUL-terminated; NULL when it cannot be read
+char* read_file(const char* path, size_t* size) {
+    FILE* f = fopen(path, "r");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    size_t n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* text = malloc(n + 1);
+    n = fread(text, 1, n, f);
+    text[n] = 0;
+    fclose(f);
+    if (size) *size = n;
+    return text;
+}
+
+// "Generated ..." line; the rest of a build's report is the same on a cache hit
+void build_header(BuildOptions* o, size_t code_size, FILE* out) {
+    if (o->object_mode) fprintf(out, "Generated object: %s\n", o->output);
+    else if (o->raw_mode) fprintf(out, "Generated raw: %s (%zu bytes)\n", o->output, code_size);
+    else fprintf(out, "Generated: %s\n", o->output);
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Cache - Content-addressed build outputs (WAVEC_CACHE)
+// ═══════════════════════════════════════════════════════════════
+//
+// With WAVEC_CACHE set to a directory, a build is keyed by a 64-bit FNV-1a
+// hash of the compiler (version, size, mtime), the options that reach the
+// output, the field fate.store pins, the input profile and the source.
+// There is nothing to preprocess first: "use" declarations are skipped by
+// the compiler. An entry is dir/hh/<key>.out plus <key>.txt, the
+// report. A hit reflinks the output into place, or copies it, never a
+// hard link. Every use touches the entry, so trimming by mtime is LRU.
+// dir/stats holds "hits misses bytes" and is updated under flock.
+
+uint64_t cache_mix(uint64_t h, const void* p, size_t n) {
+    const uint8_t* b = p;
+    for (size_t i = 0; i < n; i++) h = (h ^ b[i]) * 1099511628211ull;
+    return h;
+}
+
+// false when the build cannot come from the cache (--time-passes reports
+// a real compile)
+bool cache_key(Compiler* c, BuildOptions* o, uint64_t* key) {
+    if (o->time_passes) return false;
+    uint64_t h = cache_mix(14695981039346656037ull, VERSION, sizeof(VERSION));
+    struct stat st;
+    if (stat("/proc/self/exe", &st) == 0) {
+        int64_t exe[3] = { st.st_size, st.st_mtim.tv_sec, st.st_mtim.tv_nsec };
+        h = cache_mix(h, exe, sizeof(exe));
+    }
+    int32_t flags[6] = { o->raw_mode, o->object_mode, o->tiny, o->march,
+                         (int32_t)o->pass_enable, (int32_t)o->pass_disable };
+    h = cache_mix(h, flags, sizeof(flags));
+    if (o->profile_out && !o->object_mode) h = cache_mix(h, o->profile_out, strlen(o->profile_out) + 1);
+    if (c->profile) h = cache_mix(h, c->profile, sizeof(ProfileEntry) * c->profile_count);
+    if (c->unified_pinned) {
+        double field[3] = { c->unified.i, c->unified.e, c->unified.r };
+        h = cache_mix(h, field, sizeof(field));
+    }
+    *key = cache_mix(h, c->source, c->len);
+    return true;
+}
+
+void cache_path(char* buf, size_t size, const char* dir, uint64_t key, const char* ext) {
+    snprintf(buf, size, "%s/%02x/%016llx%s", dir, (unsigned)(key >> 56), (unsigned long long)key, ext);
+}
+
+uint64_t cache_size_cap(void) {
+    const char* v = getenv("WAVEC_CACHE_SIZE");
+    if (!v || !*v) return CACHE_MAX_SIZE;
+    char* end;
+    uint64_t n = strtoull(v, &end, 10);
+    if (*end == 'K' || *end == 'k') n <<= 10;
+    else if (*end == 'M' || *end == 'm') n <<= 20;
+    else if (*end == 'G' || *end == 'g') n <<= 30;
+    return n;
+}
+
+typedef struct { int64_t mtime; off_t size; char path[PATH_MAX + NAME_MAX + 2]; } CacheEntry;  // path: the .out
+
+int cache_entry_cmp(const void* a, const void* b) {
+    int64_t x = ((const CacheEntry*)a)->mtime, y = ((const CacheEntry*)b)->mtime;
+    return x < y ? -1 : x > y;
+}
+
+// Drop least recently used entries until the cache is under
+// CACHE_TRIM_SHARE of cap; returns the bytes left
+int64_t cache_trim(const char* dir, uint64_t cap) {
+    CacheEntry* entries = NULL;
+    int count = 0, capacity = 0;
+    int64_t total = 0;
+    char sub[PATH_MAX];
+    for (int b = 0; b < 256; b++) {
+        snprintf(sub, sizeof(sub), "%s/%02x", dir, b);
+        DIR* d = opendir(sub);
+        for (struct dirent* e; d && (e = readdir(d)); ) {
+            size_t n = strlen(e->d_name);
+            if (n < 4 || strcmp(e->d_name + n - 4, ".out") != 0) continue;
+            if (count == capacity) entries = realloc(entries, sizeof(CacheEntry) * (capacity = capacity * 2 + 64));
+            CacheEntry* ce = &entries[count];
+            snprintf(ce->path, sizeof(ce->path), "%s/%s", sub, e->d_name);
+            struct stat st;
+            if (stat(ce->path, &st) != 0) continue;
+            ce->mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+            ce->size = st.st_size;
+            total += st.st_size;
+            count++;
+        }
+        if (d) closedir(d);
+    }
+    qsort(entries, count, sizeof(CacheEntry), cache_entry_cmp);
+    for (int i = 0; i < count && total > (int64_t)(cap * CACHE_TRIM_SHARE); i++) {
+        char* file = entries[i].path;
+        unlink(file);
+        strcpy(file + strlen(file) - 4, ".txt");
+        unlink(file);
+        total -= entries[i].size;
+    }
+    free(entries);
+    return total;
+}
+
+// Add a hit or a miss and the bytes a miss stored; trims past the cap
+void cache_count(const char* dir, bool hit, int64_t bytes) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/stats", dir);
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+    flock(fd, LOCK_EX);
+    char buf[128] = {0};
+    long long hits = 0, misses = 0, total = 0;
+    if (read(fd, buf, sizeof(buf) - 1) > 0) sscanf(buf, "%lld %lld %lld", &hits, &misses, &total);
+    if (hit) hits++;
+    else misses++;
+    total += bytes;
+    uint64_t cap = cache_size_cap();
+    if (total > (long long)cap) total = cache_trim(dir, cap);
+    int n = snprintf(buf, sizeof(buf), "%lld %lld %lld\n", hits, misses, total);
+    if (ftruncate(fd, 0) == 0) pwrite(fd, buf, n, 0);
+    close(fd);  // Releases the lock
+}
+
+// Put the cached file src at dst: a reflink where the filesystem has
+// them, else a copy. Never a hard link: an edit of the output would
+// change the entry under every later hit. Only regular files are replaced.
+bool cache_place(const char* src, const char* dst) {
+    struct stat st;
+    if (lstat(dst, &st) == 0 && !S_ISREG(st.st_mode)) return false;
+    if (stat(src, &st) != 0) return false;
+    unlink(dst);
+    int in = open(src, O_RDONLY | O_CLOEXEC);
+    int out = in < 0 ? -1 : open(dst, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 0777);
+    bool ok = out >= 0 && ioctl(out, FICLONE, in) == 0;
+    if (!ok && out >= 0) {
+        char buf[65536];
+        ssize_t n;
+        while ((n = read(in, buf, sizeof(buf))) > 0 && write(out, buf, n) == n) {}
+        ok = n == 0;
+    }
+    if (in >= 0) close(in);
+    if (out >= 0) close(out);
+    return ok;
+}
+
+bool cache_fetch(BuildOptions* o, uint64_t key, FILE* out) {
+    char entry[PATH_MAX], report_path[PATH_MAX];
+    cache_path(entry, sizeof(entry), o->cache, key, ".out");
+    cache_path(report_path, sizeof(report_path), o->cache, key, ".txt");
+    size_t report_len;
+    char* report = read_file(report_path, &report_len);
+    if (!report || !cache_place(entry, o->output_file)) {
+        free(report);
+        return false;
+    }
+    utimensat(AT_FDCWD, entry, NULL, 0);
+    struct stat st;
+    stat(entry, &st);
+    build_header(o, st.st_size, out);
+    fwrite(report, 1, report_len, out);
+    free(report);
+    cache_count(o->cache, true, 0);
+    return true;
+}
+
+// Enter the output just written. A temporary name and rename keep a
+// concurrent build from seeing half an entry.
+void cache_store(BuildOptions* o, uint64_t key, const char* report, size_t report_len) {
+    char entry[PATH_MAX], report_path[PATH_MAX], tmp[PATH_MAX + 32];
+    cache_path(entry, sizeof(entry), o->cache, key, "");
+    mkdir(o->cache, 0755);
+    *strrchr(entry, '/') = 0;
+    mkdir(entry, 0755);
+    cache_path(entry, sizeof(entry), o->cache, key, ".out");
+    cache_path(report_path, sizeof(report_path), o->cache, key, ".txt");
+    
+    snprintf(tmp, sizeof(tmp), "%s.%d.%lx", report_path, (int)getpid(), (unsigned long)pthread_self());
+    FILE* f = fopen(tmp, "wb");
+    if (!f) return;
+    fwrite(report, 1, report_len, f);
+    fclose(f);
+    rename(tmp, report_path);
+    
+    snprintf(tmp, sizeof(tmp), "%s.%d.%lx", entry, (int)getpid(), (unsigned long)pthread_self());
+    unlink(tmp);
+    struct stat st;
+    if (stat(o->output_file, &st) != 0 || !S_ISREG(st.st_mode) || !cache_place(o->output_file, tmp) ||
+        rename(tmp, entry) != 0) {
+        unlink(tmp);
+        return;
+    }
+    cache_count(o->cache, false, st.st_size);
+}
+
+// --stats
+int cache_stats(void) {
+    const char* dir = getenv("WAVEC_CACHE");
+    if (!dir || !*dir) {
+        printf("   Cache: off (set WAVEC_CACHE to a directory)\n");
+        return 0;
+    }
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/stats", dir);
+    long long hits = 0, misses = 0, total = 0;
+    FILE* f = fopen(path, "r");
+    if (f) {
+        if (fscanf(f, "%lld %lld %lld", &hits, &misses, &total) != 3) hits = misses = total = 0;
+        fclose(f);
+    }
+    long long lookups = hits + misses;
+    printf("   Cache: %s\n", dir);
+    printf("   Hits: %lld | Misses: %lld | Hit rate: %.1f%%\n", hits, misses,
+           lookups ? 100.0 * hits / lookups : 0.0);
+    printf("   Size: %.1f MB of %.1f MB\n", total / 1048576.0, cache_size_cap() / 1048576.0);
+    return 0;
+}
+
+// Compile the source c was set up with as o asks and write the output;
+// the report goes to out. Returns the exit status.
+int build(Compiler* c, BuildOptions* o, FILE* out, FILE* err) {
+    c->codegen.object_mode = o->object_mode;
+    c->codegen.march = o->march;
+    c->codegen.raw_mode = o->raw_mode;
+    if (o->raw_mode) c->codegen.text_bias = 0;
+    else if (o->tiny && !o->object_mode) {
+        c->codegen.tiny = true;
+        c->codegen.text_bias = ELF_TINY_OFFSET;
+    }
+    c->time_passes = o->time_passes;
+    c->pass_enable = o->pass_enable;
+    c->pass_disable = o->pass_disable;
+    passes_configure(c);
+    if (o->profile_in && !profile_load(c, o->profile_in)) {
+        fprintf(err, "Ignoring profile %s (missing or built from other source)\n", o->profile_in);
+    }
+    if (o->profile_out && !o->object_mode) {
+        c->codegen.prof_path = o->profile_out;
+        c->codegen.prof_hash = source_hash(c->source, c->len);
+    }
+    uint64_t key;
+    bool cached = o->cache && cache_key(c, o, &key);
+    if (cached && cache_fetch(o, key, out)) return 0;
+    
+    compile(c);
+    if (c->error[0]) {
+        fprintf(err, "%s\n", c->error);
+        return 1;
+    }
+    if (o->time_passes) passes_report(c, err);
+    
+    char* report = NULL;
+    size_t report_len = 0;
+    FILE* body = open_memstream(&report, &report_len);
+    bool written = true;
+    if (o->object_mode) {
+        WaveObject obj;
+        wo_from_compiler(c, &obj);
+        written = wo_write(&obj, o->output_file);
+        fprintf(body, "   Code: %u bytes | Symbols: %d | Relocations: %d\n",
+                obj.code_len, obj.sym_count, obj.fixup_count + obj.gref_count);
+        wo_free(&obj);
+    } else if (o->raw_mode) {
+        written = write_raw(&c->codegen, o->output_file);
+    } else {
+        written = write_elf(&c->codegen, o->output_file);
+        fprintf(body, "   Code: %zu bytes\n", c->codegen.code_pos);
+    }
+    if (!written) fprintf(err, "Cannot write: %s\n", o->output);  // Nor cache what is there
+    
+    fprintf(body, "   Variables: %d | Functions: %d\n",
+            c->codegen.var_count, c->codegen.func_count);
+    fprintf(body, "   Unified: i=%.2f e=%.2f r=%.2f%s\n",
+            c->unified.i, c->unified.e, c->unified.r, c->unified_pinned ? " (tuned)" : "");
+    fprintf(body, "   Tile: %zu bytes (%d pools)\n", tile_total_used(&c->tile), c->tile.pool_count);
+    fprintf(body, "   Fate: %s\n", c->fate.on ? "dynamic" : "static");
+    fprintf(body, "   Platform: id=%d syscall_base=0x%lx\n",
+            c->platform.id, c->platform.syscall_base);
+    fclose(body);
+    if (!written) {
+        free(report);
+        return 1;
+    }
+    
+    build_header(o, c->codegen.code_pos, out);
+    fwrite(report, 1, report_len, out);
+    if (cached) cache_store(o, key, report, report_len);
+    free(report);
+    return 0;
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Watch - Warm rebuilds on save (inotify)
+// ═══════════════════════════════════════════════════════════════
+//
+// --watch probes the platform and allocates the code buffers once, then
+// rebuilds each .wave file inotify reports written, starting from
+// compiler_reset. A save that leaves the source as it was last built
+// (same source_hash) costs no rebuild. A program is a single module, so a
+// rebuild never has to touch another file. Output goes to a temporary
+// name first and is renamed over, so a binary that is running keeps its text.
+
+typedef struct {
+    char name[NAME_MAX + 1];
+    uint32_t hash;        // source_hash of the last build
+    bool built;
+} WatchFile;
+
+typedef struct {
+    Compiler* c;          // Warm across rebuilds
+    char dir[PATH_MAX];
+    const char* only;     // Watching one file: its name in dir
+    const char* out;      // Output directory, or the output file with only
+    bool object_mode;
+    WatchFile files[WATCH_MAX_FILES];
+    int file_count;
+} Watch;
+
+bool watch_wanted(Watch* w, const char* name) {
+    size_t n = strlen(name);
+    if (w->only) return strcmp(name, w->only) == 0;
+    return n > 5 && strcmp(name + n - 5, ".wave") == 0;
+}
+
+WatchFile* watch_file(Watch* w, const char* name) {
+    for (int i = 0; i < w->file_count; i++) {
+        if (strcmp(w->files[i].name, name) == 0) return &w->files[i];
+    }
+    if (w->file_count >= WATCH_MAX_FILES) return NULL;
+    WatchFile* wf = &w->files[w->file_count++];
+    snprintf(wf->name, sizeof(wf->name), "%s", name);
+    wf->built = false;
+    return wf;
+}
+
+// Rebuild dir/name if its source changed since the last build
+bool watch_build(Watch* w, const char* name) {
+    char path[PATH_MAX * 2];
+    snprintf(path, sizeof(path), "%s/%s", w->dir, name);
+    size_t size;
+    char* source = read_file(path, &size);
+    if (!source) return false;  // Removed again before we got to it
+    
+    WatchFile* wf = watch_file(w, name);
+    uint32_t hash = source_hash(source, size);
+    if (!wf || (wf->built && wf->hash == hash)) {
+        free(source);
+        return wf != NULL;
+    }
+    
+    uint64_t start = pass_clock();
+    Compiler* c = w->c;
+    compiler_reset(c, source);
+    fate_store_apply(c);
+    c->codegen.object_mode = w->object_mode;
+    compile(c);
+    if (c->error[0]) {
+        fprintf(stderr, "   %s: %s\n", name, c->error);
+        free(source);
+        return false;
+    }
+    
+    char out[PATH_MAX * 2], tmp[PATH_MAX * 2 + 8];
+    if (w->only) snprintf(out, sizeof(out), "%s", w->out);
+    else snprintf(out, sizeof(out), "%s/%.*s%s", w->out, (int)strlen(name) - 5, name,
+                  w->object_mode ? ".wo" : "");
+    snprintf(tmp, sizeof(tmp), "%s.tmp", out);
+    bool ok = true;
+    if (w->object_mode) {
+        WaveObject obj;
+        wo_from_compiler(c, &obj);
+        ok = wo_write(&obj, tmp);
+        wo_free(&obj);
+    } else {
+        ok = write_elf(&c->codegen, tmp);
+    }
+    ok = ok && rename(tmp, out) == 0;
+    free(source);
+    if (!ok) {
+        fprintf(stderr, "Cannot write: %s\n", out);
+        return false;
+    }
+    wf->hash = hash;
+    wf->built = true;
+    printf("   %s -> %s  %zu bytes  %.2f ms\n", name, out, c->codegen.code_pos,
+           (pass_clock() - start) / 1e6);
+    return true;
+}
+
+int watch_run(const char* target, const char* out, bool object_mode) {
+    struct stat st;
+    if (stat(target, &st) != 0) {
+        fprintf(stderr, "Cannot open: %s\n", target);
+        return 1;
+    }
+    Watch* w = malloc(sizeof(Watch));
+    if (!w) return 1;
+    w->file_count = 0;
+    w->object_mode = object_mode;
+    snprintf(w->dir, sizeof(w->dir), "%s", target);
+    w->only = NULL;
+    if (!S_ISDIR(st.st_mode)) {
+        char* slash = strrchr(w->dir, '/');
+        w->only = slash ? target + (slash - w->dir) + 1 : target;
+        if (slash) *slash = 0;
+        else strcpy(w->dir, ".");
+    }
+    w->out = out ? out : w->only ? (object_mode ? "a.wo" : "a.out") : w->dir;
+    if (!w->only) mkdir(w->out, 0755);
+    
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, w->dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        fprintf(stderr, "Cannot watch: %s\n", w->dir);
+        free(w);
+        return 1;
+    }
+    w->c = malloc(sizeof(Compiler));
+    compiler_init(w->c, "");
+    
+    DIR* d = opendir(w->dir);
+    for (struct dirent* e; d && (e = readdir(d)); ) {
+        if (watch_wanted(w, e->d_name)) watch_build(w, e->d_name);
+    }
+    if (d) closedir(d);
+    printf("   Watching %s (Ctrl-C to stop)\n", target);
+    fflush(stdout);
+    
+    // An editor that saves by rename reports the name twice; the second
+    // event finds the source unchanged
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0) break;
+        for (char* p = buf; p < buf + n; ) {
+            struct inotify_event* ev = (struct inotify_event*)p;
+            if (ev->len && watch_wanted(w, ev->name)) watch_build(w, ev->name);
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+        fflush(stdout);
+    }
+    close(fd);
+    compiler_free(w->c);
+    free(w->c);
+    free(w);
+    return 0;
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Server - Compile daemon on a Unix socket
+// ═══════════════════════════════════════════════════════════════
+//
+// --server listens on a socket and compiles on one worker thread per CPU,
+// each with a warm compiler (see Watch). With WAVEC_SERVER set to the
+// socket, wavec sends its cwd and argv there instead of compiling:
+//   request  cwd, cache, argv[0..] - NUL-terminated strings, then the client shuts down writing
+//   reply    u32 status, u32 out_len, u32 err_len, out, err
+// Paths are taken relative to the client's cwd, and so is its fate.store,
+// which the server keeps in memory until the file changes. cache is the
+// client's WAVEC_CACHE made absolute, "" when it has none; the server's own
+// is not used, though its WAVEC_CACHE_SIZE caps every cache. Anything but a
+// plain compile (--link, --run, --autotune...) gets SERVER_LOCAL and the
+// client runs it itself, as it does when the server is down.
+
+typedef struct {
+    char path[PATH_MAX];
+    struct timespec mtime;
+    off_t size;
+    char* text;
+    size_t len;
+} StoreCache;
+
+typedef struct {
+    int fd;               // Listening socket
+    StoreCache stores[SERVER_STORES];
+    int store_next;       // Round-robin victim
+    pthread_mutex_t lock; // Guards stores
+} Server;
+
+bool send_all(int fd, const void* buf, size_t n) {
+    const char* p = buf;
+    while (n > 0) {
+        ssize_t k = send(fd, p, n, MSG_NOSIGNAL);
+        if (k <= 0) return false;
+        p += k;
+        n -= k;
+    }
+    return true;
+}
+
+// Everything until the peer shuts down its side, NUL-terminated
+char* recv_all(int fd, size_t* len) {
+    size_t cap = 4096, n = 0;
+    char* buf = malloc(cap);
+    for (ssize_t k; (k = read(fd, buf + n, cap - n - 1)) > 0; ) {
+        n += k;
+        if (n + 1 == cap) buf = realloc(buf, cap *= 2);
+    }
+    buf[n] = 0;
+    *len = n;
+    return buf;
+}
+
+// Pin the field the store at path holds for c's source. The file is read
+// again only when its mtime or size changed.
+bool server_store_apply(Server* s, Compiler* c, const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0) return false;
+    FateScheduler stored;
+    fate_init(&stored);
+    bool found = false;
+    pthread_mutex_lock(&s->lock);
+    StoreCache* e = NULL;
+    for (int i = 0; i < SERVER_STORES && !e; i++) {
+        if (strcmp(s->stores[i].path, path) == 0) e = &s->stores[i];
+    }
+    if (!e || e->size != st.st_size || e->mtime.tv_sec != st.st_mtim.tv_sec ||
+        e->mtime.tv_nsec != st.st_mtim.tv_nsec) {
+        if (!e) {
+            e = &s->stores[s->store_next];
+            s->store_next = (s->store_next + 1) % SERVER_STORES;
+        }
+        free(e->text);
+        e->text = read_file(path, &e->len);
+        snprintf(e->path, sizeof(e->path), "%s", e->text ? path : "");
+        e->mtime = st.st_mtim;
+        e->size = st.st_size;
+    }
+    if (e->text && e->len > 0) {
+        FILE* f = fmemopen(e->text, e->len, "r");
+        found = f && fate_store_read(&stored, f, source_hash(c->source, c->len));
+        if (f) fclose(f);
+    }
+    pthread_mutex_unlock(&s->lock);
+    if (found) fate_store_pin(c, &stored);
+    return found;
+}
+
+const char* server_path(char* buf, size_t size, const char* cwd, const char* path) {
+    if (path[0] == '/') return path;
+    snprintf(buf, size, "%s/%s", cwd, path);
+    return buf;
+}
+
+int server_build(Server* s, Compiler* c, const char* cwd, const char* cache, int argc, char** argv,
+                 FILE* out, FILE* err) {
+    BuildOptions o;
+    if (argc < 2 || argv[1][0] == '-') return SERVER_LOCAL;
+    if (!build_options(&o, argc, argv, err)) return 1;
+    o.cache = *cache ? cache : NULL;
+    if (o.autotune_input) return SERVER_LOCAL;  // Benchmarks time the client's machine
+    
+    char input[PATH_MAX * 2], output[PATH_MAX * 2], profile[PATH_MAX * 2], store[PATH_MAX * 2];
+    char* source = read_file(server_path(input, sizeof(input), cwd, o.input), NULL);
+    if (!source) {
+        fprintf(err, "Cannot open: %s\n", o.input);
+        return 1;
+    }
+    // The report keeps the client's name for the output, as a local build
+    o.output_file = server_path(output, sizeof(output), cwd, o.output);
+    if (o.profile_in) o.profile_in = server_path(profile, sizeof(profile), cwd, o.profile_in);
+    
+    compiler_reset(c, source);
+    server_store_apply(s, c, server_path(store, sizeof(store), cwd, FATE_STORE_PATH));
+    int rc = build(c, &o, out, err);
+    free(source);
+    return rc;
+}
+
+void server_handle(Server* s, Compiler* c, int fd) {
+    size_t len;
+    char* req = recv_all(fd, &len);
+    char* cache = req + strlen(req) + 1;
+    if (cache > req + len) cache = req + len;
+    char* argv[256];
+    int argc = 0;
+    for (char* p = cache + strlen(cache) + 1; p < req + len && argc < 256; p += strlen(p) + 1) {
+        argv[argc++] = p;
+    }
+    
+    char* out_text = NULL;
+    char* err_text = NULL;
+    size_t out_len = 0, err_len = 0;
+    FILE* out = open_memstream(&out_text, &out_len);
+    FILE* err = open_memstream(&err_text, &err_len);
+    int status = server_build(s, c, req, cache, argc, argv, out, err);
+    fclose(out);
+    fclose(err);
+    
+    uint32_t head[3] = { (uint32_t)status, (uint32_t)out_len, (uint32_t)err_len };
+    if (send_all(fd, head, sizeof(head)) && send_all(fd, out_text, out_len)) {
+        send_all(fd, err_text, err_len);
+    }
+    free(out_text);
+    free(err_text);
+    free(req);
+    close(fd);
+}
+
+void* server_worker(void* arg) {
+    Server* s = arg;
+    Compiler* c = malloc(sizeof(Compiler));
+    compiler_init(c, "");
+    for (;;) {
+        int fd = accept(s->fd, NULL, NULL);
+        if (fd >= 0) server_handle(s, c, fd);
+    }
+    return NULL;
+}
+
+int server_run(const char* path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+    Server* s = calloc(1, sizeof(Server));
+    pthread_mutex_init(&s->lock, NULL);
+    s->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    unlink(path);
+    if (s->fd < 0 || bind(s->fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(s->fd, 128) != 0) {
+        fprintf(stderr, "Cannot listen on: %s\n", path);
+        return 1;
+    }
+    long workers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers < 1) workers = 1;
+    if (workers > SERVER_MAX_THREADS) workers = SERVER_MAX_THREADS;
+    printf("   Serving %s (%ld workers)\n", path, workers);
+    fflush(stdout);
+    
+    pthread_t threads[SERVER_MAX_THREADS];
+    for (long k = 1; k < workers; k++) pthread_create(&threads[k], NULL, server_worker, s);
+    server_worker(s);  // This thread is worker 0
+    return 0;
+}
+
+// Have the server at path run this invocation. Returns the exit status,
+// or -1 when the server is down or leaves the request to us.
+int client_run(const char* path, int argc, char** argv) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    char cwd[PATH_MAX];
+    if (argc < 2 || argv[1][0] == '-' || strlen(path) >= sizeof(addr.sun_path) ||
+        !getcwd(cwd, sizeof(cwd))) return -1;
+    strcpy(addr.sun_path, path);
+    char dir[PATH_MAX * 2];
+    const char* cache = getenv("WAVEC_CACHE");
+    cache = cache && *cache ? server_path(dir, sizeof(dir), cwd, cache) : "";
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    bool sent = connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 &&
+                send_all(fd, cwd, strlen(cwd) + 1) && send_all(fd, cache, strlen(cache) + 1);
+    for (int i = 0; sent && i < argc; i++) sent = send_all(fd, argv[i], strlen(argv[i]) + 1);
+    if (!sent) {
+        close(fd);
+        return -1;
+    }
+    shutdown(fd, SHUT_WR);
+    size_t len;
+    char* reply = recv_all(fd, &len);
+    close(fd);
+    
+    uint32_t head[3];
+    int status = -1;
+    if (len >= sizeof(head)) {
+        memcpy(head, reply, sizeof(head));
+        if (head[0] != SERVER_LOCAL && sizeof(head) + (size_t)head[1] + head[2] == len) {
+            fwrite(reply + sizeof(head), 1, head[1], stdout);
+            fwrite(reply + sizeof(head) + head[1], 1, head[2], stderr);
+            status = (int)head[0];
+        }
+    }
+    free(reply);
+    return status;
+}
+
+// ═══════════════════════════════════════════════════════════════
+// Tier - Bytecode interpreter with hot-function native compilation
+// ═══════════════════════════════════════════════════════════════
+//
+// --run compiles the program to an accumulator bytecode that mirrors the
+// native generator (acc = rax, value stack = push/pop), so both tiers agree
+// on every quirk of the language. Fate observes call and loop counters;
+// when one crosses its threshold the function collapses to native code
+// through the regular gen_* backend. Hot loops switch mid-execution (OSR)
+// through a stub that copies the interpreter frame into the native frame
+// and jumps to the native loop head.
+
+#define TIER_HOT_CALLS 1000
+#define TIER_HOT_LOOPS 10000
+#define TIER_STACK 65536
+#define TIER_SLOTS (1 << 20)
+#define TIER_FRAMES 4096
+
+enum {
+    OP_IMM, OP_STR, OP_LOADL, OP_STOREL, OP_LOADG, OP_STOREG, OP_PUSH, OP_POP,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE,
+    OP_XOR, OP_AND, OP_OR,
+    OP_PEEK, OP_POKE, OP_JMP, OP_JZ, OP_LOOP, OP_CALL, OP_RET, OP_SYSCALL,
+    OP_WRITE, OP_GETCHAR, OP_PUTCHAR, OP_COPY, OP_FILL, OP_ALLOC, OP_PREFETCH, OP_EXIT, OP_KEEP, OP_COUNT
+};
+
+// Operand words following each opcode
+const int bc_op_len[OP_COUNT] = {
+    [OP_IMM] = 1, [OP_STR] = 1, [OP_LOADL] = 1, [OP_STOREL] = 1,
+    [OP_LOADG] = 1, [OP_STOREG] = 1, [OP_JMP] = 1, [OP_JZ] = 1,
+    [OP_LOOP] = 2, [OP_CALL] = 2, [OP_SYSCALL] = 2, [OP_WRITE] = 1, [OP_ALLOC] = 1,
+};
+
+typedef struct {
+    size_t entry;            // Bytecode index
+    int param_count;
+    int slot_count;
+    char (*slot_names)[64];
+    int loop_count;
+    uint64_t calls;
+    bool unsupported;        // Uses a construct only the native tier knows
+    bool native;
+    size_t native_pos;       // Offset in the executable buffer
+    int loop_base;           // First native loop id of this function
+    size_t* osr_stubs;       // Per-loop OSR entry offsets (0 = not built)
+    Variable* native_vars;   // Native frame layout (params + locals)
+    int native_var_count;
+} BcFunc;
+
+typedef struct {
+    Compiler* c;
+    int64_t* code;
+    size_t len;
+    size_t cap;
     
-    // return / ->
-    if (match(c, "return")) { c->pos += 6; compile_return(c); return; }
-    if (match(c, "-> ")) { c->pos += 3; compile_return(c); return; }
+    char** strings;
+    int string_count;
+    int string_cap;
     
-    // keep
-    if (match(c, "keep")) { c->pos += 4; gen_event_loop(&c->codegen); return; }
+    BcFunc* funcs;           // funcs[func_count] is the main program
+    int func_count;
+    int cur;
     
-    // fate on/off
-    if (match(c, "fate on")) { c->pos += 7; c->fate_mode = true; c->fate.on = true; return; }
-    if (match(c, "fate off")) { c->pos += 8; c->fate_mode = false; c->fate.on = false; return; }
+    // Loop nesting while compiling: head index and break patch chain
+    size_t loop_head[16];
+    int64_t loop_breaks[16];
+    int loop_depth;
     
-    // limit
-    if (match(c, "limit ")) {
-        c->pos += 6;
-        int n = (int)parse_number(c);
-        c->fate.marginal_threshold = 1.0 / n;
-        return;
+    uint8_t* exec;           // Native tier (trampoline at offset 0)
+    uint64_t global_size;
+    bool stats;
+    int promoted;
+    int osr_entries;
+} Tier;
+
+typedef int64_t (*TierTrampoline)(void* target, int64_t* args, int64_t argc, int64_t* slots);
+
+size_t bc_emit(Tier* t, int64_t w) {
+    if (t->len >= t->cap) {
+        t->cap = t->cap ? t->cap * 2 : 4096;
+        t->code = realloc(t->code, sizeof(int64_t) * t->cap);
     }
-    
-    // syscall.exit
-    if (match(c, "syscall.exit(")) {
-        c->pos += 13;
+    t->code[t->len] = w;
+    return t->len++;
+}
+
+void bc_op(Tier* t, int op) { bc_emit(t, op); }
+void bc_op1(Tier* t, int op, int64_t a) { bc_emit(t, op); bc_emit(t, a); }
+void bc_op2(Tier* t, int op, int64_t a, int64_t b) { bc_emit(t, op); bc_emit(t, a); bc_emit(t, b); }
+
+int bc_string(Tier* t, const char* str) {
+    if (t->string_count >= t->string_cap) {
+        t->string_cap = t->string_cap ? t->string_cap * 2 : 64;
+        t->strings = realloc(t->strings, sizeof(char*) * t->string_cap);
+    }
+    t->strings[t->string_count] = strdup(str);
+    return t->string_count++;
+}
+
+BcFunc* bc_cur(Tier* t) { return &t->funcs[t->cur]; }
+
+// Map a variable to its frame slot (params first, then locals in order)
+int bc_slot(Tier* t, Variable* v) {
+    BcFunc* f = bc_cur(t);
+    int slot = v->is_param ? f->param_count - 1 - (v->stack_offset - 16) / 8
+                           : f->param_count + (-v->stack_offset / 8) - 1;
+    if (slot >= f->slot_count) {
+        f->slot_names = realloc(f->slot_names, sizeof(*f->slot_names) * (slot + 1));
+        for (int i = f->slot_count; i <= slot; i++) f->slot_names[i][0] = 0;
+        f->slot_count = slot + 1;
+    }
+    if (!f->slot_names[slot][0]) snprintf(f->slot_names[slot], sizeof *f->slot_names, "%.63s", v->name);
+    return slot;
+}
+
+void bc_load_var(Tier* t, Variable* v) {
+    if (v->is_global) bc_op1(t, OP_LOADG, (int64_t)v->global_addr);
+    else bc_op1(t, OP_LOADL, bc_slot(t, v));
+}
+
+void bc_store_var(Tier* t, Variable* v) {
+    if (v->is_global) bc_op1(t, OP_STOREG, (int64_t)v->global_addr);
+    else bc_op1(t, OP_STOREL, bc_slot(t, v));
+}
+
+void bc_expr(Tier* t);
+void bc_statement(Tier* t);
+
+void bc_block(Tier* t) {
+    Compiler* c = t->c;
+    skip_whitespace(c);
+    if (peek(c) == '{') advance(c);
+    while (c->pos < c->len) {
         skip_whitespace(c);
-        // Check if it's a simple number or an expression
-        char ch = peek(c);
-        if ((ch >= '0' && ch <= '9') || ch == '-') {
-            // Simple number - use optimized path
-            int code = (int)parse_number(c);
-            while (peek(c) != ')' && c->pos < c->len) advance(c);
-            if (peek(c) == ')') advance(c);
-            gen_exit(&c->codegen, code);
-        } else {
-            // Expression - compile it to rax
-            compile_expr(c);
+        if (peek(c) == '}') {
+            advance(c);
+            break;
+        }
+        bc_statement(t);
+    }
+}
+
+// Comma separated arguments: all but the last are pushed, last stays in acc
+int bc_args(Tier* t, int count) {
+    Compiler* c = t->c;
+    for (int i = 0; i < count; i++) {
+        bc_expr(t);
+        if (i < count - 1) {
+            bc_op(t, OP_PUSH);
             skip_whitespace(c);
-            if (peek(c) == ')') advance(c);
-            gen_exit_rax(&c->codegen);
+            if (peek(c) == ',') advance(c);
         }
-        return;
     }
-    
-    // syscall.write(fd, buf, count)
-    if (match(c, "syscall.write(")) {
-        c->pos += 14;
-        compile_expr(c); gen_push_rax(&c->codegen);
-        skip_whitespace(c); if (peek(c) == ',') advance(c);
-        compile_expr(c); gen_push_rax(&c->codegen);
-        skip_whitespace(c); if (peek(c) == ',') advance(c);
-        compile_expr(c); gen_mov_rdx_rax(&c->codegen);
-        gen_pop_rax(&c->codegen); gen_mov_rsi_rax(&c->codegen);
-        gen_pop_rax(&c->codegen); gen_mov_rdi_rax(&c->codegen);
-        gen_mov_rax_imm(&c->codegen, 1);
-        gen_syscall(&c->codegen);
-        skip_whitespace(c); if (peek(c) == ')') advance(c);
+    return count;
+}
+
+void bc_call(Tier* t, const char* name) {
+    Compiler* c = t->c;
+    bool user_fn = find_func(&c->codegen, name) != NULL;
+    int rt = user_fn ? -1 : rt_builtin(name);
+    if (!user_fn && strcmp(name, "prefetch") == 0) {
+        bc_expr(t);
+        while (c->pos < c->len && peek(c) != ')' && peek(c) != '\n') advance(c);
+        if (peek(c) == ')') advance(c);
+        bc_op(t, OP_PREFETCH);
         return;
     }
-    
-    // syscall.read(fd, buf, count)
-    if (match(c, "syscall.read(")) {
-        c->pos += 13;
-        compile_expr(c); gen_push_rax(&c->codegen);
-        skip_whitespace(c); if (peek(c) == ',') advance(c);
-        compile_expr(c); gen_push_rax(&c->codegen);
-        skip_whitespace(c); if (peek(c) == ',') advance(c);
-        compile_expr(c); gen_mov_rdx_rax(&c->codegen);
-        gen_pop_rax(&c->codegen); gen_mov_rsi_rax(&c->codegen);
-        gen_pop_rax(&c->codegen); gen_mov_rdi_rax(&c->codegen);
-        gen_mov_rax_imm(&c->codegen, 0);
-        gen_syscall(&c->codegen);
-        skip_whitespace(c); if (peek(c) == ')') advance(c);
+    if (rt >= 0 && ((1u << rt) & RT_TIMER_MASK)) {
+        // Callbacks are native code: the caller runs native too
+        int depth = 0;
+        while (c->pos < c->len && (depth > 0 || peek(c) != ')')) {
+            char ch = advance(c);
+            if (ch == '(') depth++;
+            else if (ch == ')') depth--;
+        }
+        if (peek(c) == ')') advance(c);
+        bc_cur(t)->unsupported = true;
         return;
     }
-    
-    // syscall.open(path, flags, mode)
-    if (match(c, "syscall.open(")) {
-        c->pos += 13;
-        compile_expr(c); gen_push_rax(&c->codegen);
-        skip_whitespace(c); if (peek(c) == ',') advance(c);
-        compile_expr(c); gen_push_rax(&c->codegen);
-        skip_whitespace(c); if (peek(c) == ',') advance(c);
-        compile_expr(c); gen_mov_rdx_rax(&c->codegen);
-        gen_pop_rax(&c->codegen); gen_mov_rsi_rax(&c->codegen);
-        gen_pop_rax(&c->codegen); gen_mov_rdi_rax(&c->codegen);
-        gen_mov_rax_imm(&c->codegen, 2);
-        gen_syscall(&c->codegen);
-        skip_whitespace(c); if (peek(c) == ')') advance(c);
+    if (rt >= 0) {
+        bc_args(t, rt_argc[rt]);
+        skip_whitespace(c);
+        if (peek(c) == ')') advance(c);
+        if (rt == RT_ALLOC) bc_op1(t, OP_ALLOC, (int64_t)rt_slot(&c->codegen, RT_ALLOC, 16));
+        else bc_op(t, rt == RT_COPY ? OP_COPY : OP_FILL);
         return;
     }
     
-    // syscall.close(fd)
-    if (match(c, "syscall.close(")) {
-        c->pos += 14;
-        compile_expr(c); gen_mov_rdi_rax(&c->codegen);
-        gen_mov_rax_imm(&c->codegen, 3);
-        gen_syscall(&c->codegen);
-        skip_whitespace(c); if (peek(c) == ')') advance(c);
-        return;
+    int argc = 0;
+    while (peek(c) != ')' && c->pos < c->len && argc < 16) {
+        bc_expr(t);
+        bc_op(t, OP_PUSH);
+        argc++;
+        skip_whitespace(c);
+        if (peek(c) == ',') advance(c);
+        skip_whitespace(c);
     }
+    if (peek(c) == ')') advance(c);
     
-    // syscall.mmap(addr, len, prot, flags, fd, offset)
-    if (match(c, "syscall.mmap(")) {
-        c->pos += 13;
-        compile_expr(c); gen_push_rax(&c->codegen);
-        skip_whitespace(c); if (peek(c) == ',') advance(c);
-        compile_expr(c); gen_push_rax(&c->codegen);
-        skip_whitespace(c); if (peek(c) == ',') advance(c);
-        compile_expr(c); gen_push_rax(&c->codegen);
-        skip_whitespace(c); if (peek(c) == ',') advance(c);
-        compile_expr(c); gen_push_rax(&c->codegen);
-        skip_whitespace(c); if (peek(c) == ',') advance(c);
-        compile_expr(c); gen_push_rax(&c->codegen);
-        skip_whitespace(c); if (peek(c) == ',') advance(c);
-        compile_expr(c);
-        emit_bytes(&c->codegen, (uint8_t[]){0x49, 0x89, 0xc1}, 3);  // mov r9, rax
-        emit_bytes(&c->codegen, (uint8_t[]){0x41, 0x58}, 2);  // pop r8
-        emit_bytes(&c->codegen, (uint8_t[]){0x41, 0x5a}, 2);  // pop r10
-        gen_pop_rax(&c->codegen); gen_mov_rdx_rax(&c->codegen);
-        gen_pop_rax(&c->codegen); gen_mov_rsi_rax(&c->codegen);
-        gen_pop_rax(&c->codegen); gen_mov_rdi_rax(&c->codegen);
-        gen_mov_rax_imm(&c->codegen, 9);
-        gen_syscall(&c->codegen);
-        skip_whitespace(c); if (peek(c) == ')') advance(c);
+    Function* fn = find_func(&c->codegen, name);
+    if (!fn) {
+        bc_cur(t)->unsupported = true;
         return;
     }
+    bc_op2(t, OP_CALL, fn - c->codegen.funcs, argc);
+}
+
+void bc_syscall(Tier* t, const char* name) {
+    if (strcmp(name, "open") == 0) { bc_args(t, 3); bc_op2(t, OP_SYSCALL, 2, 3); }
+    else if (strcmp(name, "read") == 0) { bc_args(t, 3); bc_op2(t, OP_SYSCALL, 0, 3); }
+    else if (strcmp(name, "write") == 0) { bc_args(t, 3); bc_op2(t, OP_SYSCALL, 1, 3); }
+    else if (strcmp(name, "close") == 0) { bc_args(t, 1); bc_op2(t, OP_SYSCALL, 3, 1); }
+    else if (strcmp(name, "mmap") == 0) { bc_args(t, 6); bc_op2(t, OP_SYSCALL, 9, 6); }
+    else if (syscall_def(name)) {
+        const SyscallDef* d = syscall_def(name);
+        bc_op2(t, OP_SYSCALL, d->nr, bc_args(t, d->argc));
+    }
+}
+
+void bc_binary(Tier* t, int op) {
+    bc_op(t, OP_PUSH);
+    bc_expr(t);
+    bc_op(t, op);
+}
+
+void bc_expr(Tier* t) {
+    Compiler* c = t->c;
+    skip_whitespace(c);
     
-    // poke(addr, val) as statement
-    if (match(c, "poke(")) {
-        c->pos += 5;
-        compile_expr(c);  // addr
-        gen_push_rax(&c->codegen);
-        skip_whitespace(c);
-        if (peek(c) == ',') advance(c);
+    if (isdigit(peek(c)) || (peek(c) == '-' && isdigit(peek_n(c, 1)))) {
+        bc_op1(t, OP_IMM, parse_number(c));
+    }
+    else if (peek(c) == '"') {
+        char* str = parse_string(c);
+        bc_op1(t, OP_STR, bc_string(t, str));
+        free(str);
+    }
+    else if (is_ident_start(peek(c))) {
+        char* name = parse_ident(c);
         skip_whitespace(c);
-        compile_expr(c);  // val
-        gen_pop_rbx(&c->codegen);
-        emit_bytes(&c->codegen, (uint8_t[]){0x88, 0x03}, 2);  // mov [rbx], al
+        
+        if (peek(c) == '(') {
+            advance(c);
+            skip_whitespace(c);
+            
+            if (strcmp(name, "getchar") == 0) {
+                if (peek(c) == ')') advance(c);
+                bc_op(t, OP_GETCHAR);
+            }
+            else if (strcmp(name, "peek") == 0) {
+                bc_expr(t);
+                skip_whitespace(c);
+                if (peek(c) == ')') advance(c);
+                bc_op(t, OP_PEEK);
+            }
+            else if (strcmp(name, "poke") == 0) {
+                bc_expr(t);
+                bc_op(t, OP_PUSH);
+                skip_whitespace(c);
+                if (peek(c) == ',') advance(c);
+                skip_whitespace(c);
+                bc_expr(t);
+                skip_whitespace(c);
+                if (peek(c) == ')') advance(c);
+                bc_op(t, OP_POKE);
+            }
+            else if (strncmp(name, "syscall", 7) == 0) {
+                char* sub = NULL;
+                const char* syscall_name = name + 7;
+                if (*syscall_name == '.') syscall_name++;
+                else if (peek(c) == '.') {
+                    advance(c);
+                    sub = parse_ident(c);
+                    syscall_name = sub;
+                }
+                skip_whitespace(c);
+                if (peek(c) == '(') advance(c);
+                bc_syscall(t, syscall_name);
+                skip_whitespace(c);
+                if (peek(c) == ')') advance(c);
+                free(sub);
+            }
+            else {
+                bc_call(t, name);
+            }
+        } else {
+            Variable* v = find_var(&c->codegen, name);
+            if (v) bc_load_var(t, v);
+            else bc_op1(t, OP_IMM, 0);
+        }
+        free(name);
+    }
+    else if (peek(c) == '(') {
+        advance(c);
+        bc_expr(t);
         skip_whitespace(c);
         if (peek(c) == ')') advance(c);
-        return;
+    }
+    else {
+        bc_op1(t, OP_IMM, 0);
     }
     
-    // peek(addr) as statement (result discarded)
-    if (match(c, "peek(")) {
+    // Binary operators (right-recursive, same as compile_expr)
+    static const int bin_ops[] = {
+        [BIN_ADD] = OP_ADD, [BIN_SUB] = OP_SUB, [BIN_MUL] = OP_MUL, [BIN_DIV] = OP_DIV,
+        [BIN_GE] = OP_GE, [BIN_LE] = OP_LE, [BIN_EQ] = OP_EQ, [BIN_NE] = OP_NE,
+        [BIN_GT] = OP_GT, [BIN_LT] = OP_LT, [BIN_XOR] = OP_XOR, [BIN_AND] = OP_AND, [BIN_OR] = OP_OR,
+    };
+    skip_whitespace(c);
+    while (c->pos < c->len) {
+        int op = parse_binop(c);
+        if (op == BIN_NONE) break;
+        bc_binary(t, bin_ops[op]);
+    }
+}
+
+void bc_write_string(Tier* t) {
+    Compiler* c = t->c;
+    skip_whitespace(c);
+    char* text = parse_string(c);
+    if (strlen(text) > 0) bc_op1(t, OP_WRITE, bc_string(t, text));
+    free(text);
+}
+
+void bc_jump_out(Tier* t) {
+    int d = t->loop_depth - 1;
+    bc_op(t, OP_JMP);
+    t->loop_breaks[d] = (int64_t)bc_emit(t, t->loop_breaks[d]);
+}
+
+void bc_statement(Tier* t) {
+    Compiler* c = t->c;
+    skip_whitespace(c);
+    if (c->pos >= c->len) return;
+    
+    if (peek(c) == '#') { skip_line(c); return; }
+    if (match(c, "out ")) { c->pos += 4; bc_write_string(t); return; }
+    if (match(c, "emit ")) { c->pos += 5; bc_write_string(t); return; }
+    if (match(c, "fn ")) { c->pos += 3; compile_fn_def(c); return; }
+    if (match(c, "memo fn ")) { c->pos += 8; compile_fn_def(c); return; }
+    
+    if (match(c, "when ")) {
         c->pos += 5;
-        compile_expr(c);  // addr
-        emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x0f, 0xb6, 0x00}, 4);  // movzx rax, byte [rax]
+        bc_expr(t);
+        bc_op(t, OP_JZ);
+        size_t patch = bc_emit(t, 0);
         skip_whitespace(c);
-        if (peek(c) == ')') advance(c);
+        if (peek(c) == '{') bc_block(t);
+        t->code[patch] = t->len;
         return;
     }
     
-    // getchar() / putchar() / byte() as statements
-    if (match(c, "getchar()")) {
-        c->pos += 9;
-        gen_sub_rsp(&c->codegen, 16);
-        gen_mov_rax_imm(&c->codegen, 0);
-        gen_mov_rdi_imm(&c->codegen, 0);
-        emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x8d, 0x34, 0x24}, 4);
-        gen_mov_rdx_imm(&c->codegen, 1);
-        gen_syscall(&c->codegen);
-        emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x0f, 0xb6, 0x04, 0x24}, 5);
-        gen_add_rsp(&c->codegen, 16);
+    if (match(c, "loop")) {
+        c->pos += 4;
+        skip_whitespace(c);
+        size_t head = t->len;
+        bc_op2(t, OP_LOOP, bc_cur(t)->loop_count++, 0);
+        if (t->loop_depth < 16) {
+            t->loop_head[t->loop_depth] = head;
+            t->loop_breaks[t->loop_depth] = -1;
+            t->loop_depth++;
+        }
+        if (peek(c) == '{') bc_block(t);
+        bc_op1(t, OP_JMP, head);
+        if (t->loop_depth > 0) {
+            t->loop_depth--;
+            for (int64_t p = t->loop_breaks[t->loop_depth]; p >= 0; ) {
+                int64_t next = t->code[p];
+                t->code[p] = t->len;
+                p = next;
+            }
+        }
         return;
     }
     
-    if (match(c, "putchar(")) {
-        c->pos += 8;
-        compile_expr(c);
+    if (match(c, "break")) {
+        c->pos += 5;
+        if (t->loop_depth > 0) bc_jump_out(t);
+        return;
+    }
+    
+    if (match(c, "return") || match(c, "-> ")) {
+        c->pos += match(c, "return") ? 6 : 3;
         skip_whitespace(c);
-        if (peek(c) == ')') advance(c);
-        gen_sub_rsp(&c->codegen, 16);
-        emit_bytes(&c->codegen, (uint8_t[]){0x88, 0x04, 0x24}, 3);
-        gen_mov_rax_imm(&c->codegen, 1);
-        gen_mov_rdi_imm(&c->codegen, 1);
-        emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x8d, 0x34, 0x24}, 4);
-        gen_mov_rdx_imm(&c->codegen, 1);
-        gen_syscall(&c->codegen);
-        gen_add_rsp(&c->codegen, 16);
+        if (c->pos < c->len && peek(c) != '\n' && peek(c) != '}') bc_expr(t);
+        if (t->loop_depth > 0) bc_jump_out(t);
+        else bc_op(t, OP_RET);
         return;
     }
     
-    if (match(c, "byte(")) {
-        c->pos += 5;
-        compile_expr(c);
+    if (match(c, "keep")) { c->pos += 4; bc_op(t, OP_KEEP); return; }
+    
+    if (match(c, "syscall.exit(")) {
+        c->pos += 13;
         skip_whitespace(c);
+        char ch = peek(c);
+        if ((ch >= '0' && ch <= '9') || ch == '-') {
+            bc_op1(t, OP_IMM, (int)parse_number(c));
+            while (peek(c) != ')' && c->pos < c->len) advance(c);
+        } else {
+            bc_expr(t);
+            skip_whitespace(c);
+        }
         if (peek(c) == ')') advance(c);
-        gen_sub_rsp(&c->codegen, 16);
-        emit_bytes(&c->codegen, (uint8_t[]){0x88, 0x04, 0x24}, 3);
-        gen_mov_rax_imm(&c->codegen, 1);
-        gen_mov_rdi_imm(&c->codegen, 1);
-        emit_bytes(&c->codegen, (uint8_t[]){0x48, 0x8d, 0x34, 0x24}, 4);
-        gen_mov_rdx_imm(&c->codegen, 1);
-        gen_syscall(&c->codegen);
-        gen_add_rsp(&c->codegen, 16);
+        bc_op(t, OP_EXIT);
         return;
     }
     
-    // unified { } - parse and set Unified Field parameters
-    if (match(c, "unified ")) {
+    if (match(c, "syscall.")) {
+        size_t saved_pos = c->pos;
         c->pos += 8;
-        parse_unified_block(c);
-        return;
-    }
-    if (match(c, "unified{")) {
-        c->pos += 7;
-        parse_unified_block(c);
-        return;
+        char* name = parse_ident(c);
+        bool known = peek(c) == '(' && (syscall_def(name) || strcmp(name, "write") == 0 ||
+                     strcmp(name, "read") == 0 || strcmp(name, "open") == 0 ||
+                     strcmp(name, "close") == 0 || strcmp(name, "mmap") == 0);
+        if (known) {
+            advance(c);
+            bc_syscall(t, name);
+            skip_whitespace(c);
+            if (peek(c) == ')') advance(c);
+            free(name);
+            return;
+        }
+        free(name);
+        c->pos = saved_pos;
     }
     
-    // ═══════════════════════════════════════════════════════════════
-    // Minimal universal compatibility commands (Fate adaptive)
-    // ═══════════════════════════════════════════════════════════════
-    
-    // platform.probe - Fate probes platform
-    if (match(c, "platform.probe")) {
-        c->pos += 14;
-        // Fate probes at runtime, just record here
+    if (match(c, "poke(")) {
+        c->pos += 5;
+        bc_expr(t);
+        bc_op(t, OP_PUSH);
+        skip_whitespace(c);
+        if (peek(c) == ',') advance(c);
+        skip_whitespace(c);
+        bc_expr(t);
+        bc_op(t, OP_POKE);
+        skip_whitespace(c);
+        if (peek(c) == ')') advance(c);
         return;
     }
-    
-    // bridge.read - Read bridge environment
-    if (match(c, "bridge.read")) {
-        c->pos += 11;
-        // Read from standard addresses at runtime
+    if (match(c, "peek(")) {
+        c->pos += 5;
+        bc_expr(t);
+        bc_op(t, OP_PEEK);
+        skip_whitespace(c);
+        if (peek(c) == ')') advance(c);
         return;
     }
-    
-    // compat.probe - Fate probes available devices
-    if (match(c, "compat.probe")) {
-        c->pos += 12;
-        // Fate probes at runtime
+    if (match(c, "getchar()")) { c->pos += 9; bc_op(t, OP_GETCHAR); return; }
+    if (match(c, "putchar(") || match(c, "byte(")) {
+        c->pos += match(c, "putchar(") ? 8 : 5;
+        bc_expr(t);
+        skip_whitespace(c);
+        if (peek(c) == ')') advance(c);
+        bc_op(t, OP_PUTCHAR);
         return;
     }
     
-    // Other block declarations (skip)
-    if (match(c, "pool ") || match(c, "fate {") ||
-        match(c, "task {") || match(c, "gpu {") || match(c, "perf {") ||
-        match(c, "reg {") || match(c, "sys {") || match(c, "compiler {") ||
-        match(c, "collapse {") || match(c, "lib {") || match(c, "env {") ||
-        match(c, "rule ") || match(c, "intent ") || match(c, "platform {") ||
-        match(c, "tile {") || match(c, "codegen {") || match(c, "graphics {") ||
-        match(c, "gui {") || match(c, "style {") || match(c, "layout {") ||
-        match(c, "event {") || match(c, "db {") || match(c, "core {") ||
-        match(c, "kernel {") || match(c, "linux {") || match(c, "macos {") ||
-        match(c, "windows {") || match(c, "driver {") || match(c, "observe {") ||
-        match(c, "field {") || match(c, "use ")) {
-        skip_block_decl(c);
+    // Compile-time only statements are shared with the native front end
+    if (match(c, "fate on") || match(c, "fate off") || match(c, "limit ") ||
+        match(c, "unified ") || match(c, "unified{") ||
+        match(c, "platform.probe") || match(c, "bridge.read") || match(c, "compat.probe") ||
+        match(c, "pool ") || match(c, "fate {") || match(c, "use ") ||
+        (match(c, "otherwise") == false && !is_ident_start(peek(c)))) {
+        size_t saved_code_pos = c->codegen.code_pos;
+        compile_statement(c);
+        c->codegen.code_pos = saved_code_pos;
         return;
     }
     
-    // otherwise
     if (match(c, "otherwise")) {
         c->pos += 9;
         skip_whitespace(c);
-        if (peek(c) == '{') compile_block(c);
+        if (peek(c) == '{') bc_block(t);
         return;
     }
     
-    // Variable assignment or function call
     if (is_ident_start(peek(c))) {
+        // Remaining keyword statements (block declarations) belong to the front end
+        size_t start = c->pos;
         char* name = parse_ident(c);
         skip_whitespace(c);
         
         if (peek(c) == '=' && peek_n(c, 1) != '=') {
             advance(c);
-            compile_assign(c, name);
+            skip_whitespace(c);
+            Variable* v = find_var(&c->codegen, name);
+            if (!v) v = add_var(&c->codegen, name, VAR_INT);
+            if (v) {
+                bc_expr(t);
+                bc_store_var(t, v);
+            }
         } else if (peek(c) == '(') {
             advance(c);
             skip_whitespace(c);
-            int argc = 0;
-            while (peek(c) != ')' && c->pos < c->len) {
-                compile_expr(c);
-                gen_push_rax(&c->codegen);
-                argc++;
-                skip_whitespace(c);
-                if (peek(c) == ',') advance(c);
-                skip_whitespace(c);
-            }
-            if (peek(c) == ')') advance(c);
-            gen_call(&c->codegen, name);
-            if (argc > 0) gen_add_rsp(&c->codegen, argc * 8);
+            bc_call(t, name);
         } else {
-            skip_line(c);
+            c->pos = start;
+            size_t saved_code_pos = c->codegen.code_pos;
+            compile_statement(c);
+            c->codegen.code_pos = saved_code_pos;
         }
         free(name);
         return;
@@ -1921,96 +7767,525 @@ void compile_statement(Compiler* c) {
     skip_line(c);
 }
 
-void compile_function_body(Compiler* c, Function* fn) {
-    int saved_var_count = c->codegen.var_count;
-    int saved_stack_size = c->codegen.stack_size;
-    bool saved_in_function = c->codegen.in_function;
-    c->codegen.in_function = true;  // Mark we're inside a function
-    c->current_func = fn;
-    
+void bc_compile_function(Tier* t, int fidx) {
+    Compiler* c = t->c;
+    CodeGen* cg = &c->codegen;
+    Function* fn = &cg->funcs[fidx];
+    t->cur = fidx;
+    BcFunc* f = bc_cur(t);
+    f->entry = t->len;
+    f->param_count = fn->param_count;
+    
+    int saved_var_count = cg->var_count;
+    int saved_stack_size = cg->stack_size;
+    cg->in_function = true;
     for (int i = 0; i < fn->param_count; i++) {
-        Variable* v = &c->codegen.vars[c->codegen.var_count++];
+        Variable* v = &cg->vars[cg->var_count++];
         strncpy(v->name, fn->params[i], MAX_IDENT - 1);
         v->type = VAR_INT;
         v->int_val = 0;
         v->is_param = true;
-        v->is_global = false;  // Parameters are never global
+        v->is_const = false;
+        v->is_global = false;
         v->global_addr = 0;
+        v->reg = 0;
         v->stack_offset = 16 + (fn->param_count - 1 - i) * 8;
+        bc_slot(t, v);
     }
     
-    size_t saved_pos = c->pos;
     c->pos = fn->body_pos;
-    while (c->pos < fn->body_end) {
-        compile_statement(c);
-    }
-    c->pos = saved_pos;
+    while (c->pos < fn->body_end) bc_statement(t);
+    bc_op(t, OP_RET);
     
-    c->codegen.var_count = saved_var_count;
-    c->codegen.stack_size = saved_stack_size;
-    c->codegen.in_function = saved_in_function;  // Restore in_function flag
-    c->current_func = NULL;
+    cg->var_count = saved_var_count;
+    cg->stack_size = saved_stack_size;
+    cg->in_function = false;
 }
 
-void compile(Compiler* c) {
-    gen_prologue(&c->codegen);
-    gen_sub_rsp(&c->codegen, 512);
-    
-    // Initialize rule systems
-    unified_init(&c->unified);
-    tile_init(&c->tile, &c->unified);
-    fate_init(&c->fate);
-    
-    // Add default four memory pools
-    tile_add_pool(&c->tile, 0x10000, 0x10000, "blackhole");
-    tile_add_pool(&c->tile, 0x20000, 0x10000, "meshbrain");
-    tile_add_pool(&c->tile, 0x30000, 0x10000, "multinova");
-    tile_add_pool(&c->tile, 0x40000, 0x10000, "baseforce");
+// Compile the whole program to bytecode and thread it
+void tier_compile(Tier* t) {
+    Compiler* c = t->c;
+    CodeGen* cg = &c->codegen;
+    compile_init_rules(c);
     
-    // First pass: collect function definitions
-    size_t saved_pos = c->pos;
     while (c->pos < c->len) {
         skip_whitespace(c);
         if (match(c, "fn ")) {
             c->pos += 3;
             compile_fn_def(c);
+        } else if (match(c, "memo fn ")) {
+            c->pos += 8;
+            compile_fn_def(c);
+        } else if (match(c, "unified ") || match(c, "unified{")) {
+            c->pos += 7;  // Presets hold for the whole module
+            parse_unified_block(c);
+        } else if (match(c, "limit ")) {
+            c->pos += 6;  // Budgets hold from startup
+            parse_limit(c);
         } else {
             skip_line(c);
         }
     }
-    c->pos = saved_pos;
     
-    int func_count = c->codegen.func_count;
-    c->codegen.func_count = 0;
+    t->func_count = cg->func_count;
+    t->funcs = calloc(t->func_count + 1, sizeof(BcFunc));
     
-    // Second pass: compile main program code
-    while (c->pos < c->len) {
-        compile_statement(c);
+    t->cur = t->func_count;
+    c->pos = 0;
+    bc_cur(t)->entry = t->len;
+    while (c->pos < c->import_pos) bc_statement(t);
+    bc_op1(t, OP_IMM, 0);
+    bc_op(t, OP_EXIT);
+    
+    for (int i = 0; i < t->func_count; i++) {
+        if (cg->funcs[i].body_end > cg->funcs[i].body_pos) bc_compile_function(t, i);
+        else t->funcs[i].unsupported = true;
+        // Memoized functions run native from the first call, so every call
+        // goes through the table (reserved now, before globals are mapped)
+        if (fn_memoized(c, &cg->funcs[i])) {
+            memo_table(cg, &cg->funcs[i]);
+            t->funcs[i].unsupported = true;
+        }
+    }
+    for (int i = 0; i <= t->func_count; i++) {
+        t->funcs[i].osr_stubs = calloc(t->funcs[i].loop_count + 1, sizeof(size_t));
+    }
+    cg->pool_chunk = limit_chunk(c);
+    c->pos = 0;
+}
+
+// Publish the code generator's buffer to the executable mapping
+void tier_commit(Tier* t) {
+    CodeGen* cg = &t->c->codegen;
+    resolve_fixups(cg);
+    mprotect(t->exec, MAX_CODE, PROT_READ | PROT_WRITE);
+    memcpy(t->exec, cg->code, cg->code_pos);
+    mprotect(t->exec, MAX_CODE, PROT_READ | PROT_EXEC);
+}
+
+bool tier_label_defined(CodeGen* cg, const char* name) {
+    for (int i = 0; i < cg->label_count; i++) {
+        if (strcmp(cg->labels[i].name, name) == 0) return true;
+    }
+    return false;
+}
+
+void tier_emit_function(Tier* t, int fidx) {
+    Compiler* c = t->c;
+    CodeGen* cg = &c->codegen;
+    Function* fn = &cg->funcs[fidx];
+    BcFunc* f = &t->funcs[fidx];
+    
+    f->loop_base = cg->loop_id;
+    gen_align(cg, code_align(c), ALIGN_MAX);
+    fn->code_offset = cg->code_pos;
+    add_label(cg, fn->name);
+    if (fn_memoized(c, fn)) {
+        char body_label[64];
+        snprintf(body_label, sizeof(body_label), "_memo_body_%.48s", fn->name);
+        gen_memo_wrapper(c, fn, body_label);
     }
+    gen_prologue(cg);
+    gen_sub_rsp(cg, 256);
+    cg->frame_size = 256;
+    
+    c->capture_frame = true;
+    compile_function_body(c, fn);
+    c->capture_frame = false;
+    f->native_vars = c->captured_vars;
+    f->native_var_count = c->captured_count;
+    c->captured_vars = NULL;
+    
+    gen_add_rsp(cg, 256);
+    gen_pop_rbp(cg);
+    emit_byte(cg, 0xc3);
+    fn->code_end = cg->code_pos;
+    f->native = true;
+    f->native_pos = fn->code_offset;
+    t->promoted++;
+    fate_learn(&c->fate, "tier.native", t->promoted);
+}
+
+void tier_emit_main(Tier* t) {
+    Compiler* c = t->c;
+    CodeGen* cg = &c->codegen;
+    BcFunc* f = &t->funcs[t->func_count];
     
-    c->codegen.func_count = func_count;
+    f->loop_base = cg->loop_id;
+    f->native_pos = cg->code_pos;
+    gen_prologue(cg);
+    gen_sub_rsp(cg, 512);
+    cg->frame_size = 512;
+    c->pos = 0;
+    while (c->pos < c->import_pos) compile_statement(c);
+    gen_exit(cg, 0);
+    f->native = true;
+    t->promoted++;
+}
+
+// Compile every function reachable from new native code, then publish
+void tier_close(Tier* t) {
+    CodeGen* cg = &t->c->codegen;
+    bool again = true;
+    while (again) {
+        again = false;
+        gen_cold_text(cg);
+        for (int i = 0; i < cg->fixup_count; i++) {
+            if (tier_label_defined(cg, cg->fixups[i].label)) continue;
+            Function* fn = find_func(cg, cg->fixups[i].label);
+            if (!fn || fn->body_end <= fn->body_pos) continue;
+            int fidx = fn - cg->funcs;
+            if (!t->funcs[fidx].native) {
+                tier_emit_function(t, fidx);
+                again = true;
+            }
+        }
+    }
+    gen_runtime(cg);
+    tier_commit(t);
+}
+
+void tier_promote(Tier* t, int fidx) {
+    if (t->funcs[fidx].native) return;
+    size_t saved_pos = t->c->pos;
+    if (fidx == t->func_count) tier_emit_main(t);
+    else tier_emit_function(t, fidx);
+    tier_close(t);
+    t->c->pos = saved_pos;
+}
+
+int64_t tier_call_native(Tier* t, size_t pos, int64_t* args, int64_t argc, int64_t* slots) {
+    return ((TierTrampoline)t->exec)(t->exec + pos, args, argc, slots);
+}
+
+// OSR entry for loop k: rebuild the native frame from interpreter slots
+// (rdi) and jump to the native loop head
+size_t tier_osr_stub(Tier* t, int fidx, int k) {
+    BcFunc* f = &t->funcs[fidx];
+    if (f->osr_stubs[k]) return f->osr_stubs[k];
+    tier_promote(t, fidx);
+    
+    CodeGen* cg = &t->c->codegen;
+    size_t pos = cg->code_pos;
+    gen_prologue(cg);
+    gen_sub_rsp(cg, fidx == t->func_count ? 512 : 256);
+    uint32_t saved_regs = 0;
+    for (int i = 0; i < f->native_var_count; i++) {
+        if (f->native_vars[i].reg) saved_regs |= 1u << (f->native_vars[i].reg - REG_ALLOC_FIRST);
+    }
+    gen_save_regs(cg, saved_regs);
+    for (int j = 0; j < f->slot_count; j++) {
+        for (int i = 0; i < f->native_var_count; i++) {
+            Variable* v = &f->native_vars[i];
+            if (strcmp(v->name, f->slot_names[j]) != 0) continue;
+            emit_bytes(cg, (uint8_t[]){0x48, 0x8b, 0x87}, 3);  // mov rax, [rdi+disp32]
+            emit_i32(cg, j * 8);
+            gen_store_var(cg, v);
+            break;
+        }
+    }
+    char label[64];
+    sprintf(label, "_loop_start_%d", f->loop_base + k);
+    gen_jmp(cg, label);
+    tier_commit(t);
+    
+    f->osr_stubs[k] = pos;
+    t->osr_entries++;
+    return pos;
+}
+
+int64_t tier_syscall(int64_t nr, int64_t a1, int64_t a2, int64_t a3,
+                     int64_t a4, int64_t a5, int64_t a6) {
+    register int64_t r10 __asm__("r10") = a4;
+    register int64_t r8 __asm__("r8") = a5;
+    register int64_t r9 __asm__("r9") = a6;
+    int64_t ret;
+    __asm__ volatile ("syscall"
+                      : "=a"(ret)
+                      : "a"(nr), "D"(a1), "S"(a2), "d"(a3), "r"(r10), "r"(r8), "r"(r9)
+                      : "rcx", "r11", "memory");
+    return ret;
+}
+
+// Interpreter side of _rt_alloc, sharing its {cur, end} state with native code
+int64_t tier_alloc(uint64_t* state, uint64_t n, uint64_t chunk) {
+    n = (n + 15) & ~15ULL;
+    if (state[0] + n <= state[1]) {
+        state[0] += n;
+        return (int64_t)(state[0] - n);
+    }
     
-    gen_exit(&c->codegen, 0);
+    uint64_t size = n > chunk ? n : chunk;
+    bool huge = chunk >= HUGE_PAGE_SIZE;
+    uint64_t page = huge ? HUGE_PAGE_SIZE : 0x1000;
+    size = (size + page - 1) & ~(page - 1);
+    void* p = MAP_FAILED;
+    if (huge) {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (p == MAP_FAILED) {
+        p = mmap(NULL, size + (huge ? HUGE_PAGE_SIZE : 0), PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        // As _rt_alloc: retry with just the pages n needs
+        if (p == MAP_FAILED && size > ((n + 0xfff) & ~0xfffULL)) {
+            size = (n + 0xfff) & ~0xfffULL;
+            huge = false;
+            p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+        if (p == MAP_FAILED) return 0;
+        if (huge) {
+            p = (void*)(((uintptr_t)p + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+            madvise(p, size, MADV_HUGEPAGE);
+        }
+    }
+    state[0] = (uint64_t)(uintptr_t)p + n;
+    state[1] = (uint64_t)(uintptr_t)p + size;
+    return (int64_t)(uintptr_t)p;
+}
+
+void tier_report(Tier* t) {
+    if (!t->stats) return;
+    int interpreted = 0;
+    for (int i = 0; i <= t->func_count; i++) interpreted += !t->funcs[i].native;
+    fprintf(stderr, "Tier: %zu bytecode words | %d interpreted | %d native | %d OSR entries\n",
+            t->len, interpreted, t->promoted, t->osr_entries);
+}
+
+typedef struct { int64_t* ip; int64_t* slots; int fidx; } TierFrame;
+
+// Direct-threaded interpreter. Called once with handlers != NULL to
+// export the dispatch table used to thread the bytecode.
+void tier_interpret(Tier* t, void** handlers) {
+    static void* table[OP_COUNT] = {
+        [OP_IMM] = &&do_imm, [OP_STR] = &&do_str, [OP_LOADL] = &&do_loadl,
+        [OP_STOREL] = &&do_storel, [OP_LOADG] = &&do_loadg, [OP_STOREG] = &&do_storeg,
+        [OP_PUSH] = &&do_push, [OP_POP] = &&do_pop, [OP_ADD] = &&do_add,
+        [OP_SUB] = &&do_sub, [OP_MUL] = &&do_mul, [OP_DIV] = &&do_div,
+        [OP_LT] = &&do_lt, [OP_LE] = &&do_le, [OP_GT] = &&do_gt, [OP_GE] = &&do_ge,
+        [OP_EQ] = &&do_eq, [OP_NE] = &&do_ne, [OP_XOR] = &&do_xor,
+        [OP_AND] = &&do_and, [OP_OR] = &&do_or, [OP_PEEK] = &&do_peek,
+        [OP_POKE] = &&do_poke, [OP_JMP] = &&do_jmp, [OP_JZ] = &&do_jz,
+        [OP_LOOP] = &&do_loop, [OP_CALL] = &&do_call, [OP_RET] = &&do_ret,
+        [OP_SYSCALL] = &&do_syscall, [OP_WRITE] = &&do_write,
+        [OP_GETCHAR] = &&do_getchar, [OP_PUTCHAR] = &&do_putchar,
+        [OP_COPY] = &&do_copy, [OP_FILL] = &&do_fill, [OP_ALLOC] = &&do_alloc,
+        [OP_PREFETCH] = &&do_prefetch,
+        [OP_EXIT] = &&do_exit, [OP_KEEP] = &&do_keep,
+    };
+    if (handlers) {
+        memcpy(handlers, table, sizeof(table));
+        return;
+    }
     
-    // Third pass: generate function bodies
-    for (int i = 0; i < c->codegen.func_count; i++) {
-        Function* fn = &c->codegen.funcs[i];
-        if (fn->body_pos > 0 && fn->body_end > fn->body_pos) {
-            fn->code_offset = c->codegen.code_pos;
-            add_label(&c->codegen, fn->name);
-            
-            gen_prologue(&c->codegen);
-            gen_sub_rsp(&c->codegen, 256);
-            
-            compile_function_body(c, fn);
-            
-            gen_add_rsp(&c->codegen, 256);
-            gen_pop_rbp(&c->codegen);
-            emit_byte(&c->codegen, 0xc3);
+    int64_t* base = t->code;
+    int64_t* stack = malloc(sizeof(int64_t) * TIER_STACK);
+    int64_t* slot_stack = calloc(TIER_SLOTS, sizeof(int64_t));
+    TierFrame* frames = malloc(sizeof(TierFrame) * TIER_FRAMES);
+    int depth = 0;
+    int fidx = t->func_count;
+    int64_t* sp = stack;
+    int64_t* slots = slot_stack;
+    int64_t* ip = base + t->funcs[fidx].entry;
+    int64_t acc = 0;
+    
+    #define NEXT goto *(void*)(intptr_t)(*ip++)
+    #define BINOP(expr) { int64_t a = *--sp; acc = (expr); NEXT; }
+    NEXT;
+    
+do_imm:     acc = *ip++; NEXT;
+do_str:     acc = (int64_t)(intptr_t)t->strings[*ip++]; NEXT;
+do_loadl:   acc = slots[*ip++]; NEXT;
+do_storel:  slots[*ip++] = acc; NEXT;
+do_loadg:   acc = *(int64_t*)(intptr_t)(*ip++); NEXT;
+do_storeg:  *(int64_t*)(intptr_t)(*ip++) = acc; NEXT;
+do_push:    *sp++ = acc; NEXT;
+do_pop:     acc = *--sp; NEXT;
+do_add:     BINOP((int64_t)((uint64_t)a + (uint64_t)acc));
+do_sub:     BINOP((int64_t)((uint64_t)a - (uint64_t)acc));
+do_mul:     BINOP((int64_t)((uint64_t)a * (uint64_t)acc));
+do_div:     BINOP(a / acc);
+do_lt:      BINOP(a < acc);
+do_le:      BINOP(a <= acc);
+do_gt:      BINOP(a > acc);
+do_ge:      BINOP(a >= acc);
+do_eq:      BINOP(a == acc);
+do_ne:      BINOP(a != acc);
+do_xor:     BINOP(a ^ acc);
+do_and:     BINOP(a & acc);
+do_or:      BINOP(a | acc);
+do_peek:    acc = *(uint8_t*)(intptr_t)acc; NEXT;
+do_poke:    *(uint8_t*)(intptr_t)(*--sp) = (uint8_t)acc; NEXT;
+do_jmp:     ip = base + *ip; NEXT;
+do_jz:      if (acc == 0) ip = base + *ip; else ip++; NEXT;
+do_loop: {
+        int64_t k = ip[0];
+        if (++ip[1] == TIER_HOT_LOOPS) {
+            // Fate collapse point: continue this activation natively
+            size_t stub = tier_osr_stub(t, fidx, (int)k);
+            if (fidx == t->func_count) tier_report(t);  // Native main exits directly
+            acc = tier_call_native(t, stub, slots, t->funcs[fidx].param_count, slots);
+            goto do_ret;
         }
+        ip += 2;
+        NEXT;
+    }
+do_call: {
+        int callee = (int)ip[0];
+        int argc = (int)ip[1];
+        ip += 2;
+        BcFunc* f = &t->funcs[callee];
+        f->calls++;
+        if (!f->native && (f->unsupported || f->calls >= TIER_HOT_CALLS)) tier_promote(t, callee);
+        if (f->native) {
+            acc = tier_call_native(t, f->native_pos, sp - argc, argc, NULL);
+            sp -= argc;
+            NEXT;
+        }
+        if (depth >= TIER_FRAMES - 1 || (slots - slot_stack) + 2 * TIER_FRAMES >= TIER_SLOTS) {
+            fprintf(stderr, "Tier: call stack overflow\n");
+            exit(1);
+        }
+        frames[depth++] = (TierFrame){ ip, slots, fidx };
+        slots += t->funcs[fidx].slot_count + 1;
+        memset(slots, 0, sizeof(int64_t) * (f->slot_count + 1));
+        for (int i = 0; i < argc && i < f->param_count; i++) slots[i] = sp[i - argc];
+        sp -= argc;
+        fidx = callee;
+        ip = base + f->entry;
+        NEXT;
+    }
+do_ret:
+    if (depth == 0) goto do_exit;
+    depth--;
+    ip = frames[depth].ip;
+    slots = frames[depth].slots;
+    fidx = frames[depth].fidx;
+    NEXT;
+do_syscall: {
+        int64_t nr = ip[0], n = ip[1];
+        int64_t a[6] = {0};
+        ip += 2;
+        if (n > 0) a[n - 1] = acc;
+        for (int64_t i = n - 2; i >= 0; i--) a[i] = *--sp;
+        acc = tier_syscall(nr, a[0], a[1], a[2], a[3], a[4], a[5]);
+        NEXT;
+    }
+do_write: {
+        const char* s = t->strings[*ip++];
+        acc = tier_syscall(1, 1, (int64_t)(intptr_t)s, strlen(s), 0, 0, 0);
+        NEXT;
+    }
+do_getchar: {
+        uint8_t ch = 0;
+        tier_syscall(0, 0, (int64_t)(intptr_t)&ch, 1, 0, 0, 0);
+        acc = ch;
+        NEXT;
+    }
+do_putchar: {
+        uint8_t ch = (uint8_t)acc;
+        acc = tier_syscall(1, 1, (int64_t)(intptr_t)&ch, 1, 0, 0, 0);
+        NEXT;
+    }
+do_copy: {
+        int64_t src = *--sp, dst = *--sp;
+        memmove((void*)(intptr_t)dst, (void*)(intptr_t)src, (size_t)acc);
+        acc = dst;
+        NEXT;
+    }
+do_fill: {
+        int64_t val = *--sp, dst = *--sp;
+        memset((void*)(intptr_t)dst, (int)val, (size_t)acc);
+        acc = dst;
+        NEXT;
+    }
+do_alloc:
+    acc = tier_alloc((uint64_t*)(intptr_t)(*ip++), (uint64_t)acc, t->c->codegen.pool_chunk);
+    NEXT;
+do_prefetch:
+    __builtin_prefetch((void*)(intptr_t)acc);
+    NEXT;
+do_exit:
+    tier_report(t);
+    tier_syscall(60, acc, 0, 0, 0, 0, 0);
+do_keep:
+    for (;;) pause();
+    
+    #undef NEXT
+    #undef BINOP
+}
+
+// Trampoline: target(rdi) called with argc(rdx) words from args(rsi)
+// pushed left to right, OSR slots passed in rdi
+void tier_emit_trampoline(CodeGen* cg) {
+    emit_bytes(cg, (uint8_t[]){0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57}, 10);
+    emit_bytes(cg, (uint8_t[]){0x49, 0x89, 0xfc}, 3);        // mov r12, rdi
+    emit_bytes(cg, (uint8_t[]){0x49, 0x89, 0xd5}, 3);        // mov r13, rdx
+    emit_bytes(cg, (uint8_t[]){0x49, 0x89, 0xce}, 3);        // mov r14, rcx
+    emit_bytes(cg, (uint8_t[]){0x31, 0xc9}, 2);              // xor ecx, ecx
+    emit_bytes(cg, (uint8_t[]){0x4c, 0x39, 0xe9}, 3);        // cmp rcx, r13
+    emit_bytes(cg, (uint8_t[]){0x74, 0x08}, 2);              // je +8
+    emit_bytes(cg, (uint8_t[]){0xff, 0x34, 0xce}, 3);        // push [rsi+rcx*8]
+    emit_bytes(cg, (uint8_t[]){0x48, 0xff, 0xc1}, 3);        // inc rcx
+    emit_bytes(cg, (uint8_t[]){0xeb, 0xf3}, 2);              // jmp cmp
+    emit_bytes(cg, (uint8_t[]){0x4c, 0x89, 0xf7}, 3);        // mov rdi, r14
+    emit_bytes(cg, (uint8_t[]){0x41, 0xff, 0xd4}, 3);        // call r12
+    emit_bytes(cg, (uint8_t[]){0x4a, 0x8d, 0x24, 0xec}, 4);  // lea rsp, [rsp+r13*8]
+    emit_bytes(cg, (uint8_t[]){0x41, 0x5f, 0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c, 0x5d, 0x5b}, 10);
+    gen_ret(cg);
+}
+
+int tier_run(const char* source, bool stats) {
+    Tier* t = calloc(1, sizeof(Tier));
+    t->stats = stats;
+    t->c = malloc(sizeof(Compiler));
+    compiler_init(t->c, source);
+    Compiler* c = t->c;
+    fate_store_apply(c);
+    c->osr_entries = true;              // Promoted globals would miss OSR
+    c->codegen.march = march_host();  // The JIT knows its target
+    c->codegen.text_bias = 0;           // Code byte 0 is page aligned
+    
+    tier_compile(t);
+    if (c->error[0]) {
+        fprintf(stderr, "%s\n", c->error);
+        return 1;
+    }
+    limits_apply(c);
+    
+    // Thread the bytecode: opcodes become handler addresses
+    void* handlers[OP_COUNT];
+    tier_interpret(t, handlers);
+    for (size_t i = 0; i < t->len; ) {
+        int op = (int)t->code[i];
+        t->code[i] = (int64_t)(intptr_t)handlers[op];
+        i += 1 + bc_op_len[op];
     }
     
-    resolve_fixups(&c->codegen);
+    // Globals live at the same fixed addresses in both tiers
+    t->global_size = (c->codegen.global_data_pos + 0x10000 + 0xfff) & ~0xfffULL;
+    if (mmap((void*)GLOBAL_BASE, t->global_size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != (void*)GLOBAL_BASE) {
+        fprintf(stderr, "Tier: cannot map globals at 0x%x\n", GLOBAL_BASE);
+        return 1;
+    }
+    t->exec = mmap(NULL, MAX_CODE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (t->exec == MAP_FAILED) {
+        fprintf(stderr, "Tier: cannot map code buffer\n");
+        return 1;
+    }
+    tier_emit_trampoline(&c->codegen);
+    tier_commit(t);
+    
+    // A main program the interpreter cannot run starts native right away
+    if (t->funcs[t->func_count].unsupported) {
+        tier_promote(t, t->func_count);
+        tier_report(t);
+        tier_call_native(t, t->funcs[t->func_count].native_pos, NULL, 0, NULL);
+    }
+    tier_interpret(t, NULL);
+    return 0;
 }
 
 // ═══════════════════════════════════════════════════════════════
@@ -2018,17 +8293,37 @@ void compile(Compiler* c) {
 // ═══════════════════════════════════════════════════════════════
 
 int main(int argc, char* argv[]) {
+    // Tiered execution runs the program in-process: no banner on stdout
+    if (argc >= 3 && strcmp(argv[1], "--run") == 0) {
+        bool stats = argc >= 4 && strcmp(argv[3], "--tier-stats") == 0;
+        char* source = read_file(argv[2], NULL);
+        if (!source) { fprintf(stderr, "Cannot open: %s\n", argv[2]); return 1; }
+        return tier_run(source, stats);
+    }
+    
     printf("🌊 Wave-C %s\n", VERSION);
     printf("   Rule-Driven Compiler | Rogue Intelligence LNC.\n\n");
     
     if (argc < 2) {
-        printf("Usage: %s <input.wave> [-o output] [--raw]\n\n", argv[0]);
+        printf("Usage: %s <input.wave> [-o output] [--raw] [--tiny] [-c] [--march=native|x86-64-v2|v3|v4]\n", argv[0]);
+        printf("       %s <input.wave> [--time-passes] [--enable-pass=a,b] [--disable-pass=a,b]\n", argv[0]);
+        printf("       %s <input.wave> --autotune bench_input [-o output]\n", argv[0]);
+        printf("       %s <input.wave> [--fate-instrument[=file]] [--fate-profile=file]\n", argv[0]);
+        printf("       %s --link a.wo b.wo ... [-o output] [--no-lto]\n", argv[0]);
+        printf("       %s --watch <dir|input.wave> [-o output] [-c]\n", argv[0]);
+        printf("       %s --server <socket>  (WAVEC_SERVER=<socket> %s ... 转发编译)\n", argv[0], argv[0]);
+        printf("       %s --stats  (WAVEC_CACHE=<dir> 启用输出缓存)\n", argv[0]);
+        printf("       %s --run <input.wave> [--tier-stats]\n\n", argv[0]);
         printf("Syntax:\n");
         printf("  out \"text\"           - 输出文本\n");
         printf("  emit \"\\xHH\"         - 输出字节\n");
         printf("  byte(N)              - 输出单个字节\n");
         printf("  getchar()            - 读取一个字符\n");
         printf("  putchar(N)           - 输出一个字符\n");
+        printf("  copy(dst, src, n)    - 批量复制内存\n");
+        printf("  fill(dst, byte, n)   - 批量填充内存\n");
+        printf("  alloc(n)             - 从内存池分配\n");
+        printf("  prefetch(addr, hint) - 预取 (t0/t1/t2/nta/w)\n");
         printf("  name = expr          - 变量赋值\n");
         printf("  when cond { }        - 条件语句\n");
         printf("  loop { }             - 循环\n");
@@ -2037,33 +8332,59 @@ int main(int argc, char* argv[]) {
         printf("  name(args)           - 函数调用\n");
         printf("  keep                 - 事件循环\n");
         printf("  fate on/off          - 动态/静态模式\n");
-        printf("  limit N              - 资源限制\n");
+        printf("  limit N              - 收敛阈值 (1/N)\n");
+        printf("  limit memory 512M    - 资源限制 (memory/cpu/fds)\n");
         printf("  -> value             - 返回值\n");
         printf("  unified { i: e: r: } - 设置统一场参数\n");
         printf("  syscall.exit(N)      - 退出程序\n");
+        printf("  syscall.socket(...)  - 套接字/epoll (bind listen accept4 recv send epoll_wait)\n");
         return 1;
     }
     
-    char* input = argv[1];
-    char* output = "a.out";
-    bool raw_mode = false;
+    if (strcmp(argv[1], "--link") == 0) {
+        char* objects[argc];
+        int object_count = 0;
+        char* output = "a.out";
+        bool lto = true;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) output = argv[++i];
+            else if (strcmp(argv[i], "--no-lto") == 0) lto = false;
+            else objects[object_count++] = argv[i];
+        }
+        if (object_count == 0) { fprintf(stderr, "No objects to link\n"); return 1; }
+        return link_objects(objects, object_count, output, lto);
+    }
+    
+    if (strcmp(argv[1], "--watch") == 0 && argc >= 3) {
+        char* output = NULL;
+        bool object_mode = false;
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) output = argv[++i];
+            else if (strcmp(argv[i], "-c") == 0) object_mode = true;
+        }
+        return watch_run(argv[2], output, object_mode);
+    }
     
-    for (int i = 2; i < argc; i++) {
-        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) output = argv[++i];
-        else if (strcmp(argv[i], "--raw") == 0) raw_mode = true;
+    if (strcmp(argv[1], "--server") == 0 && argc >= 3) return server_run(argv[2]);
+    if (strcmp(argv[1], "--stats") == 0) return cache_stats();
+    
+    const char* server = getenv("WAVEC_SERVER");
+    if (server && *server) {
+        int status = client_run(server, argc, argv);
+        if (status >= 0) return status;
     }
     
-    FILE* f = fopen(input, "r");
-    if (!f) { fprintf(stderr, "Cannot open: %s\n", input); return 1; }
+    BuildOptions options;
+    if (!build_options(&options, argc, argv, stderr)) return 1;
     
-    fseek(f, 0, SEEK_END);
-    size_t size = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    char* source = read_file(options.input, NULL);
+    if (!source) { fprintf(stderr, "Cannot open: %s\n", options.input); return 1; }
     
-    char* source = malloc(size + 1);
-    fread(source, 1, size, f);
-    source[size] = 0;
-    fclose(f);
+    if (options.autotune_input && !autotune(source, options.autotune_input)) {
+        fprintf(stderr, "Autotune: the program does not run on %s\n", options.autotune_input);
+        free(source);
+        return 1;
+    }
     
     Compiler* compiler = malloc(sizeof(Compiler));
     if (!compiler) {
@@ -2073,30 +8394,12 @@ int main(int argc, char* argv[]) {
     }
     
     compiler_init(compiler, source);
-    compile(compiler);
-    
-    if (raw_mode) {
-        write_raw(&compiler->codegen, output);
-        printf("Generated raw: %s (%zu bytes)\n", output, compiler->codegen.code_pos);
-    } else {
-        write_elf(&compiler->codegen, output);
-        printf("Generated: %s\n", output);
-        printf("   Code: %zu bytes\n", compiler->codegen.code_pos);
-    }
-    
-    printf("   Variables: %d | Functions: %d\n", 
-           compiler->codegen.var_count, compiler->codegen.func_count);
-    printf("   Unified: i=%.2f e=%.2f r=%.2f\n",
-           compiler->unified.i, compiler->unified.e, compiler->unified.r);
-    printf("   Tile: %zu bytes (%d pools)\n",
-           tile_total_used(&compiler->tile), compiler->tile.pool_count);
-    printf("   Fate: %s\n", compiler->fate.on ? "dynamic" : "static");
-    printf("   Platform: id=%d syscall_base=0x%lx\n", 
-           compiler->platform.id, compiler->platform.syscall_base);
+    fate_store_apply(compiler);
+    int rc = build(compiler, &options, stdout, stderr);
     
     compiler_free(compiler);
     free(compiler);
     free(source);
     
-    return 0;
+    return rc;
 }